@@ -16,6 +16,8 @@
 #define OC_APPLE_KERNEL_LIB_H
 
 #include <Library/OcMachoLib.h>
+#include <Library/OcMiscLib.h>
+#include <Library/OcStorageLib.h>
 #include <Library/OcXmlLib.h>
 #include <Protocol/SimpleFileSystem.h>
 
@@ -50,6 +52,12 @@
 //
 #define PRELINK_INFO_RESERVE_SIZE (5U * 1024U * 1024U)
 
+//
+// Prelinked symbol cache file signature and format version.
+//
+#define PRELINK_SYMBOL_CACHE_SIGNATURE  SIGNATURE_32 ('O', 'C', 'S', 'C')
+#define PRELINK_SYMBOL_CACHE_VERSION    2U
+
 //
 // Prelinked context used for kernel modification.
 //
@@ -101,6 +109,11 @@ typedef struct {
   //
   CHAR8                    *PrelinkedInfo;
   //
+  // Untouched copy of prelinkedkernel PRELINK_INFO_SECTION taken before
+  // injection overwrites it. Used for incremental plist export, may be NULL.
+  //
+  CHAR8                    *PrelinkedInfoSource;
+  //
   // Parsed instance of PlistInfo. New entries are added here.
   //
   XML_DOCUMENT             *PrelinkedInfoDocument;
@@ -110,6 +123,10 @@ typedef struct {
   //
   XML_NODE                 *KextList;
   //
+  // Number of KextList entries present in the original PRELINK_INFO_SECTION.
+  //
+  UINT32                   KextListParsedCount;
+  //
   // Buffers allocated from pool for internal needs.
   //
   VOID                     **PooledBuffers;
@@ -127,8 +144,97 @@ typedef struct {
   // Used for caching prelinked kexts.
   //
   LIST_ENTRY               PrelinkedKexts;
+  //
+  // Open addressing lookup table of all known kexts by CFBundleIdentifier.
+  //
+  struct PRELINKED_KEXT_INDEX_ENTRY_ *KextIndex;
+  //
+  // Number of used KextIndex entries.
+  //
+  UINT32                   KextIndexCount;
+  //
+  // Number of KextIndex entries minus one (always power of two).
+  //
+  UINT32                   KextIndexMask;
+  //
+  // Arena for kext dependency lists, linked symbol tables and vtables.
+  // Released at once upon context destruction.
+  //
+  OC_ARENA                 Arena;
 } PRELINKED_CONTEXT;
 
+//
+// Kext bundle descriptor for batch injection.
+//
+typedef struct {
+  //
+  // Kext bundle path (e.g. /L/E/mykext.kext).
+  //
+  CONST CHAR8              *BundlePath;
+  //
+  // Kext Info.plist.
+  //
+  CONST CHAR8              *InfoPlist;
+  //
+  // Kext Info.plist size.
+  //
+  UINT32                   InfoPlistSize;
+  //
+  // Kext executable path (e.g. Contents/MacOS/mykext), optional.
+  //
+  CONST CHAR8              *ExecutablePath;
+  //
+  // Kext executable, optional.
+  //
+  CONST UINT8              *Executable;
+  //
+  // Kext executable size, optional.
+  //
+  UINT32                   ExecutableSize;
+} PRELINKED_KEXT_BUNDLE;
+
+//
+// Kext link plan, see PrelinkedPlanKexts.
+//
+typedef struct {
+  //
+  // Number of kexts passed to the planner.
+  //
+  UINT32                   NumKexts;
+  //
+  // Number of kexts in Order.
+  //
+  UINT32                   NumPlanned;
+  //
+  // Kext indices in link order, dependencies go first.
+  //
+  UINT32                   *Order;
+  //
+  // Per-kext link level, kexts only depend on kexts with lower levels,
+  // so kexts of one level are independent. MAX_UINT32 for skipped kexts.
+  //
+  UINT32                   *Levels;
+  //
+  // Number of link levels.
+  //
+  UINT32                   NumLevels;
+  //
+  // Kext I dependencies from the same batch are Dependencies[DependencyOffsets[I]]
+  // up to Dependencies[DependencyOffsets[I + 1]], DependencyOffsets has NumKexts + 1 entries.
+  //
+  UINT32                   *DependencyOffsets;
+  UINT32                   *Dependencies;
+  //
+  // Unique identifiers of dependencies outside of the batch.
+  // Point to the passed plists.
+  //
+  CONST CHAR8              **ExternalDependencies;
+  //
+  // Number of ExternalDependencies.
+  //
+  UINT32                   NumExternalDependencies;
+} PRELINKED_KEXT_PLAN;
+
 //
 // Kernel and kext patching context.
 //
@@ -296,6 +402,22 @@ PrelinkedReserveKextSize (
   IN     UINT32       ExecutableSize OPTIONAL
   );
 
+/**
+  Updated required reserve size to inject these kexts.
+
+  @param[in,out] ReservedSize  Current reserved size, updated.
+  @param[in]     Bundles       Kext bundles to inject.
+  @param[in]     NumBundles    Number of kext bundles.
+
+  @return  EFI_SUCCESS on success.
+**/
+RETURN_STATUS
+PrelinkedReserveKextsSize (
+  IN OUT UINT32                       *ReservedSize,
+  IN     CONST PRELINKED_KEXT_BUNDLE  *Bundles,
+  IN     UINT32                       NumBundles
+  );
+
 /**
   Perform kext injection.
 
@@ -320,6 +442,113 @@ PrelinkedInjectKext (
   IN     UINT32             ExecutableSize OPTIONAL
   );
 
+/**
+  Build link plan for kexts to be injected. Kexts are sorted so that their
+  dependencies from the same batch go first, and every dependency found in
+  prelinked is scanned once for all kexts.
+
+  @param[in,out] Context     Prelinked context.
+  @param[in]     PlistRoots  Kext Info.plist root dicts, NULL entries are skipped.
+  @param[in]     NumKexts    Number of kexts.
+  @param[out]    Plan        Link plan, to be freed with PrelinkedPlanFree.
+
+  @return  EFI_SUCCESS on success.
+**/
+RETURN_STATUS
+PrelinkedPlanKexts (
+  IN OUT PRELINKED_CONTEXT    *Context,
+  IN     XML_NODE             **PlistRoots,
+  IN     UINT32               NumKexts,
+  OUT    PRELINKED_KEXT_PLAN  *Plan
+  );
+
+/**
+  Free kext link plan.
+
+  @param[in,out] Plan  Link plan.
+**/
+VOID
+PrelinkedPlanFree (
+  IN OUT PRELINKED_KEXT_PLAN  *Plan
+  );
+
+/**
+  Perform batch kext injection. Kexts are linked so that dependencies from
+  the same batch go before their dependents. Each executable is placed into
+  prelinked text right before it is linked, so that the space of a kext,
+  which fails to link, is given back. Plist info is exported once by
+  PrelinkedInjectComplete.
+
+  @param[in,out] Context     Prelinked context.
+  @param[in]     Bundles     Kext bundles to inject.
+  @param[in]     NumBundles  Number of kext bundles.
+  @param[out]    Statuses    Per-bundle injection status, optional.
+
+  @return  EFI_SUCCESS when all kexts were injected.
+**/
+RETURN_STATUS
+PrelinkedInjectKexts (
+  IN OUT PRELINKED_CONTEXT            *Context,
+  IN     CONST PRELINKED_KEXT_BUNDLE  *Bundles,
+  IN     UINT32                       NumBundles,
+  OUT    RETURN_STATUS                *Statuses OPTIONAL
+  );
+
+/**
+  Export symbol cache for kernel and prelinked kexts with already built
+  linked symbol tables and vtables, e.g. after kext injection.
+  Injected kexts are not exported.
+
+  @param[in,out] Context     Prelinked context.
+  @param[out]    Buffer      Symbol cache allocated from pool.
+  @param[out]    BufferSize  Symbol cache size.
+
+  @return  EFI_SUCCESS on success.
+**/
+RETURN_STATUS
+PrelinkedExportSymbolCache (
+  IN OUT PRELINKED_CONTEXT  *Context,
+     OUT VOID               **Buffer,
+     OUT UINT32             *BufferSize
+  );
+
+/**
+  Import symbol cache produced by PrelinkedExportSymbolCache for the same
+  kernel. Every cached kext must match by identifier, CFBundleVersion, and
+  Mach-O UUID, otherwise the whole cache is rejected. Must be called before
+  kext injection, cached kexts will not rebuild their linked symbol tables
+  and vtables when used as dependencies.
+
+  @param[in,out] Context     Prelinked context.
+  @param[in]     Buffer      Symbol cache, 8-byte aligned.
+  @param[in]     BufferSize  Symbol cache size.
+
+  @return  EFI_SUCCESS on success.
+**/
+RETURN_STATUS
+PrelinkedImportSymbolCache (
+  IN OUT PRELINKED_CONTEXT  *Context,
+  IN     CONST VOID         *Buffer,
+  IN     UINT32             BufferSize
+  );
+
+/**
+  Load symbol cache from storage and import it.
+  Vault hashing is performed when storage has a vault.
+
+  @param[in,out] Context   Prelinked context.
+  @param[in]     Storage   Storage context.
+  @param[in]     FilePath  Symbol cache path within storage.
+
+  @return  EFI_SUCCESS on success.
+**/
+RETURN_STATUS
+PrelinkedLoadSymbolCache (
+  IN OUT PRELINKED_CONTEXT   *Context,
+  IN     OC_STORAGE_CONTEXT  *Storage,
+  IN     CONST CHAR16        *FilePath
+  );
+
 /**
   Initialize patcher from prelinked context for kext patching.
 
@@ -368,6 +597,29 @@ PatcherGetSymbolAddress (
   IN OUT UINT8              **Address
   );
 
+/**
+  Get local symbol addresses in a single symbol table walk.
+  This is preferred over PatcherGetSymbolAddress for multiple symbols.
+
+  @param[in,out] Context         Patcher context.
+  @param[in]     Names           Symbol names, NULL entries are skipped.
+  @param[in]     NumNames        Number of symbol names.
+  @param[out]    Addresses       Returned symbol addresses in file,
+                                 NULL for skipped or missing symbols.
+
+  @retval  EFI_SUCCESS            All symbols were found.
+  @retval  EFI_INVALID_PARAMETER  A symbol has no file offset,
+                                  like in PatcherGetSymbolAddress.
+  @retval  EFI_NOT_FOUND          A symbol is missing.
+**/
+RETURN_STATUS
+PatcherGetSymbolAddresses (
+  IN OUT PATCHER_CONTEXT    *Context,
+  IN     CONST CHAR8        **Names,
+  IN     UINT32             NumNames,
+     OUT UINT8              **Addresses
+  );
+
 /**
   Apply generic patch.
 
@@ -382,6 +634,28 @@ PatcherApplyGenericPatch (
   IN     PATCHER_GENERIC_PATCH  *Patch
   );
 
+/**
+  Apply multiple generic patches in a single pass over the binary.
+  Symbol bases are resolved in a single symbol table walk.
+  The result is identical to applying the patches one by one in list order.
+  Batching only pays off with several patches to the same kext, use
+  PatcherApplyGenericPatch for a single patch.
+
+  @param[in,out] Context         Patcher context.
+  @param[in]     Patches         Patch descriptions.
+  @param[in]     NumPatches      Number of patches.
+  @param[out]    Statuses        Per patch status, optional.
+
+  @return  EFI_SUCCESS when all patches were applied.
+**/
+RETURN_STATUS
+PatcherApplyGenericPatches (
+  IN OUT PATCHER_CONTEXT        *Context,
+  IN     PATCHER_GENERIC_PATCH  *Patches,
+  IN     UINT32                 NumPatches,
+     OUT RETURN_STATUS          *Statuses  OPTIONAL
+  );
+
 /**
   Block kext from loading.
 
@@ -81,6 +81,74 @@ DecompressLZVN (
   IN  UINTN        SrcLen
   );
 
+/**
+  Chunk size used for reading compressed data in streaming decompression.
+**/
+#define OC_DECOMPRESS_STREAM_CHUNK_SIZE BASE_256KB
+
+/**
+  Read next compressed data for streaming decompression.
+
+  @param[in,out] Context     Read context.
+  @param[out]    Buffer      Buffer to read to.
+  @param[in]     Size        Amount of bytes to read.
+
+  @return  TRUE when exactly Size bytes were read.
+**/
+typedef
+BOOLEAN
+(*OC_DECOMPRESS_STREAM_READ) (
+  IN OUT VOID    *Context,
+     OUT UINT8   *Buffer,
+  IN     UINT32  Size
+  );
+
+/**
+  Decompress LZSS data read in chunks without buffering the whole
+  compressed data. Adler-32 of the output is computed along the way.
+
+  @param[out]  Dst         Destination buffer.
+  @param[in]   DstLen      Destination buffer size.
+  @param[in]   SrcLen      Compressed data size.
+  @param[in]   Read        Compressed data reader.
+  @param[in]   Context     Compressed data reader context.
+  @param[out]  Adler       Adler-32 of decompressed data, optional.
+
+  @return  DecompressedLen on success otherwise 0.
+**/
+UINT32
+DecompressStreamLZSS (
+  OUT UINT8                      *Dst,
+  IN  UINT32                     DstLen,
+  IN  UINT32                     SrcLen,
+  IN  OC_DECOMPRESS_STREAM_READ  Read,
+  IN  VOID                       *Context,
+  OUT UINT32                     *Adler  OPTIONAL
+  );
+
+/**
+  Decompress LZVN data read in chunks without buffering the whole
+  compressed data. Adler-32 of the output is computed along the way.
+
+  @param[out]  Dst         Destination buffer.
+  @param[in]   DstLen      Destination buffer size.
+  @param[in]   SrcLen      Compressed data size.
+  @param[in]   Read        Compressed data reader.
+  @param[in]   Context     Compressed data reader context.
+  @param[out]  Adler       Adler-32 of decompressed data, optional.
+
+  @return  DecompressedLen on success otherwise 0.
+**/
+UINT32
+DecompressStreamLZVN (
+  OUT UINT8                      *Dst,
+  IN  UINT32                     DstLen,
+  IN  UINT32                     SrcLen,
+  IN  OC_DECOMPRESS_STREAM_READ  Read,
+  IN  VOID                       *Context,
+  OUT UINT32                     *Adler  OPTIONAL
+  );
+
 /**
   Compress buffer with ZLIB algorithm.
 
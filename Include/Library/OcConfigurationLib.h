@@ -387,7 +387,8 @@
   OC_DECLARE (OC_UEFI_CONFIG)
 
 /**
-  Root configuration
+  Root configuration. Cache references configuration cache memory,
+  when the configuration was loaded from it.
 **/
 
 #define OC_GLOBAL_CONFIG_FIELDS(_, __) \
@@ -397,7 +398,8 @@
   _(OC_MISC_CONFIG              , Misc              ,     , OC_CONSTR1 (OC_MISC_CONFIG, _, __)      , OC_DESTR (OC_MISC_CONFIG)) \
   _(OC_NVRAM_CONFIG             , Nvram             ,     , OC_CONSTR1 (OC_NVRAM_CONFIG, _, __)     , OC_DESTR (OC_NVRAM_CONFIG)) \
   _(OC_PLATFORM_CONFIG          , PlatformInfo      ,     , OC_CONSTR1 (OC_PLATFORM_CONFIG, _, __)  , OC_DESTR (OC_PLATFORM_CONFIG)) \
-  _(OC_UEFI_CONFIG              , Uefi              ,     , OC_CONSTR1 (OC_UEFI_CONFIG, _, __)      , OC_DESTR (OC_UEFI_CONFIG))
+  _(OC_UEFI_CONFIG              , Uefi              ,     , OC_CONSTR1 (OC_UEFI_CONFIG, _, __)      , OC_DESTR (OC_UEFI_CONFIG)) \
+  _(VOID *                      , Cache             ,     , NULL                                    , ())
   OC_DECLARE (OC_GLOBAL_CONFIG)
 
 /**
@@ -416,6 +418,54 @@ OcConfigurationInit (
   IN  UINT32             Size
   );
 
+/**
+  Initialize configuration with configuration cache matching plist data,
+  or with plist data when the cache is missing, stale, or invalid.
+  The cache is not verified otherwise and is expected to be read through
+  OcStorageLib, which checks it against the vault.
+  Configuration loaded from the cache is read-only and must not be modified,
+  its lists refuse new entries.
+
+  @param[out]  Config     Configuration structure.
+  @param[in]   Buffer     Configuration buffer in plist format.
+  @param[in]   Size       Configuration buffer size.
+  @param[in]   Digest     Buffer SHA-256 digest, e.g. from OcStorageGetDigest.
+                          Calculated when NULL.
+  @param[in]   Cache      Configuration cache allocated from pool, optional.
+                          Ownership is transferred to this function.
+  @param[in]   CacheSize  Configuration cache size.
+
+  @retval  EFI_SUCCESS on success
+**/
+EFI_STATUS
+OcConfigurationInitWithCache (
+  OUT OC_GLOBAL_CONFIG   *Config,
+  IN  VOID               *Buffer,
+  IN  UINT32             Size,
+  IN  CONST UINT8        *Digest  OPTIONAL,
+  IN  VOID               *Cache   OPTIONAL,
+  IN  UINT32             CacheSize
+  );
+
+/**
+  Create configuration cache from plist data. The cache is specific to
+  configuration schema and pointer size of the build it is created with.
+
+  @param[in]   Buffer     Configuration buffer in plist format.
+  @param[in]   Size       Configuration buffer size.
+  @param[out]  Cache      Configuration cache allocated from pool.
+  @param[out]  CacheSize  Configuration cache size.
+
+  @retval  EFI_SUCCESS on success
+**/
+EFI_STATUS
+OcConfigurationExportCache (
+  IN  VOID               *Buffer,
+  IN  UINT32             Size,
+  OUT VOID               **Cache,
+  OUT UINT32             *CacheSize
+  );
+
 /**
   Free configuration structure.
 
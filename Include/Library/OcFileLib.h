@@ -131,6 +131,46 @@ GetFileData (
   OUT UINT8              *Buffer
   );
 
+/**
+  Start reading exact amount of bytes from EFI_FILE_PROTOCOL at specified position.
+  Data is read asynchronously when supported by the file protocol and called
+  at TPL_APPLICATION, otherwise it is read right away. GetFileDataComplete
+  must be called before accessing the buffer or using the file again.
+
+  @param[in]  File         A pointer to the file protocol.
+  @param[in]  Position     Position to read data from.
+  @param[in]  Size         The size of the data read.
+  @param[out] Buffer       A pointer to previously allocated buffer to read data to.
+  @param[out] Token        Read token to pass to GetFileDataComplete.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+GetFileDataAsync (
+  IN  EFI_FILE_PROTOCOL  *File,
+  IN  UINT32             Position,
+  IN  UINT32             Size,
+  OUT UINT8              *Buffer,
+  OUT EFI_FILE_IO_TOKEN  *Token
+  );
+
+/**
+  Wait for the read started by GetFileDataAsync to complete.
+  This blocks, so other work is expected to be done in between the calls.
+
+  @param[in]     File         A pointer to the file protocol.
+  @param[in,out] Token        Read token from GetFileDataAsync.
+  @param[in]     Size         The size of the data read.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+GetFileDataComplete (
+  IN     EFI_FILE_PROTOCOL  *File,
+  IN OUT EFI_FILE_IO_TOKEN  *Token,
+  IN     UINT32             Size
+  );
+
 /**
   Write exact amount of bytes to a newly created file in EFI_FILE_PROTOCOL.
   Please note, that several filesystems (or drivers) may limit file name length.
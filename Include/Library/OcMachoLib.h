@@ -27,6 +27,15 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 ///
 #define MACHO_ALIGN(x) ALIGN_VALUE((x), MACHO_PAGE_SIZE)
 
+///
+/// Relocation lookup index.  Contains relocation indices sorted by the
+/// address they target.
+///
+typedef struct {
+  UINT32                *Relocations;
+  UINT32                NumRelocations;
+} OC_MACHO_RELOCATION_INDEX;
+
 ///
 /// Context used to refer to a Mach-O.  This struct is exposed for reference
 /// only.  Members are not guaranteed to be sane.
@@ -41,6 +50,9 @@ typedef struct {
   MACH_NLIST_64         *IndirectSymbolTable;
   MACH_RELOCATION_INFO  *LocalRelocations;
   MACH_RELOCATION_INFO  *ExternRelocations;
+  BOOLEAN               UseRelocationIndex;
+  OC_MACHO_RELOCATION_INDEX LocalRelocationIndex;
+  OC_MACHO_RELOCATION_INDEX ExternRelocationIndex;
 } OC_MACHO_CONTEXT;
 
 /**
@@ -338,6 +350,30 @@ MachoIsSymbolValueInRange64 (
   IN     CONST MACH_NLIST_64  *Symbol
   );
 
+/**
+  Enables relocation lookup by address via sorted indices, which are built
+  on first lookup.  Relocations must not be modified until the indices are
+  released with MachoDisableRelocationIndex.
+
+  @param[in,out] Context  Context of the Mach-O.
+
+**/
+VOID
+MachoEnableRelocationIndex (
+  IN OUT OC_MACHO_CONTEXT  *Context
+  );
+
+/**
+  Releases relocation indices and disables their use.
+
+  @param[in,out] Context  Context of the Mach-O.
+
+**/
+VOID
+MachoDisableRelocationIndex (
+  IN OUT OC_MACHO_CONTEXT  *Context
+  );
+
 /**
   Retrieves the symbol referenced by the Relocation targeting Address.
 
@@ -196,6 +196,54 @@ ApplyPatch (
   IN UINT32        Skip
   );
 
+//
+// Data patch description for ApplyPatches.
+// Patches with no Pattern write Replace at DataOffset unconditionally.
+//
+typedef struct {
+  CONST UINT8  *Pattern;
+  CONST UINT8  *PatternMask;
+  CONST UINT8  *Replace;
+  CONST UINT8  *ReplaceMask;
+  UINT32       PatternSize;
+  //
+  // Replace count or 0 for all and number of matches to skip.
+  //
+  UINT32       Count;
+  UINT32       Skip;
+  //
+  // Data window to look up the pattern in.
+  //
+  UINT32       DataOffset;
+  UINT32       DataSize;
+  //
+  // Performed replacement count, set by ApplyPatches.
+  //
+  UINT32       ReplaceCount;
+} OC_DATA_PATCH;
+
+/**
+  Apply multiple patches in a single pass over the data.
+  Each patch follows ApplyPatch semantics within its data window.
+  The result is identical to applying the patches one by one in list order.
+  When a replacement may affect the matches of another patch, the patches
+  are applied one by one.
+
+  @param[in,out] Patches     Patches to apply, ReplaceCount is updated.
+  @param[in]     NumPatches  Number of patches.
+  @param[in,out] Data        Data to patch.
+  @param[in]     DataSize    Data size, must cover every patch window.
+
+  @retval  Total number of performed replacements.
+**/
+UINT32
+ApplyPatches (
+  IN OUT OC_DATA_PATCH  *Patches,
+  IN     UINT32         NumPatches,
+  IN OUT UINT8          *Data,
+  IN     UINT32         DataSize
+  );
+
 /**
   @param[in] Protocol    The published unique identifier of the protocol. It is the callers responsibility to pass in
                          a valid GUID.
@@ -233,4 +281,112 @@ GetCurrentMemoryMap (
   OUT UINT32  *DescriptorVersion  OPTIONAL
   );
 
+//
+// Default OC_ARENA chunk size.
+//
+#define OC_ARENA_DEFAULT_CHUNK_SIZE  BASE_64KB
+
+//
+// Arena allocation alignment.
+//
+#define OC_ARENA_ALIGNMENT  8U
+
+typedef struct OC_ARENA_CHUNK_ OC_ARENA_CHUNK;
+
+//
+// Arena allocator statistics.
+//
+typedef struct {
+  //
+  // Number of served allocations.
+  //
+  UINTN           NumAllocations;
+  //
+  // Number of allocated chunks.
+  //
+  UINTN           NumChunks;
+  //
+  // Bytes handed out, including alignment padding.
+  //
+  UINTN           UsedSize;
+  //
+  // Bytes allocated for chunks.
+  //
+  UINTN           ReservedSize;
+  //
+  // Highest ReservedSize seen, kept across OcArenaFree.
+  //
+  UINTN           PeakReservedSize;
+} OC_ARENA_STATS;
+
+//
+// Arena allocator. Allocations are carved from big chunks and are only
+// released all at once with OcArenaFree.
+//
+typedef struct {
+  //
+  // Chunk list, the first chunk serves new allocations.
+  //
+  OC_ARENA_CHUNK  *Chunks;
+  //
+  // Size of newly allocated chunks.
+  //
+  UINTN           ChunkSize;
+  //
+  // Allocation statistics.
+  //
+  OC_ARENA_STATS  Stats;
+} OC_ARENA;
+
+/**
+  Initialise empty arena.
+
+  @param[out] Arena      Arena to initialise.
+  @param[in]  ChunkSize  Chunk size, 0 for OC_ARENA_DEFAULT_CHUNK_SIZE.
+**/
+VOID
+OcArenaInit (
+  OUT OC_ARENA  *Arena,
+  IN  UINTN     ChunkSize
+  );
+
+/**
+  Allocate memory from arena aligned to OC_ARENA_ALIGNMENT.
+
+  @param[in,out] Arena  Arena to allocate from.
+  @param[in]     Size   Allocation size.
+
+  @retval allocated memory or NULL.
+**/
+VOID *
+OcArenaAllocate (
+  IN OUT OC_ARENA  *Arena,
+  IN     UINTN     Size
+  );
+
+/**
+  Allocate zeroed memory from arena aligned to OC_ARENA_ALIGNMENT.
+
+  @param[in,out] Arena  Arena to allocate from.
+  @param[in]     Size   Allocation size.
+
+  @retval allocated memory or NULL.
+**/
+VOID *
+OcArenaAllocateZero (
+  IN OUT OC_ARENA  *Arena,
+  IN     UINTN     Size
+  );
+
+/**
+  Release all arena memory. Arena remains initialised and empty,
+  peak statistics are preserved.
+
+  @param[in,out] Arena  Arena to release.
+**/
+VOID
+OcArenaFree (
+  IN OUT OC_ARENA  *Arena
+  );
+
 #endif // OC_MISC_LIB_H
@@ -24,6 +24,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 typedef struct OC_SCHEMA_ OC_SCHEMA;
 typedef union OC_SCHEMA_INFO_ OC_SCHEMA_INFO;
+typedef struct OC_SCHEMA_HASHES_ OC_SCHEMA_HASHES;
 
 //
 // Generic applier interface that knows how to provide Info with data from Node.
@@ -155,6 +156,25 @@ LookupConfigSchema (
   CONST CHAR8    *Name
   );
 
+//
+// Create perfect hashes of dictionary schema names for every dictionary
+// reachable from RootSchema. Schema lists are left untouched, and ones which
+// cannot be hashed are looked up by binary search.
+// Returns hashes allocated from pool, freed by FreeConfigSchemaHashes, or NULL.
+//
+OC_SCHEMA_HASHES *
+CreateConfigSchemaHashes (
+  OC_SCHEMA_INFO      *RootSchema
+  );
+
+//
+// Free hashes returned by CreateConfigSchemaHashes.
+//
+VOID
+FreeConfigSchemaHashes (
+  OC_SCHEMA_HASHES    *Hashes
+  );
+
 //
 // Apply interface to parse serialized dictionaries
 //
@@ -209,6 +229,9 @@ ParseSerializedMap (
 //
 // Main interface for parsing serialized data.
 // PlistBuffer will be modified during the execution.
+// Schemas with only the builtin appliers above are applied from
+// PlistParseEvents without building a document, others use XmlDocumentParse.
+// Nothing is applied when parsing fails.
 //
 BOOLEAN
 ParseSerialized (
@@ -218,6 +241,78 @@ ParseSerialized (
   UINT32              PlistSize
   );
 
+//
+// ParseSerialized with perfect hashes created from RootSchema
+// by CreateConfigSchemaHashes, which speed up key lookup.
+//
+BOOLEAN
+ParseSerializedWithHashes (
+  VOID                *Serialized,
+  OC_SCHEMA_INFO      *RootSchema,
+  OC_SCHEMA_HASHES    *Hashes  OPTIONAL,
+  VOID                *PlistBuffer,
+  UINT32              PlistSize
+  );
+
+//
+// Serialized image signature and format version.
+//
+#define OC_SERIALIZED_IMAGE_SIGNATURE    SIGNATURE_32 ('O', 'C', 'S', 'I')
+#define OC_SERIALIZED_IMAGE_VERSION      1U
+
+//
+// Size of the digest identifying serialized image source.
+//
+#define OC_SERIALIZED_IMAGE_DIGEST_SIZE  32U
+
+//
+// Serialized image is a flat copy of a parsed object, followed by its blobs
+// and list entries in depth-first schema order, all 8-byte aligned.
+// Pointers are stored as image offsets and are fixed up when mapping.
+// Images are specific to pointer size and schema layout.
+//
+typedef struct {
+  UINT32  Signature;
+  UINT32  Version;
+  UINT32  Size;
+  UINT32  SchemaHash;
+  UINT32  RootOffset;
+  UINT32  RootSize;
+  UINT8   SourceDigest[OC_SERIALIZED_IMAGE_DIGEST_SIZE];
+} OC_SERIALIZED_IMAGE_HEADER;
+
+//
+// Create serialized image from parsed Serialized object of SerializedSize
+// bytes described by RootSchema. SourceDigest identifies the data Serialized
+// was parsed from. Returns image allocated from pool or NULL.
+//
+VOID *
+CompileSerializedImage (
+  VOID                *Serialized,
+  UINT32              SerializedSize,
+  OC_SCHEMA_INFO      *RootSchema,
+  CONST UINT8         *SourceDigest,
+  UINT32              *ImageSize
+  );
+
+//
+// Validate serialized image against RootSchema and SourceDigest, fix up its
+// pointers in place, and copy the root object to Serialized.
+// Serialized must be constructed, its containers are compared with the image
+// ones. On success Serialized references Image memory, which must outlive it.
+// Such object is read-only, its lists refuse new entries, and it must not be
+// destructed, Image is to be freed instead. Image is unusable after failure.
+//
+BOOLEAN
+MapSerializedImage (
+  VOID                *Serialized,
+  UINT32              SerializedSize,
+  OC_SCHEMA_INFO      *RootSchema,
+  CONST UINT8         *SourceDigest,
+  VOID                *Image,
+  UINT32              ImageSize
+  );
+
 //
 // Retrieve typed field pointer from offset
 //
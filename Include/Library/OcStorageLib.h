@@ -109,6 +109,20 @@ OcStorageFree (
   IN OUT OC_STORAGE_CONTEXT            *Context
   );
 
+/**
+  Get vault SHA-256 digest of a storage file.
+
+  @param[in]  Context      Storage context.
+  @param[in]  Filename     The full path to the file on the device.
+
+  @retval A pointer to file digest or NULL when there is no vault or file entry.
+**/
+UINT8 *
+OcStorageGetDigest (
+  IN OUT OC_STORAGE_CONTEXT            *Context,
+  IN     CONST CHAR16                  *Filename
+  );
+
 /**
   Read file from storage with implicit double (2 byte) null termination.
   Null termination does not affect the returned file size.
@@ -90,6 +90,21 @@ AsciiUint64ToLowerHex (
   IN  UINT64  Value
   );
 
+/**
+  Calculate 32-bit FNV-1a hash of a null terminated ascii string.
+  The hash is stable and is suitable for building lookup tables.
+
+  @param[in]   String  A pointer to the ascii string to hash.
+  @param[out]  Length  String length without the terminator (optional).
+
+  @retval  Hash value of String.
+**/
+UINT32
+AsciiStrHash (
+  IN  CONST CHAR8  *String,
+  OUT UINTN        *Length  OPTIONAL
+  );
+
 /**
   Performs a case insensitive comparison of two Null-terminated Unicode strings,
   and returns the difference between the first mismatched Unicode characters.
@@ -248,7 +248,7 @@ OcBlobAllocate (
 
 //
 // Insert new empty element into the OC_MAP or OC_ARRAY, depending
-// on Key value.
+// on Key value. Fails for read-only containers without a constructor.
 //
 BOOLEAN
 OcListEntryAllocate (
@@ -43,6 +43,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #define OC_XML_LIB_H
 
 #include <Library/OcGuardLib.h>
+#include <Library/OcMiscLib.h>
 
 //
 // Maximum nest level.
@@ -76,6 +77,23 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #define XML_PARSER_MAX_SIZE (32ULL*1024*1024)
 #endif
 
+//
+// Minimum nest level of plist dictionaries and arrays deferred by
+// XmlDocumentParseLazy, document root node is at level 0. Deferred text is
+// rescanned on every materialised level, so level 3 keeps the dictionaries
+// of prelinked kexts parsed right away, and only defers their contents.
+//
+#ifndef XML_PARSER_LAZY_LEVEL
+#define XML_PARSER_LAZY_LEVEL 3U
+#endif
+
+//
+// Minimum plist dictionary entry count to use an index in PlistDictFind.
+//
+#ifndef XML_PLIST_DICT_INDEX_MIN_ENTRIES
+#define XML_PLIST_DICT_INDEX_MIN_ENTRIES 8U
+#endif
+
 //
 // Debug controls
 //
@@ -108,6 +126,38 @@ struct XML_NODE_;
 typedef struct XML_DOCUMENT_ XML_DOCUMENT;
 typedef struct XML_NODE_ XML_NODE;
 
+//
+// Plist event types reported by PlistParseEvents.
+//
+typedef enum PLIST_EVENT_TYPE_ {
+  PLIST_EVENT_DICT_BEGIN,
+  PLIST_EVENT_ARRAY_BEGIN,
+  PLIST_EVENT_KEY,
+  PLIST_EVENT_VALUE,
+  PLIST_EVENT_END
+} PLIST_EVENT_TYPE;
+
+//
+// Plist event handler.
+//
+// @param Context  Handler context passed to PlistParseEvents.
+// @param Type     Event type.
+// @param Node     Key or value node for PLIST_EVENT_KEY and PLIST_EVENT_VALUE,
+//                 and NULL for other events or for keys and values with
+//                 nested tags. The node has no children and is only valid
+//                 during the call, its name and content stay valid as long
+//                 as the parsed buffer.
+//
+// @return FALSE to stop parsing.
+//
+typedef
+BOOLEAN
+(*PLIST_EVENT_HANDLER) (
+  VOID              *Context,
+  PLIST_EVENT_TYPE  Type,
+  XML_NODE          *Node
+  );
+
 
 //
 // Tries to parse the XML fragment in buffer
@@ -134,6 +184,60 @@ XmlDocumentParse (
   BOOLEAN  WithRefs
   );
 
+//
+// Tries to parse the XML fragment in buffer like XmlDocumentParse, but
+// allocates all nodes and child lists from a single arena owned by the
+// document. The arena is sized from a quick tag count prescan and is
+// released by XmlDocumentFree at once. Nodes appended to the document
+// are allocated from the same arena.
+//
+// @param Buffer  Chunk to parse
+// @param Length  Size of the buffer
+// @param WithRef Enable reference lookup support
+//
+// @return The parsed xml fragment iff parsing was successful, 0 otherwise
+//
+XML_DOCUMENT *
+XmlDocumentParseArena (
+  CHAR8    *Buffer,
+  UINT32   Length,
+  BOOLEAN  WithRefs
+  );
+
+//
+// Tries to parse the XML fragment in buffer like XmlDocumentParseArena, but
+// only records children of nested plist dictionaries and arrays as unparsed
+// text. They are parsed one level at a time on first access through
+// XmlNodeChildren or XmlNodeChild, and exported verbatim otherwise.
+// References defined in unparsed text are resolved by parsing it.
+//
+// @param Buffer  Chunk to parse
+// @param Length  Size of the buffer
+// @param WithRef Enable reference lookup support
+//
+// @warning Malformed unparsed text is only detected on access, such nodes
+//     have no children and the document can no longer be exported.
+// @warning Reference IDs must be unique within the document, as unparsed
+//     references are resolved after the following text is parsed.
+//
+// @return The parsed xml fragment iff parsing was successful, 0 otherwise
+//
+XML_DOCUMENT *
+XmlDocumentParseLazy (
+  CHAR8    *Buffer,
+  UINT32   Length,
+  BOOLEAN  WithRefs
+  );
+
+//
+// @return Arena statistics for documents parsed with XmlDocumentParseArena
+//         or XmlDocumentParseLazy, NULL for other documents.
+//
+CONST OC_ARENA_STATS *
+XmlDocumentArenaStats (
+  XML_DOCUMENT  *Document
+  );
+
 //
 // Exports parsed document into the buffer.
 //
@@ -150,6 +254,58 @@ XmlDocumentExport (
   UINT32        Skip
   );
 
+//
+// Exports parsed document into the caller provided buffer.
+// Nothing is allocated, which allows to write straight into the destination.
+//
+// @param Document   XML_DOCUMENT to export
+// @param Buffer     Destination buffer, NULL to only obtain the size
+// @param BufferSize Destination buffer size including trailing \0
+// @param Length     Resulting length of the buffer without trailing \0
+// @param Skip       N root levels before exporting, normally 0.
+//
+// @return TRUE if the document was exported, FALSE if it does not fit.
+//         Length is updated with the required size in both cases.
+//
+BOOLEAN
+XmlDocumentExportInto (
+  XML_DOCUMENT  *Document,
+  CHAR8         *Buffer,
+  UINT32        BufferSize,
+  UINT32        *Length,
+  UINT32        Skip
+  );
+
+//
+// Exports parsed document into the caller provided buffer by copying its
+// original text verbatim and only serialising the children appended to Node
+// after parsing. These children are spliced right before Node closing tag.
+// The document must not be modified in any other way.
+//
+// @param Document    XML_DOCUMENT to export
+// @param Source      Untouched copy of the text Document was parsed from,
+//                    at least as long as the parsed buffer
+// @param Node        Container node from Document children were appended to
+// @param ParsedCount Number of Node children present right after parsing
+// @param Buffer      Destination buffer, NULL to only obtain the size
+// @param BufferSize  Destination buffer size including trailing \0
+// @param Length      Resulting length of the buffer without trailing \0
+//
+// @return TRUE if the document was exported, FALSE otherwise.
+//         Length is set to 0 when Node cannot be located in Source,
+//         in which case XmlDocumentExportInto should be used instead.
+//
+BOOLEAN
+XmlDocumentExportAppended (
+  XML_DOCUMENT  *Document,
+  CONST CHAR8   *Source,
+  XML_NODE      *Node,
+  UINT32        ParsedCount,
+  CHAR8         *Buffer,
+  UINT32        BufferSize,
+  UINT32        *Length
+  );
+
 //
 // Frees all resources associated with the document. All XML_NODE
 // references obtained through the document will be invalidated.
@@ -257,6 +413,33 @@ PlistDocumentRoot (
   XML_DOCUMENT  *Document
   );
 
+//
+// Parses the plist in buffer without building a document and reports its
+// root value to Handler in document order. Dictionaries and arrays are
+// reported as begin and end events with their contents in between, and
+// dictionary keys and other values are reported with a temporary node,
+// which the Plist*Value functions accept. No memory is allocated.
+//
+// @param Buffer   Chunk to parse
+// @param Length   Size of the buffer
+// @param Handler  Event handler
+// @param Context  Handler context
+//
+// @warning `Buffer` contents are permanently modified during parsing
+// @warning References are not supported.
+// @warning Events reported before a parsing failure are not revoked.
+//
+// @return TRUE iff the plist was parsed and Handler never returned FALSE.
+//         Handler returning FALSE is not reported as a parsing error.
+//
+BOOLEAN
+PlistParseEvents (
+  CHAR8                *Buffer,
+  UINT32               Length,
+  PLIST_EVENT_HANDLER  Handler,
+  VOID                 *Context
+  );
+
 //
 // Performs basic type casting (up to PLIST_NODE_TYPE_MAX).
 // Guarantees that node represents passed type.
@@ -290,6 +473,18 @@ PlistDictChild (
   XML_NODE     **Value OPTIONAL
   );
 
+//
+// @return Value of the first dictionary entry with the given key or NULL.
+// Dictionaries with at least XML_PLIST_DICT_INDEX_MIN_ENTRIES entries are
+// looked up through a hash index built on first use and dropped when new
+// entries are appended.
+//
+XML_NODE *
+PlistDictFind (
+  XML_NODE     *Node,
+  CONST CHAR8  *Key
+  );
+
 //
 // @return key value for valid type or NULL.
 //
@@ -21,48 +21,6 @@
 
 #include "OcAppleDiskImageLibInternal.h"
 
-STATIC
-BOOLEAN
-InternalFindPlistDictChild (
-  IN  XML_NODE  *Node,
-  IN  CHAR8     *KeyName,
-  OUT XML_NODE  **Key,
-  OUT XML_NODE  **Value
-  )
-{
-  UINT32      ChildCount;
-  XML_NODE    *ChildValue;
-  XML_NODE    *ChildKey;
-  CONST CHAR8 *ChildKeyName;
-  UINT32      Index;
-
-  ASSERT (Node != NULL);
-  ASSERT (KeyName != NULL);
-  ASSERT (Key != NULL);
-  ASSERT (Value != NULL);
-
-  ChildCount = PlistDictChildren (Node);
-  for (Index = 0; Index < ChildCount; ++Index) {
-    ChildKey = PlistDictChild (Node, Index, &ChildValue);
-    if (ChildKey == NULL) {
-      break;
-    }
-
-    ChildKeyName = PlistKeyValue (ChildKey);
-    if (ChildKeyName == NULL) {
-      break;
-    }
-
-    if (AsciiStrCmp (ChildKeyName, KeyName) == 0) {
-      *Key   = ChildKey;
-      *Value = ChildValue;
-      return TRUE;
-    }
-  }
-
-  return FALSE;
-}
-
 STATIC
 BOOLEAN
 InternalSwapBlockData (
@@ -172,13 +130,10 @@ InternalParsePlist (
 
   XML_DOCUMENT                *XmlPlistDoc;
   XML_NODE                    *NodeRoot;
-  XML_NODE                    *NodeResourceForkKey;
   XML_NODE                    *NodeResourceForkValue;
-  XML_NODE                    *NodeBlockListKey;
   XML_NODE                    *NodeBlockListValue;
 
   XML_NODE                    *NodeBlockDict;
-  XML_NODE                    *BlockDictChildKey;
   XML_NODE                    *BlockDictChildValue;
   UINT32                      BlockDictChildDataSize;
 
@@ -210,23 +165,15 @@ InternalParsePlist (
     goto DONE_ERROR;
   }
 
-  Result = InternalFindPlistDictChild (
-             NodeRoot,
-             DMG_PLIST_RESOURCE_FORK_KEY,
-             &NodeResourceForkKey,
-             &NodeResourceForkValue
-             );
-  if (!Result) {
+  NodeResourceForkValue = PlistDictFind (NodeRoot, DMG_PLIST_RESOURCE_FORK_KEY);
+  if (NodeResourceForkValue == NULL) {
+    Result = FALSE;
     goto DONE_ERROR;
   }
 
-  Result = InternalFindPlistDictChild (
-             NodeResourceForkValue,
-             DMG_PLIST_BLOCK_LIST_KEY,
-             &NodeBlockListKey,
-             &NodeBlockListValue
-             );
-  if (!Result) {
+  NodeBlockListValue = PlistDictFind (NodeResourceForkValue, DMG_PLIST_BLOCK_LIST_KEY);
+  if (NodeBlockListValue == NULL) {
+    Result = FALSE;
     goto DONE_ERROR;
   }
 
@@ -250,13 +197,9 @@ InternalParsePlist (
   for (Index = 0; Index < NumDmgBlocks; ++Index) {
     NodeBlockDict = XmlNodeChild (NodeBlockListValue, Index);
 
-    Result = InternalFindPlistDictChild (
-               NodeBlockDict,
-               DMG_PLIST_DATA,
-               &BlockDictChildKey,
-               &BlockDictChildValue
-               );
-    if (!Result) {
+    BlockDictChildValue = PlistDictFind (NodeBlockDict, DMG_PLIST_DATA);
+    if (BlockDictChildValue == NULL) {
+      Result = FALSE;
       goto DONE_ERROR;
     }
 
@@ -14,6 +14,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 #include <Base.h>
 
+#include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/OcAppleKernelLib.h>
 
@@ -94,9 +95,11 @@ PatchAppleCpuPmCfgLock (
   IN OUT PRELINKED_CONTEXT  *Context
   )
 {
-  RETURN_STATUS       Status;
-  RETURN_STATUS       Status2;
-  PATCHER_CONTEXT     Patcher;
+  RETURN_STATUS          Status;
+  RETURN_STATUS          Statuses[2];
+  PATCHER_CONTEXT        Patcher;
+  PATCHER_GENERIC_PATCH  Patches[2];
+  UINT32                 Index;
 
   Status = PatcherInitContextFromPrelinked (
     &Patcher,
@@ -105,23 +108,22 @@ PatchAppleCpuPmCfgLock (
     );
 
   if (!RETURN_ERROR (Status)) {
-    Status = PatcherApplyGenericPatch (&Patcher, &mAppleIntelCPUPowerManagementPatch);
-    if (RETURN_ERROR (Status)) {
-      DEBUG ((DEBUG_INFO, "Failed to apply patch com.apple.driver.AppleIntelCPUPowerManagement - %r\n", Status));
-    } else {
-      DEBUG ((DEBUG_INFO, "Patch success com.apple.driver.AppleIntelCPUPowerManagement\n"));
-    }
-    Status2 = PatcherApplyGenericPatch (&Patcher, &mAppleIntelCPUPowerManagementPatch2);
-    if (RETURN_ERROR (Status2)) {
-      DEBUG ((DEBUG_INFO, "Failed to apply patch com.apple.driver.AppleIntelCPUPowerManagement - %r\n", Status2));
-    } else {
-      DEBUG ((DEBUG_INFO, "Patch success com.apple.driver.AppleIntelCPUPowerManagement\n"));
+    CopyMem (&Patches[0], &mAppleIntelCPUPowerManagementPatch, sizeof (Patches[0]));
+    CopyMem (&Patches[1], &mAppleIntelCPUPowerManagementPatch2, sizeof (Patches[1]));
+
+    Status = PatcherApplyGenericPatches (&Patcher, Patches, ARRAY_SIZE (Patches), Statuses);
+    for (Index = 0; Index < ARRAY_SIZE (Statuses); ++Index) {
+      if (RETURN_ERROR (Statuses[Index])) {
+        DEBUG ((DEBUG_INFO, "Failed to apply patch com.apple.driver.AppleIntelCPUPowerManagement - %r\n", Statuses[Index]));
+      } else {
+        DEBUG ((DEBUG_INFO, "Patch success com.apple.driver.AppleIntelCPUPowerManagement\n"));
+      }
     }
   } else {
     DEBUG ((DEBUG_INFO, "Failed to find com.apple.driver.AppleIntelCPUPowerManagement - %r\n", Status));
   }
 
-  return RETURN_ERROR (Status) ? Status : Status2;
+  return Status;
 }
 
 #pragma pack(push, 1)
@@ -18,6 +18,7 @@
 #include <IndustryStandard/AppleFatBinaryImage.h>
 
 #include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/OcAppleKernelLib.h>
@@ -123,6 +124,199 @@ ParseFatArchitecture (
   return 0;
 }
 
+//
+// Compressed kernel read context.
+// Two buffers are used, so that the next block is read while
+// the previous one is decompressed.
+//
+typedef struct {
+  EFI_FILE_PROTOCOL  *File;
+  //
+  // File offset and size of the data not yet requested.
+  //
+  UINT32             Offset;
+  UINT32             Left;
+  //
+  // Block buffers or NULL for unbuffered reading.
+  //
+  UINT8              *Buffers[2];
+  UINT32             Sizes[2];
+  //
+  // Buffer being consumed and position within it.
+  //
+  UINT32             Current;
+  UINT32             Position;
+  //
+  // Read pending into the other buffer.
+  //
+  BOOLEAN            Pending;
+  EFI_FILE_IO_TOKEN  Token;
+} KERNEL_READ_CONTEXT;
+
+STATIC
+RETURN_STATUS
+KernelReadNextBlock (
+  IN OUT KERNEL_READ_CONTEXT  *Context
+  )
+{
+  RETURN_STATUS  Status;
+  UINT32         Next;
+
+  ASSERT (!Context->Pending);
+
+  if (Context->Left == 0) {
+    return RETURN_SUCCESS;
+  }
+
+  Next                 = Context->Current ^ 1U;
+  Context->Sizes[Next] = MIN (Context->Left, OC_DECOMPRESS_STREAM_CHUNK_SIZE);
+
+  Status = GetFileDataAsync (
+    Context->File,
+    Context->Offset,
+    Context->Sizes[Next],
+    Context->Buffers[Next],
+    &Context->Token
+    );
+  if (RETURN_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "Comp kernel (%u bytes) cannot be read at %08X - %r\n", Context->Sizes[Next], Context->Offset, Status));
+    return Status;
+  }
+
+  Context->Offset += Context->Sizes[Next];
+  Context->Left   -= Context->Sizes[Next];
+  Context->Pending = TRUE;
+
+  return RETURN_SUCCESS;
+}
+
+STATIC
+RETURN_STATUS
+KernelReadCompleteBlock (
+  IN OUT KERNEL_READ_CONTEXT  *Context
+  )
+{
+  RETURN_STATUS  Status;
+
+  if (!Context->Pending) {
+    return RETURN_END_OF_FILE;
+  }
+
+  Context->Pending  = FALSE;
+  Context->Current ^= 1U;
+  Context->Position = 0;
+
+  Status = GetFileDataComplete (Context->File, &Context->Token, Context->Sizes[Context->Current]);
+  if (RETURN_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "Comp kernel (%u bytes) cannot be read - %r\n", Context->Sizes[Context->Current], Status));
+  }
+
+  return Status;
+}
+
+STATIC
+BOOLEAN
+ReadCompressedKernel (
+  IN OUT VOID    *Context,
+     OUT UINT8   *Buffer,
+  IN     UINT32  Size
+  )
+{
+  RETURN_STATUS        Status;
+  KERNEL_READ_CONTEXT  *ReadContext;
+  UINT32               Available;
+
+  ReadContext = (KERNEL_READ_CONTEXT *) Context;
+
+  if (ReadContext->Buffers[0] == NULL) {
+    Status = GetFileData (ReadContext->File, ReadContext->Offset, Size, Buffer);
+    if (RETURN_ERROR (Status)) {
+      DEBUG ((DEBUG_INFO, "Comp kernel (%u bytes) cannot be read at %08X\n", Size, ReadContext->Offset));
+      return FALSE;
+    }
+
+    ReadContext->Offset += Size;
+    return TRUE;
+  }
+
+  while (Size > 0) {
+    Available = ReadContext->Sizes[ReadContext->Current] - ReadContext->Position;
+    if (Available == 0) {
+      //
+      // Wait for the next block and immediately request the one after it,
+      // so that it is read while this one is being decompressed.
+      //
+      Status = KernelReadCompleteBlock (ReadContext);
+      if (!RETURN_ERROR (Status)) {
+        Status = KernelReadNextBlock (ReadContext);
+      }
+      if (RETURN_ERROR (Status)) {
+        return FALSE;
+      }
+      continue;
+    }
+
+    Available = MIN (Available, Size);
+    CopyMem (
+      Buffer,
+      &ReadContext->Buffers[ReadContext->Current][ReadContext->Position],
+      Available
+      );
+    ReadContext->Position += Available;
+    Buffer                += Available;
+    Size                  -= Available;
+  }
+
+  return TRUE;
+}
+
+STATIC
+VOID
+KernelReadInit (
+  OUT KERNEL_READ_CONTEXT  *Context,
+  IN  EFI_FILE_PROTOCOL    *File,
+  IN  UINT32               Offset,
+  IN  UINT32               Size
+  )
+{
+  ZeroMem (Context, sizeof (*Context));
+  Context->File   = File;
+  Context->Offset = Offset;
+  Context->Left   = Size;
+
+  Context->Buffers[0] = AllocatePool (OC_DECOMPRESS_STREAM_CHUNK_SIZE * 2);
+  if (Context->Buffers[0] == NULL) {
+    return;
+  }
+
+  Context->Buffers[1] = Context->Buffers[0] + OC_DECOMPRESS_STREAM_CHUNK_SIZE;
+
+  //
+  // Current buffer is empty, so the first read waits for this block.
+  //
+  Context->Current = 1;
+  if (RETURN_ERROR (KernelReadNextBlock (Context))) {
+    //
+    // Leave the error to be reported by the first read.
+    //
+    Context->Left = 0;
+  }
+}
+
+STATIC
+VOID
+KernelReadFree (
+  IN OUT KERNEL_READ_CONTEXT  *Context
+  )
+{
+  if (Context->Buffers[0] != NULL) {
+    if (Context->Pending) {
+      KernelReadCompleteBlock (Context);
+    }
+    FreePool (Context->Buffers[0]);
+  }
+}
+
 STATIC
 UINT32
 ParseCompressedHeader (
@@ -135,13 +329,14 @@ ParseCompressedHeader (
 {
   RETURN_STATUS       Status;
 
-  UINT32            KernelSize;
-  MACH_COMP_HEADER  *CompHeader;
-  UINT8             *CompressedBuffer;
-  UINT32            CompressionType;
-  UINT32            CompressedSize;
-  UINT32            DecompressedSize;
-  UINT32            DecompressedHash;
+  UINT32               KernelSize;
+  MACH_COMP_HEADER     *CompHeader;
+  KERNEL_READ_CONTEXT  ReadContext;
+  UINT32               CompressionType;
+  UINT32               CompressedSize;
+  UINT32               DecompressedSize;
+  UINT32               DecompressedHash;
+  UINT32               Hash;
 
   CompHeader       = (MACH_COMP_HEADER *)*Buffer;
   CompressionType  = CompHeader->Compression;
@@ -165,36 +360,28 @@ ParseCompressedHeader (
     return KernelSize;
   }
 
-  CompressedBuffer = AllocatePool (CompressedSize);
-  if (CompressedBuffer == NULL) {
-    DEBUG ((DEBUG_INFO, "Comp kernel (%u bytes) cannot be allocated at %08X\n", CompressedSize, Offset));
-    return KernelSize;
-  }
-
-  Status = GetFileData (File, Offset + sizeof (MACH_COMP_HEADER), CompressedSize, CompressedBuffer);
-  if (RETURN_ERROR (Status)) {
-    DEBUG ((DEBUG_INFO, "Comp kernel (%u bytes) cannot be read at %08X\n", CompressedSize, Offset));
-    FreePool (CompressedBuffer);
-    return KernelSize;
-  }
+  //
+  // Compressed data is read in blocks and streamed into the decompressor,
+  // which also calculates the checksum of the output along the way.
+  //
+  KernelReadInit (&ReadContext, File, Offset + sizeof (MACH_COMP_HEADER), CompressedSize);
+  Hash = 0;
 
   if (CompressionType == MACH_COMPRESSED_BINARY_INVERT_LZVN) {
-    KernelSize = (UINT32)DecompressLZVN (*Buffer, DecompressedSize, CompressedBuffer, CompressedSize);
+    KernelSize = DecompressStreamLZVN (*Buffer, DecompressedSize, CompressedSize, ReadCompressedKernel, &ReadContext, &Hash);
   } else if (CompressionType == MACH_COMPRESSED_BINARY_INVERT_LZSS) {
-    KernelSize = (UINT32)DecompressLZSS (*Buffer, DecompressedSize, CompressedBuffer, CompressedSize);
+    KernelSize = DecompressStreamLZSS (*Buffer, DecompressedSize, CompressedSize, ReadCompressedKernel, &ReadContext, &Hash);
   }
 
+  KernelReadFree (&ReadContext);
+
   if (KernelSize != DecompressedSize) {
     KernelSize = 0;
+  } else if (Hash != DecompressedHash) {
+    DEBUG ((DEBUG_INFO, "Comp kernel invalid hash %08X, expected %08X at %08X\n", Hash, DecompressedHash, Offset));
+    KernelSize = 0;
   }
 
-  //
-  // TODO: implement adler32 hash verification.
-  //
-  (VOID) DecompressedHash;
-
-  FreePool (CompressedBuffer);
-
   return KernelSize;
 }
 
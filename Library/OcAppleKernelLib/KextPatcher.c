@@ -19,9 +19,11 @@
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
 #include <Library/OcAppleKernelLib.h>
 #include <Library/OcMachoLib.h>
 #include <Library/OcMiscLib.h>
+#include <Library/OcStringLib.h>
 #include <Library/OcXmlLib.h>
 
 #include "PrelinkedInternal.h"
@@ -118,6 +120,116 @@ PatcherGetSymbolAddress (
   return RETURN_SUCCESS;
 }
 
+RETURN_STATUS
+PatcherGetSymbolAddresses (
+  IN OUT PATCHER_CONTEXT    *Context,
+  IN     CONST CHAR8        **Names,
+  IN     UINT32             NumNames,
+     OUT UINT8              **Addresses
+  )
+{
+  MACH_NLIST_64  *Symbol;
+  CONST CHAR8    *SymbolName;
+  UINT32         *NameIndex;
+  UINT32         *NameHashes;
+  UINT32         IndexMask;
+  UINT32         Slot;
+  UINT32         Hash;
+  UINT32         Offset;
+  UINT32         Index;
+  UINT32         NumLeft;
+  RETURN_STATUS  Status;
+
+  ASSERT (Names != NULL || NumNames == 0);
+  ASSERT (Addresses != NULL || NumNames == 0);
+
+  ZeroMem (Addresses, NumNames * sizeof (*Addresses));
+
+  //
+  // Build a transient hash index of the requested names, so that the symbol
+  // table is walked only once. Slots contain name index plus one.
+  //
+  IndexMask  = (GetPowerOfTwo32 (NumNames | 1U) << 2U) - 1;
+  NameIndex  = AllocateZeroPool ((IndexMask + 1 + NumNames) * sizeof (*NameIndex));
+  if (NameIndex == NULL) {
+    return RETURN_OUT_OF_RESOURCES;
+  }
+
+  NameHashes = &NameIndex[IndexMask + 1];
+  NumLeft    = 0;
+  Status     = RETURN_SUCCESS;
+
+  for (Index = 0; Index < NumNames; ++Index) {
+    if (Names[Index] == NULL) {
+      continue;
+    }
+
+    NameHashes[Index] = AsciiStrHash (Names[Index], NULL);
+    Slot = NameHashes[Index] & IndexMask;
+    while (NameIndex[Slot] != 0) {
+      Slot = (Slot + 1) & IndexMask;
+    }
+    NameIndex[Slot] = Index + 1;
+    ++NumLeft;
+  }
+
+  for (Index = 0; NumLeft > 0; ++Index) {
+    Symbol = MachoGetSymbolByIndex64 (&Context->MachContext, Index);
+    if (Symbol == NULL) {
+      break;
+    }
+
+    SymbolName = MachoGetSymbolName64 (&Context->MachContext, Symbol);
+    if (SymbolName == NULL) {
+      continue;
+    }
+
+    Hash = AsciiStrHash (SymbolName, NULL);
+    //
+    // Resolve every name matching this symbol, as names may repeat.
+    // The first matching symbol wins like in PatcherGetSymbolAddress.
+    //
+    for (Slot = Hash & IndexMask; NameIndex[Slot] != 0; Slot = (Slot + 1) & IndexMask) {
+      if (NameIndex[Slot] == MAX_UINT32
+        || NameHashes[NameIndex[Slot] - 1] != Hash
+        || Addresses[NameIndex[Slot] - 1] != NULL
+        || AsciiStrCmp (Names[NameIndex[Slot] - 1], SymbolName) != 0) {
+        continue;
+      }
+
+      if (!MachoSymbolGetFileOffset64 (&Context->MachContext, Symbol, &Offset, NULL)) {
+        //
+        // Do not look for this name further, it is reported as invalid like
+        // in PatcherGetSymbolAddress. Every duplicate of the name fails
+        // the same way, so keep probing.
+        // Leave a tombstone to keep the probe sequence intact.
+        //
+        Status          = RETURN_INVALID_PARAMETER;
+        NameIndex[Slot] = MAX_UINT32;
+        --NumLeft;
+        continue;
+      }
+
+      Addresses[NameIndex[Slot] - 1] = (UINT8 *)MachoGetMachHeader64 (&Context->MachContext) + Offset;
+      --NumLeft;
+    }
+  }
+
+  FreePool (NameIndex);
+
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  for (Index = 0; Index < NumNames; ++Index) {
+    if (Names[Index] != NULL && Addresses[Index] == NULL) {
+      return RETURN_NOT_FOUND;
+    }
+  }
+
+  return RETURN_SUCCESS;
+}
+
 RETURN_STATUS
 PatcherApplyGenericPatch (
   IN OUT PATCHER_CONTEXT        *Context,
@@ -180,6 +292,149 @@ PatcherApplyGenericPatch (
   return RETURN_NOT_FOUND;
 }
 
+RETURN_STATUS
+PatcherApplyGenericPatches (
+  IN OUT PATCHER_CONTEXT        *Context,
+  IN     PATCHER_GENERIC_PATCH  *Patches,
+  IN     UINT32                 NumPatches,
+     OUT RETURN_STATUS          *Statuses  OPTIONAL
+  )
+{
+  RETURN_STATUS  Status;
+  RETURN_STATUS  Result;
+  UINT8          *Header;
+  UINT8          *Base;
+  UINT32         Size;
+  UINT32         FileSize;
+  UINT32         Index;
+  CONST CHAR8    **Names;
+  UINT8          **Bases;
+  OC_DATA_PATCH  *DataPatches;
+
+  if (NumPatches == 0) {
+    return RETURN_SUCCESS;
+  }
+
+  DataPatches = AllocateZeroPool (
+    NumPatches * (sizeof (*DataPatches) + sizeof (*Names) + sizeof (*Bases))
+    );
+  if (DataPatches == NULL) {
+    //
+    // Fallback to applying the patches one by one.
+    //
+    Result = RETURN_SUCCESS;
+    for (Index = 0; Index < NumPatches; ++Index) {
+      Status = PatcherApplyGenericPatch (Context, &Patches[Index]);
+      if (Statuses != NULL) {
+        Statuses[Index] = Status;
+      }
+      if (RETURN_ERROR (Status) && !RETURN_ERROR (Result)) {
+        Result = Status;
+      }
+    }
+    return Result;
+  }
+
+  Names = (CONST CHAR8 **)(DataPatches + NumPatches);
+  Bases = (UINT8 **)(Names + NumPatches);
+
+  for (Index = 0; Index < NumPatches; ++Index) {
+    Names[Index] = Patches[Index].Base;
+  }
+
+  //
+  // Missing symbols are reported per patch below.
+  //
+  PatcherGetSymbolAddresses (Context, Names, NumPatches, Bases);
+
+  Header   = (UINT8 *)MachoGetMachHeader64 (&Context->MachContext);
+  FileSize = MachoGetFileSize (&Context->MachContext);
+  Result   = RETURN_SUCCESS;
+
+  for (Index = 0; Index < NumPatches; ++Index) {
+    Status = RETURN_SUCCESS;
+    Base   = Header;
+    Size   = FileSize;
+
+    if (Patches[Index].Base != NULL) {
+      Base = Bases[Index];
+      if (Base == NULL) {
+        Status = RETURN_NOT_FOUND;
+      } else {
+        Size -= (UINT32)(Base - Header);
+      }
+    }
+
+    if (!RETURN_ERROR (Status)) {
+      if (Patches[Index].Find == NULL) {
+        if (Size < Patches[Index].Size) {
+          Status = RETURN_NOT_FOUND;
+        }
+      } else if (Patches[Index].Size == 0) {
+        Status = RETURN_NOT_FOUND;
+      } else if (Patches[Index].Limit > 0 && Patches[Index].Limit < Size) {
+        Size = Patches[Index].Limit;
+      }
+    }
+
+    //
+    // PatternSize is only set for the patches applied in a single pass,
+    // these are applied in list order including the ones with no Find.
+    //
+    if (!RETURN_ERROR (Status) && Patches[Index].Size > 0) {
+      DataPatches[Index].Pattern     = Patches[Index].Find;
+      DataPatches[Index].PatternMask = Patches[Index].Mask;
+      DataPatches[Index].Replace     = Patches[Index].Replace;
+      DataPatches[Index].ReplaceMask = Patches[Index].Find != NULL ? Patches[Index].ReplaceMask : NULL;
+      DataPatches[Index].PatternSize = Patches[Index].Size;
+      DataPatches[Index].Count       = Patches[Index].Count;
+      DataPatches[Index].Skip        = Patches[Index].Skip;
+      DataPatches[Index].DataOffset  = (UINT32)(Base - Header);
+      DataPatches[Index].DataSize    = Size;
+      continue;
+    }
+
+    if (Statuses != NULL) {
+      Statuses[Index] = Status;
+    }
+    if (RETURN_ERROR (Status) && !RETURN_ERROR (Result)) {
+      Result = Status;
+    }
+  }
+
+  ApplyPatches (DataPatches, NumPatches, Header, FileSize);
+
+  for (Index = 0; Index < NumPatches; ++Index) {
+    if (DataPatches[Index].PatternSize == 0) {
+      continue;
+    }
+
+    if (DataPatches[Index].Pattern != NULL
+      && DataPatches[Index].ReplaceCount > 0
+      && Patches[Index].Count > 0
+      && DataPatches[Index].ReplaceCount != Patches[Index].Count) {
+      DEBUG ((
+        DEBUG_INFO,
+        "Performed only %u replacements out of %u\n",
+        DataPatches[Index].ReplaceCount,
+        Patches[Index].Count
+        ));
+    }
+
+    Status = DataPatches[Index].ReplaceCount > 0 ? RETURN_SUCCESS : RETURN_NOT_FOUND;
+    if (Statuses != NULL) {
+      Statuses[Index] = Status;
+    }
+    if (RETURN_ERROR (Status) && !RETURN_ERROR (Result)) {
+      Result = Status;
+    }
+  }
+
+  FreePool (DataPatches);
+
+  return Result;
+}
+
 RETURN_STATUS
 PatcherBlockKext (
   IN OUT PATCHER_CONTEXT        *Context
@@ -24,6 +24,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Library/OcAppleKernelLib.h>
 #include <Library/OcGuardLib.h>
 #include <Library/OcMachoLib.h>
+#include <Library/OcStringLib.h>
 
 #include "PrelinkedInternal.h"
 
@@ -40,57 +41,54 @@ InternalOcGetSymbolWorkerName (
   IN PRELINKED_KEXT                   *Kext,
   IN CONST CHAR8                      *LookupValue,
   IN UINT32                           LookupValueLength,
+  IN UINT32                           LookupValueHash,
   IN OC_GET_SYMBOL_LEVEL              SymbolLevel
   )
 {
   PRELINKED_KEXT              *Dependency;
   CONST PRELINKED_KEXT_SYMBOL *Symbols;
-  CONST PRELINKED_KEXT_SYMBOL *SymbolsEnd;
+  CONST UINT32                *SymbolIndex;
   UINT32                      Index;
-  UINT32                      NumSymbols;
+  UINT32                      IndexMask;
+  UINT32                      Slot;
+  UINT32                      FirstSymbol;
 
   //
   // Block any 1+ level dependencies.
   //
   Kext->Processed = TRUE;
 
-  NumSymbols = Kext->NumberOfSymbols;
-  Symbols    = Kext->LinkedSymbolTable;
-
+  FirstSymbol = 0;
   if (SymbolLevel == OcGetSymbolOnlyCxx) {
-    NumSymbols = Kext->NumberOfCxxSymbols;
-    Symbols    = &Kext->LinkedSymbolTable[Kext->NumberOfSymbols - Kext->NumberOfCxxSymbols];
+    FirstSymbol = Kext->NumberOfSymbols - Kext->NumberOfCxxSymbols;
   }
 
-  SymbolsEnd = &Symbols[NumSymbols];
-  while (Symbols < SymbolsEnd) {
-    //
-    // Symbol names often start and end similarly due to C++ mangling (e.g. __ZN).
-    // To optimise the lookup we compare their length check in the middle.
-    // Please do not change this without careful profiling.
-    //
-    if (Symbols->Length == LookupValueLength) {
-      if (Symbols->Name[LookupValueLength / 2] == LookupValue[LookupValueLength / 2]
-        && Symbols->Name[(LookupValueLength / 2) + 1] == LookupValue[(LookupValueLength / 2) + 1]) {
-        for (Index = 0; Index < LookupValueLength; ++Index) {
-          if (Symbols->Name[Index] != LookupValue[Index]) {
-            break;
-          }
-        }
-        if (Index == LookupValueLength) {
-          return Symbols;
-        }
-      }
+  //
+  // Walk the probe sequence of the name hash index. Symbols are indexed in
+  // LinkedSymbolTable order, so the first match is the same as with linear
+  // table walk. C++ symbols are at the end of the table, hence filtering by
+  // index is sufficient to restrict the lookup to them.
+  //
+  SymbolIndex = Kext->LinkedSymbolIndex;
+  IndexMask   = Kext->LinkedSymbolIndexMask;
+  Slot        = LookupValueHash & IndexMask;
+
+  while (SymbolIndex[Slot] != 0) {
+    Index   = SymbolIndex[Slot] - 1;
+    Symbols = &Kext->LinkedSymbolTable[Index];
+    if (Symbols->Hash == LookupValueHash
+      && Symbols->Length == LookupValueLength
+      && Index >= FirstSymbol
+      && CompareMem (Symbols->Name, LookupValue, LookupValueLength) == 0) {
+      return Symbols;
     }
-    Symbols++;
+
+    Slot = (Slot + 1) & IndexMask;
   }
 
   if (SymbolLevel != OcGetSymbolFirstLevel) {
-    for (Index = 0; Index < ARRAY_SIZE (Kext->Dependencies); ++Index) {
+    for (Index = 0; Index < Kext->NumberOfDependencies; ++Index) {
       Dependency = Kext->Dependencies[Index];
-      if (Dependency == NULL) {
-        return NULL;
-      }
 
       if (Dependency->Processed) {
         continue;
@@ -100,6 +98,7 @@ InternalOcGetSymbolWorkerName (
                  Dependency,
                  LookupValue,
                  LookupValueLength,
+                 LookupValueHash,
                  OcGetSymbolOnlyCxx
                  );
       if (Symbols != NULL) {
@@ -119,46 +118,56 @@ InternalOcGetSymbolWorkerValue (
   IN OC_GET_SYMBOL_LEVEL              SymbolLevel
   )
 {
-  PRELINKED_KEXT              *Dependency;
-  CONST PRELINKED_KEXT_SYMBOL *Symbols;
-  CONST PRELINKED_KEXT_SYMBOL *SymbolsEnd;
-  UINT32                      Index;
-  UINT32                      NumSymbols;
+  PRELINKED_KEXT                    *Dependency;
+  CONST PRELINKED_KEXT_SYMBOL       *Symbols;
+  CONST PRELINKED_KEXT_SYMBOL_VALUE *Values;
+  CONST PRELINKED_KEXT_SYMBOL_VALUE *ValuesEnd;
+  UINT32                            Index;
+  UINT32                            NumValues;
+  UINT32                            Half;
+  UINT32                            FirstSymbol;
 
   //
   // Block any 1+ level dependencies.
   //
   Kext->Processed = TRUE;
 
-  NumSymbols = Kext->NumberOfSymbols;
-  Symbols    = Kext->LinkedSymbolTable;
-
+  FirstSymbol = 0;
   if (SymbolLevel == OcGetSymbolOnlyCxx) {
-    NumSymbols = Kext->NumberOfCxxSymbols;
-    Symbols    = &Kext->LinkedSymbolTable[(Kext->NumberOfSymbols - Kext->NumberOfCxxSymbols) & ~15ULL];
+    FirstSymbol = Kext->NumberOfSymbols - Kext->NumberOfCxxSymbols;
   }
+
   //
   // WARN! Hot path! Do not change this code unless you have decent profiling data.
-  // We are not allowed to use SIMD in UEFI, but we can still do better with larger iteration.
-  // Up to 15 C symbols extra may get parsed, but it is fine, as they will not match.
-  // Increasing the iteration block to more than 16 no longer pays off.
-  // Note, lower loop is not on hot path.
+  // This is called for every vtable entry, so we do a branchless lower bound
+  // search in the value-sorted index, which the compiler turns into cmov.
+  // Values are sorted by symbol index when equal, so the first match is the
+  // same as with linear LinkedSymbolTable walk.
   //
-  SymbolsEnd = &Symbols[NumSymbols & ~15ULL];
-  while (Symbols < SymbolsEnd) {
-    #define MATCH(X) if (Symbols[X].Value == LookupValue) { return &Symbols[X]; }
-    MATCH (0) MATCH (1) MATCH (2)  MATCH (3)  MATCH (4)  MATCH (5)  MATCH (6)  MATCH (7)
-    MATCH (8) MATCH (9) MATCH (10) MATCH (11) MATCH (12) MATCH (13) MATCH (14) MATCH (15)
-    #undef MATCH
-    Symbols += 16;
+  NumValues = Kext->NumberOfSymbols;
+  Values    = Kext->LinkedSymbolValues;
+  ValuesEnd = &Values[NumValues];
+
+  if (NumValues > 0) {
+    while (NumValues > 1) {
+      Half       = NumValues / 2;
+      Values     = (Values[Half].Value < LookupValue) ? &Values[Half] : Values;
+      NumValues -= Half;
+    }
+
+    Values += (Values->Value < LookupValue);
+
+    while (Values < ValuesEnd && Values->Value == LookupValue) {
+      if (Values->Index >= FirstSymbol) {
+        return &Kext->LinkedSymbolTable[Values->Index];
+      }
+      ++Values;
+    }
   }
 
   if (SymbolLevel != OcGetSymbolFirstLevel) {
-    for (Index = 0; Index < ARRAY_SIZE (Kext->Dependencies); ++Index) {
+    for (Index = 0; Index < Kext->NumberOfDependencies; ++Index) {
       Dependency = Kext->Dependencies[Index];
-      if (Dependency == NULL) {
-        return NULL;
-      }
 
       if (Dependency->Processed) {
         continue;
@@ -191,9 +200,12 @@ InternalOcGetSymbolName (
   PRELINKED_KEXT              *Dependency;
   UINT32                      Index;
   UINT32                      LookupValueLength;
+  UINT32                      LookupValueHash;
+  UINTN                       NameLength;
 
   Symbol = NULL;
-  LookupValueLength = (UINT32)AsciiStrLen (LookupValue);
+  LookupValueHash   = AsciiStrHash (LookupValue, &NameLength);
+  LookupValueLength = (UINT32)NameLength;
 
   //
   // Such symbols are illegit, but InternalOcGetSymbolWorkerName assumes Length > 0.
@@ -207,19 +219,18 @@ InternalOcGetSymbolName (
       Kext,
       LookupValue,
       LookupValueLength,
+      LookupValueHash,
       SymbolLevel
       );
   } else {
-    for (Index = 0; Index < ARRAY_SIZE (Kext->Dependencies); ++Index) {
+    for (Index = 0; Index < Kext->NumberOfDependencies; ++Index) {
       Dependency = Kext->Dependencies[Index];
-      if (Dependency == NULL) {
-        break;
-      }
 
       Symbol = InternalOcGetSymbolWorkerName (
                  Dependency,
                  LookupValue,
                  LookupValueLength,
+                 LookupValueHash,
                  SymbolLevel
                  );
       if (Symbol != NULL) {
@@ -251,11 +262,8 @@ InternalOcGetSymbolValue (
   if ((SymbolLevel == OcGetSymbolOnlyCxx) && (Kext->LinkedSymbolTable != NULL)) {
     Symbol = InternalOcGetSymbolWorkerValue (Kext, LookupValue, SymbolLevel);
   } else {
-    for (Index = 0; Index < ARRAY_SIZE (Kext->Dependencies); ++Index) {
+    for (Index = 0; Index < Kext->NumberOfDependencies; ++Index) {
       Dependency = Kext->Dependencies[Index];
-      if (Dependency == NULL) {
-        break;
-      }
 
       Symbol = InternalOcGetSymbolWorkerValue (
                  Dependency,
@@ -1411,8 +1419,12 @@ InternalPrelinkKext64 (
   }
   //
   // Create and patch the KEXT's VTables.
+  // Vtable patching looks up relocations by address for every vtable entry,
+  // so index them for the time of patching, as relocations are not changed.
   //
+  MachoEnableRelocationIndex (MachoContext);
   Result = InternalPatchByVtables64 (Context, Kext);
+  MachoDisableRelocationIndex (MachoContext);
   if (!Result) {
     DEBUG ((DEBUG_INFO, "Vtable patching failed for kext %a\n", Kext->Identifier));
     return RETURN_LOAD_ERROR;
@@ -33,11 +33,7 @@ PrelinkedFindLastLoadAddress (
   )
 {
   UINT32       KextCount;
-  UINT32       FieldIndex;
-  UINT32       FieldCount;
   XML_NODE     *LastKext;
-  CONST CHAR8  *KextPlistKey;
-  XML_NODE     *KextPlistValue;
   UINT64       LoadAddress;
   UINT64       LoadSize;
 
@@ -57,26 +53,9 @@ PrelinkedFindLastLoadAddress (
   LoadAddress = 0;
   LoadSize = 0;
 
-  FieldCount = PlistDictChildren (LastKext);
-  for (FieldIndex = 0; FieldIndex < FieldCount; ++FieldIndex) {
-    KextPlistKey = PlistKeyValue (PlistDictChild (LastKext, FieldIndex, &KextPlistValue));
-    if (KextPlistKey == NULL) {
-      continue;
-    }
-
-    if (LoadAddress == 0 && AsciiStrCmp (KextPlistKey, PRELINK_INFO_EXECUTABLE_LOAD_ADDR_KEY) == 0) {
-      if (!PlistIntegerValue (KextPlistValue, &LoadAddress, sizeof (LoadAddress), TRUE)) {
-        return 0;
-      }
-    } else if (LoadSize == 0 && AsciiStrCmp (KextPlistKey, PRELINK_INFO_EXECUTABLE_SIZE_KEY) == 0) {
-      if (!PlistIntegerValue (KextPlistValue, &LoadSize, sizeof (LoadSize), TRUE)) {
-        return 0;
-      }
-    }
-
-    if (LoadSize != 0 && LoadAddress != 0) {
-      break;
-    }
+  if (!PlistIntegerValue (PlistDictFind (LastKext, PRELINK_INFO_EXECUTABLE_LOAD_ADDR_KEY), &LoadAddress, sizeof (LoadAddress), TRUE)
+    || !PlistIntegerValue (PlistDictFind (LastKext, PRELINK_INFO_EXECUTABLE_SIZE_KEY), &LoadSize, sizeof (LoadSize), TRUE)) {
+    return 0;
   }
 
   if (OcOverflowAddU64 (LoadAddress, LoadSize, &LoadAddress)) {
@@ -142,10 +121,8 @@ PrelinkedContextInit (
   IN      UINT32             PrelinkedAllocSize
   )
 {
-  XML_NODE     *PrelinkedInfoRoot;
-  CONST CHAR8  *PrelinkedInfoRootKey;
-  UINT32       PrelinkedInfoRootIndex;
-  UINT32       PrelinkedInfoRootCount;
+  RETURN_STATUS  Status;
+  XML_NODE       *PrelinkedInfoRoot;
 
   ASSERT (Context != NULL);
   ASSERT (Prelinked != NULL);
@@ -154,6 +131,8 @@ PrelinkedContextInit (
 
   ZeroMem (Context, sizeof (*Context));
 
+  OcArenaInit (&Context->Arena, 0);
+
   Context->Prelinked          = Prelinked;
   Context->PrelinkedSize      = MACHO_ALIGN (PrelinkedSize);
   Context->PrelinkedAllocSize = PrelinkedAllocSize;
@@ -234,7 +213,7 @@ PrelinkedContextInit (
     return RETURN_OUT_OF_RESOURCES;
   }
 
-  Context->PrelinkedInfoDocument = XmlDocumentParse (Context->PrelinkedInfo, (UINT32)Context->PrelinkedInfoSection->Size, TRUE);
+  Context->PrelinkedInfoDocument = XmlDocumentParseLazy (Context->PrelinkedInfo, (UINT32)Context->PrelinkedInfoSection->Size, TRUE);
   if (Context->PrelinkedInfoDocument == NULL) {
     PrelinkedContextFree (Context);
     return RETURN_INVALID_PARAMETER;
@@ -246,21 +225,21 @@ PrelinkedContextInit (
     return RETURN_INVALID_PARAMETER;
   }
 
-  PrelinkedInfoRootCount = PlistDictChildren (PrelinkedInfoRoot);
-  for (PrelinkedInfoRootIndex = 0; PrelinkedInfoRootIndex < PrelinkedInfoRootCount; ++PrelinkedInfoRootIndex) {
-    PrelinkedInfoRootKey = PlistKeyValue (PlistDictChild (PrelinkedInfoRoot, PrelinkedInfoRootIndex, &Context->KextList));
-    if (PrelinkedInfoRootKey == NULL) {
-      continue;
-    }
-
-    if (AsciiStrCmp (PrelinkedInfoRootKey, PRELINK_INFO_DICTIONARY_KEY) == 0) {
-      if (PlistNodeCast (Context->KextList, PLIST_NODE_TYPE_ARRAY) != NULL) {
-        Context->PrelinkedLastLoadAddress = PrelinkedFindLastLoadAddress (Context->KextList);
-        if (Context->PrelinkedLastLoadAddress != 0) {
-          return RETURN_SUCCESS;
-        }
+  Context->KextList = PlistNodeCast (
+    PlistDictFind (PrelinkedInfoRoot, PRELINK_INFO_DICTIONARY_KEY),
+    PLIST_NODE_TYPE_ARRAY
+    );
+  if (Context->KextList != NULL) {
+    Context->PrelinkedLastLoadAddress = PrelinkedFindLastLoadAddress (Context->KextList);
+    Context->KextListParsedCount      = XmlNodeChildren (Context->KextList);
+    if (Context->PrelinkedLastLoadAddress != 0) {
+      Status = InternalCreateKextIndex (Context);
+      if (RETURN_ERROR (Status)) {
+        PrelinkedContextFree (Context);
+        return Status;
       }
-      break;
+
+      return RETURN_SUCCESS;
     }
   }
 
@@ -274,8 +253,6 @@ PrelinkedContextFree (
   )
 {
   UINT32          Index;
-  LIST_ENTRY      *Link;
-  PRELINKED_KEXT  *Kext;
 
   if (Context->PrelinkedInfoDocument != NULL) {
     XmlDocumentFree (Context->PrelinkedInfoDocument);
@@ -287,6 +264,11 @@ PrelinkedContextFree (
     Context->PrelinkedInfo = NULL;
   }
 
+  if (Context->PrelinkedInfoSource != NULL) {
+    FreePool (Context->PrelinkedInfoSource);
+    Context->PrelinkedInfoSource = NULL;
+  }
+
   if (Context->PooledBuffers != NULL) {
     for (Index = 0; Index < Context->PooledBuffersCount; ++Index) {
       FreePool (Context->PooledBuffers[Index]);
@@ -295,20 +277,32 @@ PrelinkedContextFree (
     Context->PooledBuffers = NULL;
   }
 
+  if (Context->KextIndex != NULL) {
+    FreePool (Context->KextIndex);
+    Context->KextIndex = NULL;
+  }
+
   if (Context->LinkBuffer != NULL) {
     ZeroMem (Context->LinkBuffer, Context->LinkBufferSize);
     FreePool (Context->LinkBuffer);
     Context->LinkBuffer = NULL;
   }
 
-  while (!IsListEmpty (&Context->PrelinkedKexts)) {
-    Link = GetFirstNode (&Context->PrelinkedKexts);
-    Kext = GET_PRELINKED_KEXT_FROM_LINK (Link);
-    RemoveEntryList (Link);
-    InternalFreePrelinkedKext (Kext);
-  }
-
+  //
+  // Kexts and their indices live in the arena.
+  //
   ZeroMem (&Context->PrelinkedKexts, sizeof (Context->PrelinkedKexts));
+
+  DEBUG ((
+    DEBUG_VERBOSE,
+    "OCK: Arena %u allocations, %u chunks, %u used, %u peak reserved\n",
+    (UINT32) Context->Arena.Stats.NumAllocations,
+    (UINT32) Context->Arena.Stats.NumChunks,
+    (UINT32) Context->Arena.Stats.UsedSize,
+    (UINT32) Context->Arena.Stats.PeakReservedSize
+    ));
+
+  OcArenaFree (&Context->Arena);
 }
 
 RETURN_STATUS
@@ -358,6 +352,17 @@ PrelinkedInjectPrepare (
 
   SegmentEndOffset = Context->PrelinkedInfoSegment->FileOffset + Context->PrelinkedInfoSegment->FileSize;
 
+  //
+  // Preserve original plist text for incremental export, as new kexts will
+  // overwrite it. Failing to do so is not fatal, as full export is still possible.
+  //
+  if (Context->PrelinkedInfoSource == NULL && Context->PrelinkedInfoSection->Size > 0) {
+    Context->PrelinkedInfoSource = AllocateCopyPool (
+      (UINTN) Context->PrelinkedInfoSection->Size,
+      &Context->Prelinked[Context->PrelinkedInfoSection->Offset]
+      );
+  }
+
   if (MACHO_ALIGN (SegmentEndOffset) == Context->PrelinkedSize) {
     Context->PrelinkedSize = (UINT32) MACHO_ALIGN (Context->PrelinkedInfoSegment->FileOffset);
   }
@@ -399,24 +404,57 @@ PrelinkedInjectComplete (
 {
   CHAR8       *ExportedInfo;
   UINT32      ExportedInfoSize;
-  UINT32      NewSize;
+  UINT32      AvailableSize;
+  BOOLEAN     Exported;
 
-  ExportedInfo = XmlDocumentExport (Context->PrelinkedInfoDocument, &ExportedInfoSize, 0);
-  if (ExportedInfo == NULL) {
-    return RETURN_OUT_OF_RESOURCES;
+  //
+  // Plist is exported straight into the prelinkedkernel, which must have
+  // enough space reserved.
+  //
+  if (Context->PrelinkedSize > Context->PrelinkedAllocSize) {
+    return RETURN_BUFFER_TOO_SMALL;
   }
 
+  ExportedInfo  = (CHAR8 *) &Context->Prelinked[Context->PrelinkedSize];
+  AvailableSize = Context->PrelinkedAllocSize - Context->PrelinkedSize;
+
   //
-  // Include \0 terminator.
+  // Avoid reserialising the whole plist when only new kexts were appended.
   //
-  ExportedInfoSize++;
+  Exported = FALSE;
+  if (Context->PrelinkedInfoSource != NULL) {
+    Exported = XmlDocumentExportAppended (
+      Context->PrelinkedInfoDocument,
+      Context->PrelinkedInfoSource,
+      Context->KextList,
+      Context->KextListParsedCount,
+      ExportedInfo,
+      AvailableSize,
+      &ExportedInfoSize
+      );
+    FreePool (Context->PrelinkedInfoSource);
+    Context->PrelinkedInfoSource = NULL;
+  }
 
-  if (OcOverflowAddU32 (Context->PrelinkedSize, MACHO_ALIGN (ExportedInfoSize), &NewSize)
-    || NewSize > Context->PrelinkedAllocSize) {
-    FreePool (ExportedInfo);
+  if (!Exported) {
+    Exported = XmlDocumentExportInto (
+      Context->PrelinkedInfoDocument,
+      ExportedInfo,
+      AvailableSize,
+      &ExportedInfoSize,
+      0
+      );
+  }
+
+  //
+  // Include \0 terminator.
+  //
+  if (!Exported || MACHO_ALIGN (ExportedInfoSize + 1) > AvailableSize) {
     return RETURN_BUFFER_TOO_SMALL;
   }
 
+  ExportedInfoSize++;
+
   Context->PrelinkedInfoSegment->VirtualAddress = Context->PrelinkedLastAddress;
   Context->PrelinkedInfoSegment->Size           = ExportedInfoSize;
   Context->PrelinkedInfoSegment->FileOffset     = Context->PrelinkedSize;
@@ -425,22 +463,14 @@ PrelinkedInjectComplete (
   Context->PrelinkedInfoSection->Size           = ExportedInfoSize;
   Context->PrelinkedInfoSection->Offset         = Context->PrelinkedSize;
 
-  CopyMem (
-    &Context->Prelinked[Context->PrelinkedSize],
-    ExportedInfo,
-    ExportedInfoSize
-    );
-
   ZeroMem (
-    &Context->Prelinked[Context->PrelinkedSize + ExportedInfoSize],
+    &ExportedInfo[ExportedInfoSize],
     MACHO_ALIGN (ExportedInfoSize) - ExportedInfoSize
     );
 
   Context->PrelinkedLastAddress += MACHO_ALIGN (ExportedInfoSize);
   Context->PrelinkedSize        += MACHO_ALIGN (ExportedInfoSize);
 
-  FreePool (ExportedInfo);
-
   return RETURN_SUCCESS;
 }
 
@@ -484,99 +514,392 @@ PrelinkedReserveKextSize (
 }
 
 RETURN_STATUS
-PrelinkedInjectKext (
-  IN OUT PRELINKED_CONTEXT  *Context,
-  IN     CONST CHAR8        *BundlePath,
-  IN     CONST CHAR8        *InfoPlist,
-  IN     UINT32             InfoPlistSize,
-  IN     CONST CHAR8        *ExecutablePath OPTIONAL,
-  IN     CONST UINT8        *Executable OPTIONAL,
-  IN     UINT32             ExecutableSize OPTIONAL
+PrelinkedReserveKextsSize (
+  IN OUT UINT32                       *ReservedSize,
+  IN     CONST PRELINKED_KEXT_BUNDLE  *Bundles,
+  IN     UINT32                       NumBundles
   )
 {
-  RETURN_STATUS     Status;
+  RETURN_STATUS  Status;
+  UINT32         Index;
+  UINT32         NewSize;
+
+  NewSize = *ReservedSize;
+
+  for (Index = 0; Index < NumBundles; ++Index) {
+    Status = PrelinkedReserveKextSize (
+      &NewSize,
+      Bundles[Index].InfoPlistSize,
+      (UINT8 *) Bundles[Index].Executable,
+      Bundles[Index].ExecutableSize
+      );
+    if (RETURN_ERROR (Status)) {
+      return Status;
+    }
+  }
 
-  XML_DOCUMENT      *InfoPlistDocument;
-  XML_NODE          *InfoPlistRoot;
-  CHAR8             *TmpInfoPlist;
-  CHAR8             *NewInfoPlist;
-  OC_MACHO_CONTEXT  ExecutableContext;
-  CONST CHAR8       *TmpKeyValue;
-  UINT32            FieldCount;
-  UINT32            FieldIndex;
-  UINT32            NewInfoPlistSize;
-  UINT32            NewPrelinkedSize;
-  UINT32            AlignedExecutableSize;
-  BOOLEAN           Failed;
-  UINT64            KmodAddress;
-  PRELINKED_KEXT    *PrelinkedKext;
-  CHAR8             ExecutableSourceAddrStr[24];
-  CHAR8             ExecutableSizeStr[24];
-  CHAR8             ExecutableLoadAddrStr[24];
-  CHAR8             KmodInfoStr[24];
+  *ReservedSize = NewSize;
+  return RETURN_SUCCESS;
+}
+
+STATIC
+UINT32
+InternalPlanFindIdentifier (
+  IN CONST CHAR8   **Identifiers,
+  IN CONST UINT32  *Table,
+  IN UINT32        TableMask,
+  IN CONST CHAR8   *Identifier,
+  IN UINT32        Hash
+  )
+{
+  UINT32  Slot;
+
+  Slot = Hash & TableMask;
+  while (Table[Slot] != 0) {
+    if (AsciiStrCmp (Identifiers[Table[Slot] - 1], Identifier) == 0) {
+      return Table[Slot] - 1;
+    }
+    Slot = (Slot + 1) & TableMask;
+  }
+
+  return MAX_UINT32;
+}
+
+STATIC
+VOID
+InternalPlanInsertIdentifier (
+  IN OUT UINT32  *Table,
+  IN     UINT32  TableMask,
+  IN     UINT32  Index,
+  IN     UINT32  Hash
+  )
+{
+  UINT32  Slot;
+
+  Slot = Hash & TableMask;
+  while (Table[Slot] != 0) {
+    Slot = (Slot + 1) & TableMask;
+  }
 
-  PrelinkedKext = NULL;
+  Table[Slot] = Index + 1;
+}
+
+/**
+  Put kext into link order after all its dependencies from the same batch.
+  Cyclic dependencies are left in submission order for the linker to report.
+**/
+STATIC
+VOID
+InternalPlanOrderKext (
+  IN OUT PRELINKED_KEXT_PLAN  *Plan,
+  IN OUT BOOLEAN              *Visited,
+  IN     UINT32               Index
+  )
+{
+  UINT32  DependencyIndex;
+
+  if (Visited[Index]) {
+    return;
+  }
+
+  Visited[Index] = TRUE;
+
+  for (DependencyIndex = Plan->DependencyOffsets[Index];
+    DependencyIndex < Plan->DependencyOffsets[Index + 1];
+    ++DependencyIndex) {
+    InternalPlanOrderKext (Plan, Visited, Plan->Dependencies[DependencyIndex]);
+  }
+
+  Plan->Order[Plan->NumPlanned++] = Index;
+}
+
+RETURN_STATUS
+PrelinkedPlanKexts (
+  IN OUT PRELINKED_CONTEXT    *Context,
+  IN     XML_NODE             **PlistRoots,
+  IN     UINT32               NumKexts,
+  OUT    PRELINKED_KEXT_PLAN  *Plan
+  )
+{
+  CONST CHAR8     **Identifiers;
+  XML_NODE        **Libraries;
+  XML_NODE        *PlistValue;
+  CONST CHAR8     *Dependency;
+  UINT32          *Table;
+  UINT32          *ExternalTable;
+  BOOLEAN         *Visited;
+  PRELINKED_KEXT  *DependencyKext;
+  UINT32          TableMask;
+  UINT32          ExternalTableMask;
+  UINT32          TotalDependencies;
+  UINT32          NumDependencies;
+  UINT32          DependencyIndex;
+  UINT32          FieldCount;
+  UINT32          FieldIndex;
+  UINT32          Index;
+  UINT32          Hash;
+  UINT32          Level;
+
+  ZeroMem (Plan, sizeof (*Plan));
+
+  if (NumKexts >= MAX_UINT32 / sizeof (VOID *)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  Plan->NumKexts = NumKexts;
+
+  TableMask   = (GetPowerOfTwo32 (NumKexts | 1U) << 2U) - 1;
+  Identifiers = AllocateZeroPool (NumKexts * sizeof (*Identifiers) + 1);
+  Libraries   = AllocateZeroPool (NumKexts * sizeof (*Libraries) + 1);
+  Visited     = AllocateZeroPool (NumKexts * sizeof (*Visited) + 1);
+  Table       = AllocateZeroPool ((TableMask + 1) * sizeof (*Table));
 
-  ASSERT (InfoPlistSize > 0);
+  Plan->Order             = AllocatePool (NumKexts * sizeof (*Plan->Order) + 1);
+  Plan->Levels            = AllocatePool (NumKexts * sizeof (*Plan->Levels) + 1);
+  Plan->DependencyOffsets = AllocatePool ((NumKexts + 1) * sizeof (*Plan->DependencyOffsets));
+
+  ExternalTable = NULL;
+
+  if (Identifiers == NULL || Libraries == NULL || Visited == NULL || Table == NULL
+    || Plan->Order == NULL || Plan->Levels == NULL || Plan->DependencyOffsets == NULL) {
+    goto DONE_ERROR;
+  }
 
   //
-  // Copy executable to prelinkedkernel.
+  // Collect kext identifiers and libraries. The first kext with an identifier wins.
   //
-  if (Executable != NULL) {
-    ASSERT (ExecutableSize > 0);
-    if (!MachoInitializeContext (&ExecutableContext, (UINT8 *)Executable, ExecutableSize)) {
-      DEBUG ((DEBUG_INFO, "OCK: Injected kext %a/%a is not a supported executable\n", BundlePath, ExecutablePath));
-      return RETURN_INVALID_PARAMETER;
+  TotalDependencies = 0;
+  for (Index = 0; Index < NumKexts; ++Index) {
+    if (PlistRoots[Index] == NULL) {
+      continue;
     }
 
-    ExecutableSize = MachoExpandImage64 (
-      &ExecutableContext,
-      &Context->Prelinked[Context->PrelinkedSize],
-      Context->PrelinkedAllocSize - Context->PrelinkedSize,
-      TRUE
-      );
+    PlistValue = PlistNodeCast (PlistDictFind (PlistRoots[Index], INFO_BUNDLE_IDENTIFIER_KEY), PLIST_NODE_TYPE_STRING);
+    if (PlistValue != NULL) {
+      Identifiers[Index] = XmlNodeContent (PlistValue);
+    }
 
-    AlignedExecutableSize = MACHO_ALIGN (ExecutableSize);
+    //
+    // 64-bit libraries take precedence, matching InternalScanPrelinkedKext.
+    //
+    Libraries[Index] = PlistNodeCast (PlistDictFind (PlistRoots[Index], INFO_BUNDLE_LIBRARIES_64_KEY), PLIST_NODE_TYPE_DICT);
+    if (Libraries[Index] == NULL) {
+      Libraries[Index] = PlistNodeCast (PlistDictFind (PlistRoots[Index], INFO_BUNDLE_LIBRARIES_KEY), PLIST_NODE_TYPE_DICT);
+    }
 
-    if (OcOverflowAddU32 (Context->PrelinkedSize, AlignedExecutableSize, &NewPrelinkedSize)
-      || NewPrelinkedSize > Context->PrelinkedAllocSize
-      || ExecutableSize == 0) {
-      return RETURN_BUFFER_TOO_SMALL;
+    if (Libraries[Index] != NULL) {
+      TotalDependencies += PlistDictChildren (Libraries[Index]);
     }
 
-    ZeroMem (
-      &Context->Prelinked[Context->PrelinkedSize + ExecutableSize],
-      AlignedExecutableSize - ExecutableSize
-      );
+    if (Identifiers[Index] != NULL) {
+      Hash = AsciiStrHash (Identifiers[Index], NULL);
+      if (InternalPlanFindIdentifier (Identifiers, Table, TableMask, Identifiers[Index], Hash) == MAX_UINT32) {
+        InternalPlanInsertIdentifier (Table, TableMask, Index, Hash);
+      }
+    }
+  }
 
-    if (!MachoInitializeContext (&ExecutableContext, &Context->Prelinked[Context->PrelinkedSize], ExecutableSize)) {
-      return RETURN_INVALID_PARAMETER;
+  //
+  // Split dependencies into the ones from this batch and the ones to be
+  // found in prelinked, which are only recorded once.
+  //
+  ExternalTableMask          = (GetPowerOfTwo32 (TotalDependencies | 1U) << 2U) - 1;
+  ExternalTable              = AllocateZeroPool ((ExternalTableMask + 1) * sizeof (*ExternalTable));
+  Plan->Dependencies         = AllocatePool (TotalDependencies * sizeof (*Plan->Dependencies) + 1);
+  Plan->ExternalDependencies = AllocatePool (TotalDependencies * sizeof (*Plan->ExternalDependencies) + 1);
+  if (ExternalTable == NULL || Plan->Dependencies == NULL || Plan->ExternalDependencies == NULL) {
+    goto DONE_ERROR;
+  }
+
+  NumDependencies = 0;
+  for (Index = 0; Index < NumKexts; ++Index) {
+    Plan->DependencyOffsets[Index] = NumDependencies;
+
+    if (Libraries[Index] == NULL) {
+      continue;
     }
 
-    KmodAddress = PrelinkedFindKmodAddress (&ExecutableContext, Context->PrelinkedLastLoadAddress, ExecutableSize);
-    if (KmodAddress == 0) {
-      return RETURN_INVALID_PARAMETER;
+    FieldCount = PlistDictChildren (Libraries[Index]);
+    for (FieldIndex = 0; FieldIndex < FieldCount; ++FieldIndex) {
+      Dependency = PlistKeyValue (PlistDictChild (Libraries[Index], FieldIndex, NULL));
+      if (Dependency == NULL) {
+        continue;
+      }
+
+      Hash            = AsciiStrHash (Dependency, NULL);
+      DependencyIndex = InternalPlanFindIdentifier (Identifiers, Table, TableMask, Dependency, Hash);
+      if (DependencyIndex != MAX_UINT32) {
+        if (DependencyIndex != Index) {
+          Plan->Dependencies[NumDependencies++] = DependencyIndex;
+        }
+      } else if (InternalPlanFindIdentifier (
+        Plan->ExternalDependencies,
+        ExternalTable,
+        ExternalTableMask,
+        Dependency,
+        Hash
+        ) == MAX_UINT32) {
+        Plan->ExternalDependencies[Plan->NumExternalDependencies] = Dependency;
+        InternalPlanInsertIdentifier (ExternalTable, ExternalTableMask, Plan->NumExternalDependencies, Hash);
+        ++Plan->NumExternalDependencies;
+      }
+    }
+  }
+
+  Plan->DependencyOffsets[NumKexts] = NumDependencies;
+
+  //
+  // Sort kexts topologically and assign link levels, kexts of one level
+  // only depend on kexts of lower levels.
+  //
+  for (Index = 0; Index < NumKexts; ++Index) {
+    Plan->Levels[Index] = MAX_UINT32;
+    if (PlistRoots[Index] != NULL) {
+      InternalPlanOrderKext (Plan, Visited, Index);
+    }
+  }
+
+  for (Index = 0; Index < Plan->NumPlanned; ++Index) {
+    Level = 0;
+    for (DependencyIndex = Plan->DependencyOffsets[Plan->Order[Index]];
+      DependencyIndex < Plan->DependencyOffsets[Plan->Order[Index] + 1];
+      ++DependencyIndex) {
+      if (Plan->Levels[Plan->Dependencies[DependencyIndex]] != MAX_UINT32) {
+        Level = MAX (Level, Plan->Levels[Plan->Dependencies[DependencyIndex]] + 1);
+      }
     }
+
+    Plan->Levels[Plan->Order[Index]] = Level;
+    Plan->NumLevels = MAX (Plan->NumLevels, Level + 1);
+  }
+
+  //
+  // Scan every dependency shared by the batch once before linking.
+  // Missing dependencies are reported by the linker.
+  //
+  DependencyKext = InternalCachedPrelinkedKernel (Context);
+  if (DependencyKext != NULL) {
+    InternalScanPrelinkedKextDependency (Context, DependencyKext);
+  }
+
+  for (Index = 0; Index < Plan->NumExternalDependencies; ++Index) {
+    DependencyKext = InternalCachedPrelinkedKext (Context, Plan->ExternalDependencies[Index]);
+    if (DependencyKext != NULL) {
+      InternalScanPrelinkedKextDependency (Context, DependencyKext);
+    }
+  }
+
+  FreePool (Identifiers);
+  FreePool (Libraries);
+  FreePool (Visited);
+  FreePool (Table);
+  FreePool (ExternalTable);
+
+  return RETURN_SUCCESS;
+
+DONE_ERROR:
+  if (Identifiers != NULL) {
+    FreePool (Identifiers);
+  }
+  if (Libraries != NULL) {
+    FreePool (Libraries);
+  }
+  if (Visited != NULL) {
+    FreePool (Visited);
+  }
+  if (Table != NULL) {
+    FreePool (Table);
+  }
+  if (ExternalTable != NULL) {
+    FreePool (ExternalTable);
+  }
+
+  PrelinkedPlanFree (Plan);
+
+  return RETURN_OUT_OF_RESOURCES;
+}
+
+VOID
+PrelinkedPlanFree (
+  IN OUT PRELINKED_KEXT_PLAN  *Plan
+  )
+{
+  if (Plan->Order != NULL) {
+    FreePool (Plan->Order);
+  }
+  if (Plan->Levels != NULL) {
+    FreePool (Plan->Levels);
+  }
+  if (Plan->DependencyOffsets != NULL) {
+    FreePool (Plan->DependencyOffsets);
   }
+  if (Plan->Dependencies != NULL) {
+    FreePool (Plan->Dependencies);
+  }
+  if (Plan->ExternalDependencies != NULL) {
+    FreePool ((VOID *) Plan->ExternalDependencies);
+  }
+
+  ZeroMem (Plan, sizeof (*Plan));
+}
+
+//
+// Per-kext state of batch injection.
+//
+typedef struct {
+  //
+  // Kext bundle descriptor.
+  //
+  CONST PRELINKED_KEXT_BUNDLE  *Bundle;
+  //
+  // Info.plist copy and its parsed document.
+  //
+  CHAR8                        *TmpInfoPlist;
+  XML_DOCUMENT                 *Document;
+  XML_NODE                     *Root;
+  //
+  // Executable expanded into prelinked text, valid when Placed is set.
+  //
+  OC_MACHO_CONTEXT             ExecutableContext;
+  UINT32                       Offset;
+  UINT32                       AlignedExecutableSize;
+  UINT64                       SourceAddress;
+  UINT64                       LoadAddress;
+  UINT64                       KmodAddress;
+  BOOLEAN                      Placed;
+  //
+  // Linked executable, valid when linking succeeded.
+  //
+  PRELINKED_KEXT               *PrelinkedKext;
+  //
+  // Injection status.
+  //
+  RETURN_STATUS                Status;
+} PRELINKED_INJECT_KEXT;
+
+STATIC
+RETURN_STATUS
+InternalInjectParsePlist (
+  IN OUT PRELINKED_INJECT_KEXT  *Kext
+  )
+{
+  ASSERT (Kext->Bundle->InfoPlistSize > 0);
 
   //
   // Allocate Info.plist copy for XML_DOCUMENT.
   //
-  TmpInfoPlist = AllocateCopyPool (InfoPlistSize, InfoPlist);
-  if (TmpInfoPlist == NULL) {
+  Kext->TmpInfoPlist = AllocateCopyPool (Kext->Bundle->InfoPlistSize, Kext->Bundle->InfoPlist);
+  if (Kext->TmpInfoPlist == NULL) {
     return RETURN_OUT_OF_RESOURCES;
   }
 
-  InfoPlistDocument = XmlDocumentParse (TmpInfoPlist, InfoPlistSize, FALSE);
-  if (InfoPlistDocument == NULL) {
-    FreePool (TmpInfoPlist);
+  Kext->Document = XmlDocumentParse (Kext->TmpInfoPlist, Kext->Bundle->InfoPlistSize, FALSE);
+  if (Kext->Document == NULL) {
     return RETURN_INVALID_PARAMETER;
   }
 
-  InfoPlistRoot = PlistNodeCast (PlistDocumentRoot (InfoPlistDocument), PLIST_NODE_TYPE_DICT);
-  if (InfoPlistRoot == NULL) {
-    XmlDocumentFree (InfoPlistDocument);
-    FreePool (TmpInfoPlist);
+  Kext->Root = PlistNodeCast (PlistDocumentRoot (Kext->Document), PLIST_NODE_TYPE_DICT);
+  if (Kext->Root == NULL) {
     return RETURN_INVALID_PARAMETER;
   }
 
@@ -586,113 +909,359 @@ PrelinkedInjectKext (
   // code in debug mode to diagnose it.
   //
   DEBUG_CODE_BEGIN ();
-  if (Executable == NULL) {
-    FieldCount = PlistDictChildren (InfoPlistRoot);
-    for (FieldIndex = 0; FieldIndex < FieldCount; ++FieldIndex) {
-      TmpKeyValue = PlistKeyValue (PlistDictChild (InfoPlistRoot, FieldIndex, NULL));
-      if (TmpKeyValue == NULL) {
-        continue;
-      }
-
-      if (AsciiStrCmp (TmpKeyValue, INFO_BUNDLE_EXECUTABLE_KEY) == 0) {
-        DEBUG ((DEBUG_ERROR, "OCK: Plist-only kext has %a key\n", INFO_BUNDLE_EXECUTABLE_KEY));
-        ASSERT (FALSE);
-        CpuDeadLoop ();
-      }
-    }
+  if (Kext->Bundle->Executable == NULL && PlistDictFind (Kext->Root, INFO_BUNDLE_EXECUTABLE_KEY) != NULL) {
+    DEBUG ((DEBUG_ERROR, "OCK: Plist-only kext has %a key\n", INFO_BUNDLE_EXECUTABLE_KEY));
+    ASSERT (FALSE);
+    CpuDeadLoop ();
   }
   DEBUG_CODE_END ();
 
+  return RETURN_SUCCESS;
+}
+
+STATIC
+RETURN_STATUS
+InternalInjectPlaceExecutable (
+  IN OUT PRELINKED_CONTEXT      *Context,
+  IN OUT PRELINKED_INJECT_KEXT  *Kext
+  )
+{
+  UINT32  ExecutableSize;
+  UINT32  NewPrelinkedSize;
+
+  ASSERT (Kext->Bundle->ExecutableSize > 0);
+
+  if (!MachoInitializeContext (&Kext->ExecutableContext, (UINT8 *) Kext->Bundle->Executable, Kext->Bundle->ExecutableSize)) {
+    DEBUG ((
+      DEBUG_INFO,
+      "OCK: Injected kext %a/%a is not a supported executable\n",
+      Kext->Bundle->BundlePath,
+      Kext->Bundle->ExecutablePath
+      ));
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  ExecutableSize = MachoExpandImage64 (
+    &Kext->ExecutableContext,
+    &Context->Prelinked[Context->PrelinkedSize],
+    Context->PrelinkedAllocSize - Context->PrelinkedSize,
+    TRUE
+    );
+
+  Kext->AlignedExecutableSize = MACHO_ALIGN (ExecutableSize);
+
+  if (OcOverflowAddU32 (Context->PrelinkedSize, Kext->AlignedExecutableSize, &NewPrelinkedSize)
+    || NewPrelinkedSize > Context->PrelinkedAllocSize
+    || ExecutableSize == 0) {
+    return RETURN_BUFFER_TOO_SMALL;
+  }
+
+  ZeroMem (
+    &Context->Prelinked[Context->PrelinkedSize + ExecutableSize],
+    Kext->AlignedExecutableSize - ExecutableSize
+    );
+
+  if (!MachoInitializeContext (&Kext->ExecutableContext, &Context->Prelinked[Context->PrelinkedSize], ExecutableSize)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  Kext->KmodAddress = PrelinkedFindKmodAddress (&Kext->ExecutableContext, Context->PrelinkedLastLoadAddress, ExecutableSize);
+  if (Kext->KmodAddress == 0) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  Kext->Offset        = Context->PrelinkedSize;
+  Kext->SourceAddress = Context->PrelinkedLastAddress;
+  Kext->LoadAddress   = Context->PrelinkedLastLoadAddress;
+  Kext->Placed        = TRUE;
+
+  //
+  // XNU assumes that load size and source size are same, so we should append
+  // whatever is bigger to all sizes.
+  //
+  Context->PrelinkedSize                  += Kext->AlignedExecutableSize;
+  Context->PrelinkedLastAddress           += Kext->AlignedExecutableSize;
+  Context->PrelinkedLastLoadAddress       += Kext->AlignedExecutableSize;
+  Context->PrelinkedTextSegment->Size     += Kext->AlignedExecutableSize;
+  Context->PrelinkedTextSegment->FileSize += Kext->AlignedExecutableSize;
+  Context->PrelinkedTextSection->Size     += Kext->AlignedExecutableSize;
+
+  return RETURN_SUCCESS;
+}
+
+STATIC
+VOID
+InternalInjectDiscardExecutable (
+  IN OUT PRELINKED_CONTEXT      *Context,
+  IN OUT PRELINKED_INJECT_KEXT  *Kext
+  )
+{
+  //
+  // Kexts are placed right before linking, so a failed one is always
+  // the last placed and its space can be given back.
+  //
+  ASSERT (Kext->Offset + Kext->AlignedExecutableSize == Context->PrelinkedSize);
+
+  ZeroMem (&Context->Prelinked[Kext->Offset], Kext->AlignedExecutableSize);
+
+  Context->PrelinkedSize                  -= Kext->AlignedExecutableSize;
+  Context->PrelinkedLastAddress           -= Kext->AlignedExecutableSize;
+  Context->PrelinkedLastLoadAddress       -= Kext->AlignedExecutableSize;
+  Context->PrelinkedTextSegment->Size     -= Kext->AlignedExecutableSize;
+  Context->PrelinkedTextSegment->FileSize -= Kext->AlignedExecutableSize;
+  Context->PrelinkedTextSection->Size     -= Kext->AlignedExecutableSize;
+
+  Kext->Placed = FALSE;
+}
+
+STATIC
+RETURN_STATUS
+InternalInjectLinkKext (
+  IN OUT PRELINKED_CONTEXT      *Context,
+  IN OUT PRELINKED_INJECT_KEXT  *Kext
+  )
+{
+  XML_NODE          *InfoPlistRoot;
+  BOOLEAN           Failed;
+  CHAR8             ExecutableSourceAddrStr[24];
+  CHAR8             ExecutableSizeStr[24];
+  CHAR8             ExecutableLoadAddrStr[24];
+  CHAR8             KmodInfoStr[24];
+
+  InfoPlistRoot = Kext->Root;
+
   Failed = FALSE;
   Failed |= XmlNodeAppend (InfoPlistRoot, "key", NULL, PRELINK_INFO_BUNDLE_PATH_KEY) == NULL;
-  Failed |= XmlNodeAppend (InfoPlistRoot, "string", NULL, BundlePath) == NULL;
-  if (Executable != NULL) {
+  Failed |= XmlNodeAppend (InfoPlistRoot, "string", NULL, Kext->Bundle->BundlePath) == NULL;
+  if (Kext->Placed) {
     Failed |= XmlNodeAppend (InfoPlistRoot, "key", NULL, PRELINK_INFO_EXECUTABLE_RELATIVE_PATH_KEY) == NULL;
-    Failed |= XmlNodeAppend (InfoPlistRoot, "string", NULL, ExecutablePath) == NULL;
-    Failed |= !AsciiUint64ToLowerHex (ExecutableSourceAddrStr, sizeof (ExecutableSourceAddrStr), Context->PrelinkedLastAddress);
+    Failed |= XmlNodeAppend (InfoPlistRoot, "string", NULL, Kext->Bundle->ExecutablePath) == NULL;
+    Failed |= !AsciiUint64ToLowerHex (ExecutableSourceAddrStr, sizeof (ExecutableSourceAddrStr), Kext->SourceAddress);
     Failed |= XmlNodeAppend (InfoPlistRoot, "key", NULL, PRELINK_INFO_EXECUTABLE_SOURCE_ADDR_KEY) == NULL;
     Failed |= XmlNodeAppend (InfoPlistRoot, "integer", PRELINK_INFO_INTEGER_ATTRIBUTES, ExecutableSourceAddrStr) == NULL;
-    Failed |= !AsciiUint64ToLowerHex (ExecutableLoadAddrStr, sizeof (ExecutableLoadAddrStr), Context->PrelinkedLastLoadAddress);
+    Failed |= !AsciiUint64ToLowerHex (ExecutableLoadAddrStr, sizeof (ExecutableLoadAddrStr), Kext->LoadAddress);
     Failed |= XmlNodeAppend (InfoPlistRoot, "key", NULL, PRELINK_INFO_EXECUTABLE_LOAD_ADDR_KEY) == NULL;
     Failed |= XmlNodeAppend (InfoPlistRoot, "integer", PRELINK_INFO_INTEGER_ATTRIBUTES, ExecutableLoadAddrStr) == NULL;
-    Failed |= !AsciiUint64ToLowerHex (ExecutableSizeStr, sizeof (ExecutableSizeStr), AlignedExecutableSize);
+    Failed |= !AsciiUint64ToLowerHex (ExecutableSizeStr, sizeof (ExecutableSizeStr), Kext->AlignedExecutableSize);
     Failed |= XmlNodeAppend (InfoPlistRoot, "key", NULL, PRELINK_INFO_EXECUTABLE_SIZE_KEY) == NULL;
     Failed |= XmlNodeAppend (InfoPlistRoot, "integer", PRELINK_INFO_INTEGER_ATTRIBUTES, ExecutableSizeStr) == NULL;
-    Failed |= !AsciiUint64ToLowerHex (KmodInfoStr, sizeof (KmodInfoStr), KmodAddress);
+    Failed |= !AsciiUint64ToLowerHex (KmodInfoStr, sizeof (KmodInfoStr), Kext->KmodAddress);
     Failed |= XmlNodeAppend (InfoPlistRoot, "key", NULL, PRELINK_INFO_KMOD_INFO_KEY) == NULL;
-    Failed |= XmlNodeAppend (InfoPlistRoot, "integer", PRELINK_INFO_INTEGER_ATTRIBUTES, KmodInfoStr) == NULL;  
+    Failed |= XmlNodeAppend (InfoPlistRoot, "integer", PRELINK_INFO_INTEGER_ATTRIBUTES, KmodInfoStr) == NULL;
   }
 
   if (Failed) {
-    XmlDocumentFree (InfoPlistDocument);
-    FreePool (TmpInfoPlist);
     return RETURN_OUT_OF_RESOURCES;
   }
 
-  if (Executable != NULL) {
-    PrelinkedKext = InternalLinkPrelinkedKext (
+  if (Kext->Placed) {
+    Kext->PrelinkedKext = InternalLinkPrelinkedKext (
       Context,
-      &ExecutableContext,
+      &Kext->ExecutableContext,
       InfoPlistRoot,
-      Context->PrelinkedLastLoadAddress,
-      KmodAddress
+      Kext->LoadAddress,
+      Kext->KmodAddress
       );
 
-    if (PrelinkedKext == NULL) {
-      XmlDocumentFree (InfoPlistDocument);
-      FreePool (TmpInfoPlist);
+    if (Kext->PrelinkedKext == NULL) {
       return RETURN_INVALID_PARAMETER;
     }
-
-    //
-    // XNU assumes that load size and source size are same, so we should append
-    // whatever is bigger to all sizes.
-    //
-    Context->PrelinkedSize                  += AlignedExecutableSize;
-    Context->PrelinkedLastAddress           += AlignedExecutableSize;
-    Context->PrelinkedLastLoadAddress       += AlignedExecutableSize;
-    Context->PrelinkedTextSegment->Size     += AlignedExecutableSize;
-    Context->PrelinkedTextSegment->FileSize += AlignedExecutableSize;
-    Context->PrelinkedTextSection->Size     += AlignedExecutableSize;
   }
 
+  return RETURN_SUCCESS;
+}
+
+//
+// Append linked or plist-only kext to prelinked info, nothing may fail after.
+//
+STATIC
+RETURN_STATUS
+InternalInjectAppendKext (
+  IN OUT PRELINKED_CONTEXT      *Context,
+  IN OUT PRELINKED_INJECT_KEXT  *Kext
+  )
+{
+  RETURN_STATUS  Status;
+  CHAR8          *NewInfoPlist;
+  UINT32         NewInfoPlistSize;
+
   //
   // Strip outer plist & dict.
   //
-  NewInfoPlist = XmlDocumentExport (InfoPlistDocument, &NewInfoPlistSize, 2);
-
-  XmlDocumentFree (InfoPlistDocument);
-  FreePool (TmpInfoPlist);
-
+  NewInfoPlist = XmlDocumentExport (Kext->Document, &NewInfoPlistSize, 2);
   if (NewInfoPlist == NULL) {
-    if (PrelinkedKext != NULL) {
-      InternalFreePrelinkedKext (PrelinkedKext);
-    }
     return RETURN_OUT_OF_RESOURCES;
   }
 
   Status = PrelinkedDependencyInsert (Context, NewInfoPlist);
   if (RETURN_ERROR (Status)) {
     FreePool (NewInfoPlist);
-    if (PrelinkedKext != NULL) {
-      InternalFreePrelinkedKext (PrelinkedKext);
-    }
     return Status;
   }
 
   if (XmlNodeAppend (Context->KextList, "dict", NULL, NewInfoPlist) == NULL) {
-    if (PrelinkedKext != NULL) {
-      InternalFreePrelinkedKext (PrelinkedKext);
-    }
     return RETURN_OUT_OF_RESOURCES;
   }
 
   //
-  // Let other kexts depend on this one.
+  // Let other kexts depend on this one. Without an index entry the kext
+  // is still injected, only the dependents in this batch fail to link.
   //
-  if (PrelinkedKext != NULL) {
-    InsertTailList (&Context->PrelinkedKexts, &PrelinkedKext->Link);
+  if (Kext->PrelinkedKext != NULL) {
+    Status = InternalInsertKextIndex (Context, Kext->PrelinkedKext->Identifier, NULL, Kext->PrelinkedKext);
+    if (RETURN_ERROR (Status)) {
+      DEBUG ((
+        DEBUG_INFO,
+        "OCK: Failed to index injected kext %a - %r\n",
+        Kext->PrelinkedKext->Identifier,
+        Status
+        ));
+    }
+
+    InsertTailList (&Context->PrelinkedKexts, &Kext->PrelinkedKext->Link);
   }
 
   return RETURN_SUCCESS;
 }
+
+RETURN_STATUS
+PrelinkedInjectKexts (
+  IN OUT PRELINKED_CONTEXT            *Context,
+  IN     CONST PRELINKED_KEXT_BUNDLE  *Bundles,
+  IN     UINT32                       NumBundles,
+  OUT    RETURN_STATUS                *Statuses OPTIONAL
+  )
+{
+  RETURN_STATUS          Status;
+  PRELINKED_INJECT_KEXT  *Kexts;
+  PRELINKED_INJECT_KEXT  *Kext;
+  XML_NODE               **PlistRoots;
+  PRELINKED_KEXT_PLAN    Plan;
+  UINT32                 Index;
+
+  if (NumBundles == 0) {
+    return RETURN_SUCCESS;
+  }
+
+  if (NumBundles > MAX_UINT32 / sizeof (*Kexts)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  Kexts      = AllocateZeroPool (NumBundles * sizeof (*Kexts));
+  PlistRoots = AllocateZeroPool (NumBundles * sizeof (*PlistRoots));
+  if (Kexts == NULL || PlistRoots == NULL) {
+    if (Kexts != NULL) {
+      FreePool (Kexts);
+    }
+    if (PlistRoots != NULL) {
+      FreePool (PlistRoots);
+    }
+    return RETURN_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < NumBundles; ++Index) {
+    Kext         = &Kexts[Index];
+    Kext->Bundle = &Bundles[Index];
+    Kext->Status = InternalInjectParsePlist (Kext);
+    if (!RETURN_ERROR (Kext->Status)) {
+      PlistRoots[Index] = Kext->Root;
+    }
+  }
+
+  //
+  // Link dependencies from the same batch before their dependents.
+  //
+  Status = PrelinkedPlanKexts (Context, PlistRoots, NumBundles, &Plan);
+  if (RETURN_ERROR (Status)) {
+    for (Index = 0; Index < NumBundles; ++Index) {
+      if (!RETURN_ERROR (Kexts[Index].Status)) {
+        Kexts[Index].Status = Status;
+      }
+    }
+  }
+
+  //
+  // Place, link and append kexts to prelinked info in link order.
+  // A kext failing at any step is discarded before the next one is placed.
+  //
+  for (Index = 0; Index < Plan.NumPlanned; ++Index) {
+    Kext = &Kexts[Plan.Order[Index]];
+    if (RETURN_ERROR (Kext->Status)) {
+      continue;
+    }
+
+    if (Kext->Bundle->Executable != NULL) {
+      Kext->Status = InternalInjectPlaceExecutable (Context, Kext);
+    }
+
+    if (!RETURN_ERROR (Kext->Status)) {
+      Kext->Status = InternalInjectLinkKext (Context, Kext);
+    }
+
+    if (!RETURN_ERROR (Kext->Status)) {
+      Kext->Status = InternalInjectAppendKext (Context, Kext);
+    }
+
+    if (RETURN_ERROR (Kext->Status) && Kext->Placed) {
+      InternalInjectDiscardExecutable (Context, Kext);
+    }
+  }
+
+  PrelinkedPlanFree (&Plan);
+
+  Status = RETURN_SUCCESS;
+
+  for (Index = 0; Index < NumBundles; ++Index) {
+    Kext = &Kexts[Index];
+    if (Kext->Document != NULL) {
+      XmlDocumentFree (Kext->Document);
+    }
+    if (Kext->TmpInfoPlist != NULL) {
+      FreePool (Kext->TmpInfoPlist);
+    }
+
+    if (RETURN_ERROR (Kext->Status)) {
+      DEBUG ((
+        DEBUG_INFO,
+        "OCK: Failed to inject kext %a - %r\n",
+        Kext->Bundle->BundlePath,
+        Kext->Status
+        ));
+      if (!RETURN_ERROR (Status)) {
+        Status = Kext->Status;
+      }
+    }
+
+    if (Statuses != NULL) {
+      Statuses[Index] = Kext->Status;
+    }
+  }
+
+  FreePool (Kexts);
+  FreePool (PlistRoots);
+
+  return Status;
+}
+
+RETURN_STATUS
+PrelinkedInjectKext (
+  IN OUT PRELINKED_CONTEXT  *Context,
+  IN     CONST CHAR8        *BundlePath,
+  IN     CONST CHAR8        *InfoPlist,
+  IN     UINT32             InfoPlistSize,
+  IN     CONST CHAR8        *ExecutablePath OPTIONAL,
+  IN     CONST UINT8        *Executable OPTIONAL,
+  IN     UINT32             ExecutableSize OPTIONAL
+  )
+{
+  PRELINKED_KEXT_BUNDLE  Bundle;
+
+  Bundle.BundlePath     = BundlePath;
+  Bundle.InfoPlist      = InfoPlist;
+  Bundle.InfoPlistSize  = InfoPlistSize;
+  Bundle.ExecutablePath = ExecutablePath;
+  Bundle.Executable     = Executable;
+  Bundle.ExecutableSize = ExecutableSize;
+
+  return PrelinkedInjectKexts (Context, &Bundle, 1, NULL);
+}
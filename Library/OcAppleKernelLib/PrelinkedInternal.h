@@ -22,12 +22,29 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Library/OcMachoLib.h>
 #include <Library/OcXmlLib.h>
 
+typedef struct PRELINKED_KEXT_ PRELINKED_KEXT;
+
 //
-// Some sane maximum value.
+// Prelinked kext identifier lookup table entry.
 //
-#define MAX_KEXT_DEPEDENCIES 16
-
-typedef struct PRELINKED_KEXT_ PRELINKED_KEXT;
+typedef struct PRELINKED_KEXT_INDEX_ENTRY_ {
+  //
+  // Kext CFBundleIdentifier, NULL for unused entries.
+  //
+  CONST CHAR8              *Identifier;
+  //
+  // First kext dictionary in KextList, NULL for kernel and injected kexts.
+  //
+  XML_NODE                 *Plist;
+  //
+  // Cached PRELINKED_KEXT, NULL until first requested.
+  //
+  PRELINKED_KEXT           *Kext;
+  //
+  // Identifier hash (AsciiStrHash).
+  //
+  UINT32                   Hash;
+} PRELINKED_KEXT_INDEX_ENTRY;
 
 typedef struct {
   //
@@ -35,9 +52,15 @@ typedef struct {
   //
   UINT64       Value;  ///< value of this symbol (or stab offset)
   CONST CHAR8  *Name;  ///< name of this symbol
-  UINT32       Length;
+  UINT32       Length; ///< length of this symbol name
+  UINT32       Hash;   ///< hash of this symbol name (AsciiStrHash)
 } PRELINKED_KEXT_SYMBOL;
 
+typedef struct {
+  UINT64       Value;  ///< value of the indexed symbol
+  UINT32       Index;  ///< index of the symbol in LinkedSymbolTable
+} PRELINKED_KEXT_SYMBOL_VALUE;
+
 typedef struct {
   CONST CHAR8 *Name;    ///< The symbol's name.
   UINT64      Address;  ///< The symbol's address.
@@ -80,10 +103,24 @@ struct PRELINKED_KEXT_ {
   //
   CONST CHAR8              *CompatibleVersion;
   //
-  // Scanned dependencies (PRELINKED_KEXT) from BundleLibraries.
-  // Not resolved by default. See InternalScanPrelinkedKext for fields below.
+  // Bundle version (CFBundleVersion), may be NULL.
+  // Only set for kexts from prelinkedkernel.
+  //
+  CONST CHAR8              *Version;
+  //
+  // Kext was injected rather than found in prelinkedkernel.
+  //
+  BOOLEAN                  Injected;
+  //
+  // Scanned dependencies (PRELINKED_KEXT) from BundleLibraries, kernel goes first.
+  // Allocated from context arena. Not resolved by default.
+  // See InternalScanPrelinkedKext for fields below.
   //
-  PRELINKED_KEXT           *Dependencies[MAX_KEXT_DEPEDENCIES];
+  PRELINKED_KEXT           **Dependencies;
+  //
+  // Number of Dependencies.
+  //
+  UINT32                   NumberOfDependencies;
   //
   // Linkedit segment reference.
   //
@@ -106,10 +143,24 @@ struct PRELINKED_KEXT_ {
   //
   UINT32                   NumberOfCxxSymbols;
   //
-  // Sorted symbol table used only for dependencies.
+  // Sorted symbol table used only for dependencies. Allocated from context arena.
   //
   PRELINKED_KEXT_SYMBOL    *LinkedSymbolTable;
   //
+  // Open addressing hash index of LinkedSymbolTable by symbol name.
+  // Each slot contains symbol index plus one, 0 marks an empty slot.
+  //
+  UINT32                   *LinkedSymbolIndex;
+  //
+  // Number of LinkedSymbolIndex slots minus one, see PRELINKED_SYMBOL_INDEX_SIZE.
+  //
+  UINT32                   LinkedSymbolIndexMask;
+  //
+  // LinkedSymbolTable index sorted by symbol value and then by symbol index.
+  // Contains NumberOfSymbols entries.
+  //
+  PRELINKED_KEXT_SYMBOL_VALUE *LinkedSymbolValues;
+  //
   // A flag set during dependency walk BFS to avoid going through the same path.
   //
   BOOLEAN                  Processed;
@@ -119,10 +170,26 @@ struct PRELINKED_KEXT_ {
   UINT32                   NumberOfVtables;
   //
   // Scanned vtable buffer. Iterated with GET_NEXT_PRELINKED_VTABLE.
+  // Allocated from context arena.
   //
   PRELINKED_VTABLE         *LinkedVtables;
+  //
+  // Open addressing hash index of LinkedVtables by vtable name.
+  // NULL marks an empty slot.
+  //
+  CONST PRELINKED_VTABLE   **LinkedVtableIndex;
+  //
+  // Number of LinkedVtableIndex slots minus one (always power of two).
+  //
+  UINT32                   LinkedVtableIndexMask;
 };
 
+//
+// Number of LinkedSymbolIndex slots for the given number of symbols.
+// Keeps load factor between 1/4 and 1/2 to make probe sequences short.
+//
+#define PRELINKED_SYMBOL_INDEX_SIZE(NumSymbols)  (GetPowerOfTwo32 ((NumSymbols) | 1U) << 2U)
+
 //
 // PRELINKED_KEXT signature for list identification.
 //
@@ -146,16 +213,42 @@ struct PRELINKED_KEXT_ {
 **/
 PRELINKED_KEXT *
 InternalNewPrelinkedKext (
-  IN OC_MACHO_CONTEXT       *Context,
-  IN XML_NODE               *KextPlist
+  IN OUT PRELINKED_CONTEXT  *Prelinked,
+  IN     OC_MACHO_CONTEXT   *Context,
+  IN     XML_NODE           *KextPlist
+  );
+
+/**
+  Adds kext to PRELINKED_CONTEXT identifier lookup table.
+  Existing entries are preserved, so the first kext with the identifier wins.
+  Later KextList duplicates are only tried when the first one fails to load.
+
+  @param[in,out] Prelinked   Prelinked context.
+  @param[in]     Identifier  Kext CFBundleIdentifier, must stay valid.
+  @param[in]     Plist       Kext dictionary in KextList (optional).
+  @param[in]     Kext        Already created kext (optional).
+
+  @return RETURN_SUCCESS on success.
+**/
+RETURN_STATUS
+InternalInsertKextIndex (
+  IN OUT PRELINKED_CONTEXT  *Prelinked,
+  IN     CONST CHAR8        *Identifier,
+  IN     XML_NODE           *Plist OPTIONAL,
+  IN     PRELINKED_KEXT     *Kext OPTIONAL
   );
 
 /**
-  Frees PRELINKED_KEXT.
+  Builds PRELINKED_CONTEXT identifier lookup table from KextList
+  and already cached kexts.
+
+  @param[in,out] Prelinked   Prelinked context.
+
+  @return RETURN_SUCCESS on success.
 **/
-VOID
-InternalFreePrelinkedKext (
-  IN PRELINKED_KEXT  *Kext
+RETURN_STATUS
+InternalCreateKextIndex (
+  IN OUT PRELINKED_CONTEXT  *Prelinked
   );
 
 /**
@@ -175,6 +268,14 @@ InternalCachedPrelinkedKernel (
   IN OUT PRELINKED_CONTEXT  *Prelinked
   );
 
+/**
+  Scan PRELINKED_KEXT for its own linkedit segment and symbol table.
+**/
+RETURN_STATUS
+InternalScanCurrentPrelinkedKext (
+  IN OUT PRELINKED_KEXT  *Kext
+  );
+
 /**
   Scan PRELINKED_KEXT for dependencies.
 **/
@@ -184,6 +285,16 @@ InternalScanPrelinkedKext (
   IN OUT PRELINKED_CONTEXT  *Context
   );
 
+/**
+  Scan PRELINKED_KEXT for use as a dependency, building its linked symbol
+  table and vtables. Results are cached in the kext.
+**/
+RETURN_STATUS
+InternalScanPrelinkedKextDependency (
+  IN OUT PRELINKED_CONTEXT  *Context,
+  IN OUT PRELINKED_KEXT     *DependencyKext
+  );
+
 /**
   Unlock all context dependency kexts by unsetting Processed flag.
 
@@ -326,6 +437,35 @@ InternalGetOcVtableByName (
   IN CONST CHAR8           *Name
   );
 
+/**
+  Allocates vtable name index for Kext and adds all current LinkedVtables.
+
+  @param[in,out] Context     Prelinked context to allocate from.
+  @param[in,out] Kext        Kext with LinkedVtables.
+  @param[in]     MaxVtables  Maximum number of vtables to be indexed.
+
+  @return TRUE on success.
+**/
+BOOLEAN
+InternalCreateVtableIndex (
+  IN OUT PRELINKED_CONTEXT  *Context,
+  IN OUT PRELINKED_KEXT     *Kext,
+  IN     UINT32             MaxVtables
+  );
+
+/**
+  Adds vtable to vtable name index of Kext.
+  Existing entries are preserved, so the first vtable with the name wins.
+
+  @param[in,out] Kext    Kext with vtable name index.
+  @param[in]     Vtable  Vtable from Kext LinkedVtables.
+**/
+VOID
+InternalInsertVtableIndex (
+  IN OUT PRELINKED_KEXT          *Kext,
+  IN     CONST PRELINKED_VTABLE  *Vtable
+  );
+
 //
 // Prelink
 //
@@ -20,13 +20,49 @@
 #include <Library/MemoryAllocationLib.h>
 #include <Library/OcAppleKernelLib.h>
 #include <Library/OcMachoLib.h>
+#include <Library/OcStringLib.h>
 #include <Library/OcXmlLib.h>
 
 #include "PrelinkedInternal.h"
 
 /**
-  Creates new uncached PRELINKED_KEXT from pool.
+  Obtains optional string value from kext plist.
 
+  @param[in]  KextPlist  Plist root node with Kext Information.
+  @param[in]  Key        Key to look up.
+  @param[out] Value      String value or NULL when the key is missing.
+
+  @return FALSE when the key is present but has no string value.
+**/
+STATIC
+BOOLEAN
+InternalGetKextPlistString (
+  IN  XML_NODE     *KextPlist,
+  IN  CONST CHAR8  *Key,
+  OUT CONST CHAR8  **Value
+  )
+{
+  XML_NODE  *Node;
+
+  *Value = NULL;
+
+  Node = PlistDictFind (KextPlist, Key);
+  if (Node == NULL) {
+    return TRUE;
+  }
+
+  if (PlistNodeCast (Node, PLIST_NODE_TYPE_STRING) == NULL) {
+    return FALSE;
+  }
+
+  *Value = XmlNodeContent (Node);
+  return *Value != NULL;
+}
+
+/**
+  Creates new uncached PRELINKED_KEXT from arena.
+
+  @param[in] Arena      Arena to allocate from.
   @param[in] Prelinked  Initialises PRELINKED_KEXT from prelinked buffer.
   @param[in] KextPlist  Plist root node with Kext Information.
   @param[in] Identifier Abort on CFBundleIdentifier mismatch.
@@ -36,99 +72,67 @@
 STATIC
 PRELINKED_KEXT *
 InternalCreatePrelinkedKext (
+  IN OUT OC_ARENA           *Arena,
   IN OUT PRELINKED_CONTEXT  *Prelinked OPTIONAL,
   IN XML_NODE               *KextPlist,
   IN CONST CHAR8            *Identifier OPTIONAL
   )
 {
   PRELINKED_KEXT  *NewKext;
-  UINT32          FieldIndex;
-  UINT32          FieldCount;
-  CONST CHAR8     *KextPlistKey;
-  XML_NODE        *KextPlistValue;
   CONST CHAR8     *KextIdentifier;
   XML_NODE        *BundleLibraries;
-  XML_NODE        *BundleLibraries64;
   CONST CHAR8     *CompatibleVersion;
+  CONST CHAR8     *Version;
+  XML_NODE        *KmodInfo;
   UINT64          VirtualBase;
   UINT64          VirtualKmod;
   UINT64          SourceBase;
   UINT64          SourceSize;
   UINT64          SourceEnd;
-  BOOLEAN         Found;
-
-  KextIdentifier    = NULL;
-  BundleLibraries   = NULL;
-  BundleLibraries64 = NULL;
-  CompatibleVersion = NULL;
-  VirtualBase       = 0;
-  VirtualKmod       = 0;
-  SourceBase        = 0;
-  SourceSize        = 0;
-
-  Found       = Identifier == NULL;
-
-  FieldCount = PlistDictChildren (KextPlist);
-  for (FieldIndex = 0; FieldIndex < FieldCount; ++FieldIndex) {
-    KextPlistKey = PlistKeyValue (PlistDictChild (KextPlist, FieldIndex, &KextPlistValue));
-    if (KextPlistKey == NULL) {
-      continue;
-    }
 
-    if (KextIdentifier == NULL && AsciiStrCmp (KextPlistKey, INFO_BUNDLE_IDENTIFIER_KEY) == 0) {
-      KextIdentifier = XmlNodeContent (KextPlistValue);
-      if (PlistNodeCast (KextPlistValue, PLIST_NODE_TYPE_STRING) == NULL || KextIdentifier == NULL) {
-        break;
-      }
-      if (!Found && AsciiStrCmp (KextIdentifier, Identifier) == 0) {
-        Found = TRUE;
-      }
-    } else if (BundleLibraries == NULL && AsciiStrCmp (KextPlistKey, INFO_BUNDLE_LIBRARIES_KEY) == 0) {
-      if (PlistNodeCast (KextPlistValue, PLIST_NODE_TYPE_DICT) == NULL) {
-        break;
-      }
-      BundleLibraries = KextPlistValue;
-    } else if (BundleLibraries64 == NULL && AsciiStrCmp (KextPlistKey, INFO_BUNDLE_LIBRARIES_64_KEY) == 0) {
-      if (PlistNodeCast (KextPlistValue, PLIST_NODE_TYPE_DICT) == NULL) {
-        break;
-      }
-      BundleLibraries64 = BundleLibraries = KextPlistValue;
-    } else if (CompatibleVersion == NULL && AsciiStrCmp (KextPlistKey, INFO_BUNDLE_COMPATIBLE_VERSION_KEY) == 0) {
-      if (PlistNodeCast (KextPlistValue, PLIST_NODE_TYPE_STRING) == NULL) {
-        break;
-      }
-      CompatibleVersion = XmlNodeContent (KextPlistValue);
-      if (CompatibleVersion == NULL) {
-        break;
-      }
-    } else if (Prelinked != NULL && VirtualBase == 0 && AsciiStrCmp (KextPlistKey, PRELINK_INFO_EXECUTABLE_LOAD_ADDR_KEY) == 0) {
-      if (!PlistIntegerValue (KextPlistValue, &VirtualBase, sizeof (VirtualBase), TRUE)) {
-        break;
-      }
-    } else if (Prelinked != NULL && VirtualKmod == 0 && AsciiStrCmp (KextPlistKey, PRELINK_INFO_KMOD_INFO_KEY) == 0) {
-      if (!PlistIntegerValue (KextPlistValue, &VirtualKmod, sizeof (VirtualKmod), TRUE)) {
-        break;
-      }
-    } else if (Prelinked != NULL && SourceBase == 0 && AsciiStrCmp (KextPlistKey, PRELINK_INFO_EXECUTABLE_SOURCE_ADDR_KEY) == 0) {
-      if (!PlistIntegerValue (KextPlistValue, &SourceBase, sizeof (SourceBase), TRUE)) {
-        break;
-      }
-    } else if (Prelinked != NULL && SourceSize == 0 && AsciiStrCmp (KextPlistKey, PRELINK_INFO_EXECUTABLE_SIZE_KEY) == 0) {
-      if (!PlistIntegerValue (KextPlistValue, &SourceSize, sizeof (SourceSize), TRUE)) {
-        break;
-      }
+  Version     = NULL;
+  VirtualBase = 0;
+  VirtualKmod = 0;
+  SourceBase  = 0;
+  SourceSize  = 0;
+
+  if (!InternalGetKextPlistString (KextPlist, INFO_BUNDLE_IDENTIFIER_KEY, &KextIdentifier)
+    || KextIdentifier == NULL
+    || (Identifier != NULL && AsciiStrCmp (KextIdentifier, Identifier) != 0)) {
+    return NULL;
+  }
+
+  //
+  // 64-bit libraries take precedence.
+  //
+  BundleLibraries = PlistDictFind (KextPlist, INFO_BUNDLE_LIBRARIES_64_KEY);
+  if (BundleLibraries == NULL) {
+    BundleLibraries = PlistDictFind (KextPlist, INFO_BUNDLE_LIBRARIES_KEY);
+  }
+
+  if ((BundleLibraries != NULL && PlistNodeCast (BundleLibraries, PLIST_NODE_TYPE_DICT) == NULL)
+    || !InternalGetKextPlistString (KextPlist, INFO_BUNDLE_COMPATIBLE_VERSION_KEY, &CompatibleVersion)) {
+    return NULL;
+  }
+
+  if (Prelinked != NULL) {
+    if (!InternalGetKextPlistString (KextPlist, INFO_BUNDLE_VERSION_KEY, &Version)
+      || !PlistIntegerValue (PlistDictFind (KextPlist, PRELINK_INFO_EXECUTABLE_LOAD_ADDR_KEY), &VirtualBase, sizeof (VirtualBase), TRUE)
+      || !PlistIntegerValue (PlistDictFind (KextPlist, PRELINK_INFO_EXECUTABLE_SOURCE_ADDR_KEY), &SourceBase, sizeof (SourceBase), TRUE)
+      || !PlistIntegerValue (PlistDictFind (KextPlist, PRELINK_INFO_EXECUTABLE_SIZE_KEY), &SourceSize, sizeof (SourceSize), TRUE)) {
+      return NULL;
     }
 
-    if (KextIdentifier != NULL && BundleLibraries64 != NULL && CompatibleVersion != NULL
-      && (Prelinked == NULL || (Prelinked != NULL && VirtualBase != 0 && VirtualKmod != 0 && SourceBase != 0 && SourceSize != 0))) {
-      break;
+    KmodInfo = PlistDictFind (KextPlist, PRELINK_INFO_KMOD_INFO_KEY);
+    if (KmodInfo != NULL && !PlistIntegerValue (KmodInfo, &VirtualKmod, sizeof (VirtualKmod), TRUE)) {
+      return NULL;
     }
   }
 
   //
   // BundleLibraries, CompatibleVersion, and KmodInfo are optional and thus not checked.
   //
-  if (!Found || KextIdentifier == NULL || SourceBase < VirtualBase
+  if (SourceBase < VirtualBase
     || (Prelinked != NULL && (VirtualBase == 0 || SourceBase == 0 || SourceSize == 0 || SourceSize > MAX_UINT32))) {
     return NULL;
   }
@@ -143,16 +147,15 @@ InternalCreatePrelinkedKext (
   }
 
   //
-  // Important to ZeroPool for dependency cleanup.
+  // Important to zero for dependency cleanup.
   //
-  NewKext = AllocateZeroPool (sizeof (*NewKext));
+  NewKext = OcArenaAllocateZero (Arena, sizeof (*NewKext));
   if (NewKext == NULL) {
     return NULL;
   }
 
   if (Prelinked != NULL
     && !MachoInitializeContext (&NewKext->Context.MachContext, &Prelinked->Prelinked[SourceBase], (UINT32)SourceSize)) {
-    FreePool (NewKext);
     return NULL;
   }
 
@@ -160,13 +163,13 @@ InternalCreatePrelinkedKext (
   NewKext->Identifier           = KextIdentifier;
   NewKext->BundleLibraries      = BundleLibraries;
   NewKext->CompatibleVersion    = CompatibleVersion;
+  NewKext->Version              = Version;
   NewKext->Context.VirtualBase  = VirtualBase;
   NewKext->Context.VirtualKmod  = VirtualKmod;
 
   return NewKext;
 }
 
-STATIC
 RETURN_STATUS
 InternalScanCurrentPrelinkedKext (
   IN OUT PRELINKED_KEXT  *Kext
@@ -203,6 +206,148 @@ InternalScanCurrentPrelinkedKext (
   return RETURN_SUCCESS;
 }
 
+/**
+  Builds symbol name hash index for constructed LinkedSymbolTable.
+  Symbols are inserted in table order, so that linear probing visits
+  duplicate names in the same order as linear table walk would.
+
+  @param[in,out] Context  Prelinked context to allocate from.
+  @param[in,out] Kext     Kext with LinkedSymbolTable.
+
+  @return RETURN_SUCCESS on success.
+**/
+STATIC
+RETURN_STATUS
+InternalScanBuildLinkedSymbolIndex (
+  IN OUT PRELINKED_CONTEXT  *Context,
+  IN OUT PRELINKED_KEXT     *Kext
+  )
+{
+  UINT32  *SymbolIndex;
+  UINT32  IndexSize;
+  UINT32  IndexMask;
+  UINT32  Index;
+  UINT32  Slot;
+
+  //
+  // Symbol count is bounded by the Mach-O size, so this cannot overflow.
+  //
+  IndexSize = PRELINKED_SYMBOL_INDEX_SIZE (Kext->NumberOfSymbols);
+  IndexMask = IndexSize - 1;
+
+  SymbolIndex = OcArenaAllocateZero (&Context->Arena, IndexSize * sizeof (*SymbolIndex));
+  if (SymbolIndex == NULL) {
+    return RETURN_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < Kext->NumberOfSymbols; ++Index) {
+    Slot = Kext->LinkedSymbolTable[Index].Hash & IndexMask;
+    while (SymbolIndex[Slot] != 0) {
+      Slot = (Slot + 1) & IndexMask;
+    }
+
+    SymbolIndex[Slot] = Index + 1;
+  }
+
+  Kext->LinkedSymbolIndex     = SymbolIndex;
+  Kext->LinkedSymbolIndexMask = IndexMask;
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Compares symbol value index entries by value and then by symbol index.
+**/
+STATIC
+BOOLEAN
+InternalSymbolValueLess (
+  IN CONST PRELINKED_KEXT_SYMBOL_VALUE  *First,
+  IN CONST PRELINKED_KEXT_SYMBOL_VALUE  *Second
+  )
+{
+  if (First->Value != Second->Value) {
+    return First->Value < Second->Value;
+  }
+
+  return First->Index < Second->Index;
+}
+
+/**
+  Restores max-heap property for the subtree at Root.
+**/
+STATIC
+VOID
+InternalSymbolValueSiftDown (
+  IN OUT PRELINKED_KEXT_SYMBOL_VALUE  *Values,
+  IN     UINT32                       Root,
+  IN     UINT32                       Count
+  )
+{
+  PRELINKED_KEXT_SYMBOL_VALUE  Temp;
+  UINT32                       Child;
+
+  while ((Child = Root * 2 + 1) < Count) {
+    if (Child + 1 < Count && InternalSymbolValueLess (&Values[Child], &Values[Child + 1])) {
+      ++Child;
+    }
+
+    if (!InternalSymbolValueLess (&Values[Root], &Values[Child])) {
+      break;
+    }
+
+    CopyMem (&Temp, &Values[Root], sizeof (Temp));
+    CopyMem (&Values[Root], &Values[Child], sizeof (Temp));
+    CopyMem (&Values[Child], &Temp, sizeof (Temp));
+    Root = Child;
+  }
+}
+
+/**
+  Builds symbol value index for constructed LinkedSymbolTable.
+  Heap sort is used as it needs no extra memory and has no worst case.
+
+  @param[in,out] Context  Prelinked context to allocate from.
+  @param[in,out] Kext     Kext with LinkedSymbolTable.
+
+  @return RETURN_SUCCESS on success.
+**/
+STATIC
+RETURN_STATUS
+InternalScanBuildLinkedSymbolValues (
+  IN OUT PRELINKED_CONTEXT  *Context,
+  IN OUT PRELINKED_KEXT     *Kext
+  )
+{
+  PRELINKED_KEXT_SYMBOL_VALUE  *Values;
+  PRELINKED_KEXT_SYMBOL_VALUE  Temp;
+  UINT32                       Index;
+
+  Values = OcArenaAllocate (&Context->Arena, (Kext->NumberOfSymbols | 1U) * sizeof (*Values));
+  if (Values == NULL) {
+    return RETURN_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < Kext->NumberOfSymbols; ++Index) {
+    Values[Index].Value = Kext->LinkedSymbolTable[Index].Value;
+    Values[Index].Index = Index;
+  }
+
+  for (Index = Kext->NumberOfSymbols / 2; Index > 0; --Index) {
+    InternalSymbolValueSiftDown (Values, Index - 1, Kext->NumberOfSymbols);
+  }
+
+  for (Index = Kext->NumberOfSymbols; Index > 1; --Index) {
+    CopyMem (&Temp, &Values[0], sizeof (Temp));
+    CopyMem (&Values[0], &Values[Index - 1], sizeof (Temp));
+    CopyMem (&Values[Index - 1], &Temp, sizeof (Temp));
+    InternalSymbolValueSiftDown (Values, 0, Index - 1);
+  }
+
+  Kext->LinkedSymbolValues = Values;
+
+  return RETURN_SUCCESS;
+}
+
 STATIC
 RETURN_STATUS
 InternalScanBuildLinkedSymbolTable (
@@ -222,13 +367,15 @@ InternalScanBuildLinkedSymbolTable (
   MACH_NLIST_64         SymbolScratch;
   CONST PRELINKED_KEXT_SYMBOL *ResolvedSymbol;
   CONST CHAR8           *Name;
+  UINTN                 NameLength;
   BOOLEAN               Result;
+  RETURN_STATUS         Status;
 
   if (Kext->LinkedSymbolTable != NULL) {
     return RETURN_SUCCESS;
   }
 
-  SymbolTable = AllocatePool (Kext->NumberOfSymbols * sizeof (*SymbolTable));
+  SymbolTable = OcArenaAllocate (&Context->Arena, Kext->NumberOfSymbols * sizeof (*SymbolTable));
   if (SymbolTable == NULL) {
     return RETURN_OUT_OF_RESOURCES;
   }
@@ -271,7 +418,6 @@ InternalScanBuildLinkedSymbolTable (
       if ((Symbol->Type & MACH_N_TYPE_TYPE) == MACH_N_TYPE_INDR) {
         Name = MachoGetIndirectSymbolName64 (&Kext->Context.MachContext, Symbol);
         if (Name == NULL) {
-          FreePool (SymbolTable);
           return RETURN_LOAD_ERROR;
         }
 
@@ -283,7 +429,6 @@ InternalScanBuildLinkedSymbolTable (
                            OcGetSymbolFirstLevel
                            );
         if (ResolvedSymbol == NULL) {
-          FreePool (SymbolTable);
           return RETURN_NOT_FOUND;
         }
         SymbolScratch.Value = ResolvedSymbol->Value;
@@ -294,12 +439,14 @@ InternalScanBuildLinkedSymbolTable (
     if (!Result) {
       WalkerBottom->Value  = Symbol->Value;
       WalkerBottom->Name   = Kext->StringTable + Symbol->UnifiedName.StringIndex;
-      WalkerBottom->Length = (UINT32)AsciiStrLen (WalkerBottom->Name);
+      WalkerBottom->Hash   = AsciiStrHash (WalkerBottom->Name, &NameLength);
+      WalkerBottom->Length = (UINT32)NameLength;
       ++WalkerBottom;
     } else {
       WalkerTop->Value  = Symbol->Value;
       WalkerTop->Name   = Kext->StringTable + Symbol->UnifiedName.StringIndex;
-      WalkerTop->Length = (UINT32)AsciiStrLen (WalkerTop->Name);
+      WalkerTop->Hash   = AsciiStrHash (WalkerTop->Name, &NameLength);
+      WalkerTop->Length = (UINT32)NameLength;
       --WalkerTop;
 
       ++NumCxxSymbols;
@@ -321,6 +468,19 @@ InternalScanBuildLinkedSymbolTable (
   Kext->NumberOfCxxSymbols = NumCxxSymbols;
   Kext->LinkedSymbolTable  = SymbolTable;
 
+  Status = InternalScanBuildLinkedSymbolIndex (Context, Kext);
+  if (RETURN_ERROR (Status)) {
+    Kext->LinkedSymbolTable = NULL;
+    return Status;
+  }
+
+  Status = InternalScanBuildLinkedSymbolValues (Context, Kext);
+  if (RETURN_ERROR (Status)) {
+    Kext->LinkedSymbolIndex = NULL;
+    Kext->LinkedSymbolTable = NULL;
+    return Status;
+  }
+
   return RETURN_SUCCESS;
 }
 
@@ -390,7 +550,8 @@ InternalScanBuildLinkedVtables (
     NumEntries += NumEntriesTemp;
   }
 
-  LinkedVtables = AllocatePool (
+  LinkedVtables = OcArenaAllocate (
+                    &Context->Arena,
                     (NumVtables * sizeof (*LinkedVtables))
                       + (NumEntries * sizeof (*LinkedVtables->Entries))
                     );
@@ -409,6 +570,12 @@ InternalScanBuildLinkedVtables (
   Kext->NumberOfVtables = NumVtables;
   Kext->LinkedVtables   = LinkedVtables;
 
+  if (!InternalCreateVtableIndex (Context, Kext, NumVtables)) {
+    Kext->NumberOfVtables = 0;
+    Kext->LinkedVtables   = NULL;
+    return RETURN_OUT_OF_RESOURCES;
+  }
+
   return RETURN_SUCCESS;
 }
 
@@ -440,22 +607,14 @@ InternalUpdateLinkBuffer (
   return RETURN_SUCCESS;
 }
 
-STATIC
 RETURN_STATUS
-InternalInsertPrelinkedKextDependency (
-  IN OUT PRELINKED_KEXT     *Kext,
+InternalScanPrelinkedKextDependency (
   IN OUT PRELINKED_CONTEXT  *Context,
-  IN     UINT32             DependencyIndex,
   IN OUT PRELINKED_KEXT     *DependencyKext
   )
 {
   RETURN_STATUS  Status;
 
-  if (DependencyIndex >= ARRAY_SIZE (Kext->Dependencies)) {
-    DEBUG ((DEBUG_INFO, "Kext %a has more than %u or more dependencies!", Kext->Identifier, DependencyIndex));
-    return RETURN_OUT_OF_RESOURCES;
-  }
-
   Status = InternalScanPrelinkedKext (DependencyKext, Context);
   if (RETURN_ERROR (Status)) {
     return Status;
@@ -474,91 +633,278 @@ InternalInsertPrelinkedKextDependency (
     return Status;
   }
 
-  Status = InternalScanBuildLinkedVtables (DependencyKext, Context);
+  return InternalScanBuildLinkedVtables (DependencyKext, Context);
+}
+
+STATIC
+RETURN_STATUS
+InternalInsertPrelinkedKextDependency (
+  IN OUT PRELINKED_KEXT     **Dependencies,
+  IN OUT UINT32             *NumberOfDependencies,
+  IN OUT PRELINKED_CONTEXT  *Context,
+  IN OUT PRELINKED_KEXT     *DependencyKext
+  )
+{
+  RETURN_STATUS  Status;
+
+  Status = InternalScanPrelinkedKextDependency (Context, DependencyKext);
   if (RETURN_ERROR (Status)) {
     return Status;
   }
 
-  Kext->Dependencies[DependencyIndex] = DependencyKext;
+  Dependencies[(*NumberOfDependencies)++] = DependencyKext;
 
   return RETURN_SUCCESS;
 }
 
 PRELINKED_KEXT *
 InternalNewPrelinkedKext (
-  IN OC_MACHO_CONTEXT       *Context,
-  IN XML_NODE               *KextPlist
+  IN OUT PRELINKED_CONTEXT  *Prelinked,
+  IN     OC_MACHO_CONTEXT   *Context,
+  IN     XML_NODE           *KextPlist
   )
 {
   PRELINKED_KEXT  *NewKext;
 
-  NewKext = InternalCreatePrelinkedKext (NULL, KextPlist, NULL);
+  NewKext = InternalCreatePrelinkedKext (&Prelinked->Arena, NULL, KextPlist, NULL);
   if (NewKext == NULL) {
     return NULL;
   }
 
+  NewKext->Injected = TRUE;
+
   CopyMem (&NewKext->Context.MachContext, Context, sizeof (NewKext->Context.MachContext));
   return NewKext;
 }
 
-VOID
-InternalFreePrelinkedKext (
-  IN PRELINKED_KEXT  *Kext
+/**
+  Finds identifier lookup table entry.
+
+  @param[in] Prelinked   Prelinked context.
+  @param[in] Identifier  Kext CFBundleIdentifier.
+  @param[in] Hash        Identifier hash.
+
+  @return found entry or first empty entry in the probe sequence.
+**/
+STATIC
+PRELINKED_KEXT_INDEX_ENTRY *
+InternalFindKextIndex (
+  IN PRELINKED_CONTEXT  *Prelinked,
+  IN CONST CHAR8        *Identifier,
+  IN UINT32             Hash
   )
 {
-  if (Kext->LinkedSymbolTable != NULL) {
-    FreePool (Kext->LinkedSymbolTable);
-    Kext->LinkedSymbolTable = NULL;
+  PRELINKED_KEXT_INDEX_ENTRY  *Entry;
+  UINT32                      Slot;
+
+  Slot = Hash & Prelinked->KextIndexMask;
+  while (TRUE) {
+    Entry = &Prelinked->KextIndex[Slot];
+    if (Entry->Identifier == NULL
+      || (Entry->Hash == Hash && AsciiStrCmp (Entry->Identifier, Identifier) == 0)) {
+      return Entry;
+    }
+
+    Slot = (Slot + 1) & Prelinked->KextIndexMask;
   }
+}
 
-  if (Kext->LinkedVtables != NULL) {
-    FreePool (Kext->LinkedVtables);
-    Kext->LinkedVtables = NULL;
+/**
+  Resizes identifier lookup table to hold at least Count entries.
+
+  @param[in,out] Prelinked   Prelinked context.
+  @param[in]     Count       Number of entries to hold.
+
+  @return RETURN_SUCCESS on success.
+**/
+STATIC
+RETURN_STATUS
+InternalResizeKextIndex (
+  IN OUT PRELINKED_CONTEXT  *Prelinked,
+  IN     UINT32             Count
+  )
+{
+  PRELINKED_KEXT_INDEX_ENTRY  *OldIndex;
+  PRELINKED_KEXT_INDEX_ENTRY  *Entry;
+  UINT32                      OldSize;
+  UINT32                      NewSize;
+  UINT32                      Index;
+
+  //
+  // Keep load factor below 1/2. Count is bounded by XML_PARSER_NODE_COUNT.
+  //
+  NewSize = GetPowerOfTwo32 (Count | 1U) << 2U;
+  Entry   = AllocateZeroPool (NewSize * sizeof (*Entry));
+  if (Entry == NULL) {
+    return RETURN_OUT_OF_RESOURCES;
   }
 
-  FreePool (Kext);
+  OldIndex = Prelinked->KextIndex;
+  OldSize  = OldIndex != NULL ? Prelinked->KextIndexMask + 1 : 0;
+
+  Prelinked->KextIndex     = Entry;
+  Prelinked->KextIndexMask = NewSize - 1;
+
+  for (Index = 0; Index < OldSize; ++Index) {
+    if (OldIndex[Index].Identifier != NULL) {
+      Entry = InternalFindKextIndex (Prelinked, OldIndex[Index].Identifier, OldIndex[Index].Hash);
+      CopyMem (Entry, &OldIndex[Index], sizeof (*Entry));
+    }
+  }
+
+  if (OldIndex != NULL) {
+    FreePool (OldIndex);
+  }
+
+  return RETURN_SUCCESS;
 }
 
-PRELINKED_KEXT *
-InternalCachedPrelinkedKext (
+RETURN_STATUS
+InternalInsertKextIndex (
   IN OUT PRELINKED_CONTEXT  *Prelinked,
-  IN     CONST CHAR8        *Identifier
+  IN     CONST CHAR8        *Identifier,
+  IN     XML_NODE           *Plist OPTIONAL,
+  IN     PRELINKED_KEXT     *Kext OPTIONAL
   )
 {
-  PRELINKED_KEXT  *NewKext;
+  RETURN_STATUS               Status;
+  PRELINKED_KEXT_INDEX_ENTRY  *Entry;
+  UINT32                      Hash;
+
+  if (Prelinked->KextIndex == NULL
+    || (Prelinked->KextIndexCount + 1) * 2 > Prelinked->KextIndexMask + 1) {
+    Status = InternalResizeKextIndex (Prelinked, Prelinked->KextIndexCount + 1);
+    if (RETURN_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  Hash  = AsciiStrHash (Identifier, NULL);
+  Entry = InternalFindKextIndex (Prelinked, Identifier, Hash);
+  if (Entry->Identifier == NULL) {
+    Entry->Identifier = Identifier;
+    Entry->Plist      = Plist;
+    Entry->Kext       = Kext;
+    Entry->Hash       = Hash;
+    ++Prelinked->KextIndexCount;
+  }
+
+  return RETURN_SUCCESS;
+}
+
+RETURN_STATUS
+InternalCreateKextIndex (
+  IN OUT PRELINKED_CONTEXT  *Prelinked
+  )
+{
+  RETURN_STATUS   Status;
   LIST_ENTRY      *Kext;
   UINT32          Index;
   UINT32          KextCount;
   XML_NODE        *KextPlist;
+  XML_NODE        *KextPlistValue;
+  CONST CHAR8     *KextIdentifier;
+
+  KextCount = XmlNodeChildren (Prelinked->KextList);
+
+  Status = InternalResizeKextIndex (Prelinked, KextCount + 1);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
 
   //
-  // Find cached entry if any.
+  // Already cached kexts (i.e. kernel) go first as they are found first.
   //
   Kext = GetFirstNode (&Prelinked->PrelinkedKexts);
   while (!IsNull (&Prelinked->PrelinkedKexts, Kext)) {
-    if (AsciiStrCmp (Identifier, GET_PRELINKED_KEXT_FROM_LINK (Kext)->Identifier) == 0) {
-      return GET_PRELINKED_KEXT_FROM_LINK (Kext);
+    Status = InternalInsertKextIndex (
+      Prelinked,
+      GET_PRELINKED_KEXT_FROM_LINK (Kext)->Identifier,
+      NULL,
+      GET_PRELINKED_KEXT_FROM_LINK (Kext)
+      );
+    if (RETURN_ERROR (Status)) {
+      return Status;
     }
 
     Kext = GetNextNode (&Prelinked->PrelinkedKexts, Kext);
   }
 
+  for (Index = 0; Index < KextCount; ++Index) {
+    KextPlist = PlistNodeCast (XmlNodeChild (Prelinked->KextList, Index), PLIST_NODE_TYPE_DICT);
+    if (KextPlist == NULL) {
+      continue;
+    }
+
+    KextPlistValue = PlistNodeCast (PlistDictFind (KextPlist, INFO_BUNDLE_IDENTIFIER_KEY), PLIST_NODE_TYPE_STRING);
+    if (KextPlistValue == NULL) {
+      continue;
+    }
+
+    KextIdentifier = XmlNodeContent (KextPlistValue);
+    if (KextIdentifier == NULL) {
+      continue;
+    }
+
+    Status = InternalInsertKextIndex (Prelinked, KextIdentifier, KextPlist, NULL);
+    if (RETURN_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return RETURN_SUCCESS;
+}
+
+PRELINKED_KEXT *
+InternalCachedPrelinkedKext (
+  IN OUT PRELINKED_CONTEXT  *Prelinked,
+  IN     CONST CHAR8        *Identifier
+  )
+{
+  PRELINKED_KEXT              *NewKext;
+  PRELINKED_KEXT_INDEX_ENTRY  *Entry;
+  UINT32                      Index;
+  UINT32                      KextCount;
+  XML_NODE                    *KextPlist;
+
+  if (Prelinked->KextIndex == NULL) {
+    return NULL;
+  }
+
+  Entry = InternalFindKextIndex (Prelinked, Identifier, AsciiStrHash (Identifier, NULL));
+  if (Entry->Identifier == NULL) {
+    return NULL;
+  }
+
+  //
+  // Find cached entry if any.
+  //
+  if (Entry->Kext != NULL) {
+    return Entry->Kext;
+  }
+
   //
   // Try with real entry.
   //
-  NewKext   = NULL;
+  if (Entry->Plist == NULL) {
+    return NULL;
+  }
+
+  NewKext = InternalCreatePrelinkedKext (&Prelinked->Arena, Prelinked, Entry->Plist, Identifier);
+
+  //
+  // Only the first kext with the identifier is indexed, try the others
+  // in KextList order if it cannot be loaded.
+  //
   KextCount = XmlNodeChildren (Prelinked->KextList);
-  for (Index = 0; Index < KextCount; ++Index) {
+  for (Index = 0; NewKext == NULL && Index < KextCount; ++Index) {
     KextPlist = PlistNodeCast (XmlNodeChild (Prelinked->KextList, Index), PLIST_NODE_TYPE_DICT);
 
-    if (KextPlist == NULL) {
+    if (KextPlist == NULL || KextPlist == Entry->Plist) {
       continue;
     }
 
-    NewKext = InternalCreatePrelinkedKext (Prelinked, KextPlist, Identifier);
-    if (NewKext != NULL) {
-      break;
-    }
+    NewKext = InternalCreatePrelinkedKext (&Prelinked->Arena, Prelinked, KextPlist, Identifier);
   }
 
   if (NewKext == NULL) {
@@ -566,6 +912,7 @@ InternalCachedPrelinkedKext (
   }
 
   InsertTailList (&Prelinked->PrelinkedKexts, &NewKext->Link);
+  Entry->Kext = NewKext;
 
   return NewKext;
 }
@@ -587,7 +934,7 @@ InternalCachedPrelinkedKernel (
     return GET_PRELINKED_KEXT_FROM_LINK (Kext);
   }
 
-  NewKext = AllocateZeroPool (sizeof (*NewKext));
+  NewKext = OcArenaAllocateZero (&Prelinked->Arena, sizeof (*NewKext));
   if (NewKext == NULL) {
     return NULL;
   }
@@ -596,7 +943,6 @@ InternalCachedPrelinkedKernel (
   ASSERT (Prelinked->PrelinkedSize > 0);
 
   if (!MachoInitializeContext (&NewKext->Context.MachContext, &Prelinked->Prelinked[0], Prelinked->PrelinkedSize)) {
-    FreePool (NewKext);
     return NULL;
   }
 
@@ -605,7 +951,6 @@ InternalCachedPrelinkedKernel (
     "__TEXT"
     );
   if (Segment == NULL || Segment->VirtualAddress < Segment->FileOffset) {
-    FreePool (NewKext);
     return NULL;
   }
 
@@ -627,12 +972,13 @@ InternalScanPrelinkedKext (
   IN OUT PRELINKED_CONTEXT  *Context
   )
 {
-  RETURN_STATUS      Status;
+  RETURN_STATUS   Status;
   UINT32          FieldCount;
   UINT32          FieldIndex;
-  UINT32          DependencyIndex;
+  UINT32          NumberOfDependencies;
   CONST CHAR8     *DependencyId;
   PRELINKED_KEXT  *DependencyKext;
+  PRELINKED_KEXT  **Dependencies;
 
   Status = InternalScanCurrentPrelinkedKext (Kext);
   if (RETURN_ERROR (Status)) {
@@ -655,16 +1001,26 @@ InternalScanPrelinkedKext (
     return RETURN_NOT_FOUND;
   }
 
-  if (DependencyKext != Kext) {
-    Status = InternalInsertPrelinkedKextDependency (Kext, Context, 0, DependencyKext);
+  //
+  // Dependencies are resolved once, kernel has none.
+  //
+  if (Kext->Dependencies == NULL && DependencyKext != Kext) {
+    FieldCount = 0;
+    if (Kext->BundleLibraries != NULL) {
+      FieldCount = PlistDictChildren (Kext->BundleLibraries);
+    }
+
+    Dependencies = OcArenaAllocate (&Context->Arena, (FieldCount + 1) * sizeof (*Dependencies));
+    if (Dependencies == NULL) {
+      return RETURN_OUT_OF_RESOURCES;
+    }
+
+    NumberOfDependencies = 0;
+
+    Status = InternalInsertPrelinkedKextDependency (Dependencies, &NumberOfDependencies, Context, DependencyKext);
     if (RETURN_ERROR (Status)) {
       return Status;
     }
-  }
-
-  if (Kext->BundleLibraries != NULL) {
-    DependencyIndex = 1;
-    FieldCount = PlistDictChildren (Kext->BundleLibraries);
 
     for (FieldIndex = 0; FieldIndex < FieldCount; ++FieldIndex) {
       DependencyId = PlistKeyValue (PlistDictChild (Kext->BundleLibraries, FieldIndex, NULL));
@@ -700,14 +1056,15 @@ InternalScanPrelinkedKext (
         }
       }
 
-      Status = InternalInsertPrelinkedKextDependency (Kext, Context, DependencyIndex, DependencyKext);
+      Status = InternalInsertPrelinkedKextDependency (Dependencies, &NumberOfDependencies, Context, DependencyKext);
       if (RETURN_ERROR (Status)) {
         return Status;
       }
-
-      ++DependencyIndex;
     }
 
+    Kext->Dependencies         = Dependencies;
+    Kext->NumberOfDependencies = NumberOfDependencies;
+
     //
     // We do not need this anymore.
     // Additionally it may point to invalid memory on prelinked kexts.
@@ -740,6 +1097,33 @@ InternalUnlockContextKexts (
   }
 }
 
+/**
+  Copy string to prelinked context arena.
+
+  @param[in,out] Context  Prelinked context.
+  @param[in]     String   String to copy.
+
+  @return copied string or NULL.
+**/
+STATIC
+CHAR8 *
+InternalArenaCopyString (
+  IN OUT PRELINKED_CONTEXT  *Context,
+  IN     CONST CHAR8        *String
+  )
+{
+  CHAR8  *Copy;
+  UINTN  Size;
+
+  Size = AsciiStrSize (String);
+  Copy = OcArenaAllocate (&Context->Arena, Size);
+  if (Copy != NULL) {
+    CopyMem (Copy, String, Size);
+  }
+
+  return Copy;
+}
+
 PRELINKED_KEXT *
 InternalLinkPrelinkedKext (
   IN OUT PRELINKED_CONTEXT  *Context,
@@ -752,46 +1136,29 @@ InternalLinkPrelinkedKext (
   RETURN_STATUS      Status;
   PRELINKED_KEXT  *Kext;
 
-  Kext = InternalNewPrelinkedKext (Executable, PlistRoot);
+  Kext = InternalNewPrelinkedKext (Context, Executable, PlistRoot);
   if (Kext == NULL) {
     return NULL;
   }
 
   Status = InternalScanPrelinkedKext (Kext, Context);
   if (RETURN_ERROR (Status)) {
-    InternalFreePrelinkedKext (Kext);
     return NULL;
   }
 
   //
   // Detach Identifier from temporary memory location.
   //
-  Kext->Identifier = AllocateCopyPool (AsciiStrSize (Kext->Identifier), Kext->Identifier);
+  Kext->Identifier = InternalArenaCopyString (Context, Kext->Identifier);
   if (Kext->Identifier == NULL) {
-    InternalFreePrelinkedKext (Kext);
-    return NULL;
-  }
-
-  Status = PrelinkedDependencyInsert (Context, (VOID *)Kext->Identifier);
-  if (RETURN_ERROR (Status)) {
-    FreePool ((VOID *)Kext->Identifier);
-    InternalFreePrelinkedKext (Kext);
     return NULL;
   }
   //
   // Also detach bundle compatible version if any.
   //
   if (Kext->CompatibleVersion != NULL) {
-    Kext->CompatibleVersion = AllocateCopyPool (AsciiStrSize (Kext->CompatibleVersion), Kext->CompatibleVersion);
+    Kext->CompatibleVersion = InternalArenaCopyString (Context, Kext->CompatibleVersion);
     if (Kext->CompatibleVersion == NULL) {
-      InternalFreePrelinkedKext (Kext);
-      return NULL;
-    }
-
-    Status = PrelinkedDependencyInsert (Context, (VOID *)Kext->CompatibleVersion);
-    if (RETURN_ERROR (Status)) {
-      FreePool ((VOID *)Kext->CompatibleVersion);
-      InternalFreePrelinkedKext (Kext);
       return NULL;
     }
   }
@@ -804,7 +1171,6 @@ InternalLinkPrelinkedKext (
   Status = InternalPrelinkKext64 (Context, Kext, LoadAddress);
 
   if (RETURN_ERROR (Status)) {
-    InternalFreePrelinkedKext (Kext);
     return NULL;
   }
 
@@ -0,0 +1,969 @@
+/** @file
+  Copyright (C) 2019, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Base.h>
+
+#include <IndustryStandard/AppleMachoImage.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcAppleKernelLib.h>
+#include <Library/OcGuardLib.h>
+#include <Library/OcMachoLib.h>
+#include <Library/OcStorageLib.h>
+#include <Library/OcStringLib.h>
+
+#include "PrelinkedInternal.h"
+
+//
+// Symbol cache file layout. All fields are naturally aligned and every
+// kext record starts at 8-byte boundary:
+//
+//   PRELINKED_SYMBOL_CACHE_HEADER
+//   PRELINKED_SYMBOL_CACHE_KEXT followed by:
+//     CHAR8                               Identifier[IdentifierSize]
+//     CHAR8                               Version[VersionSize] (padded to 8)
+//     PRELINKED_SYMBOL_CACHE_SYMBOL       Symbols[NumberOfSymbols]
+//     UINT32                              SymbolIndex[PRELINKED_SYMBOL_INDEX_SIZE]
+//     UINT32                              SymbolValues[NumberOfSymbols] (padded to 8)
+//     PRELINKED_SYMBOL_CACHE_VTABLE       Vtable, each followed by:
+//       PRELINKED_SYMBOL_CACHE_VTABLE_ENTRY  Entries[NumEntries]
+//   ...
+//
+// Symbol names are stored as offsets into string tables, which are part of
+// kernel and kext images.
+//
+
+typedef struct {
+  UINT32  Signature;
+  UINT32  Version;
+  UINT32  Size;
+  UINT32  NumberOfKexts;
+  UINT8   KernelUuid[16];
+} PRELINKED_SYMBOL_CACHE_HEADER;
+
+typedef struct {
+  UINT32  Size;
+  UINT32  IdentifierSize;
+  UINT32  VersionSize;
+  UINT32  NumberOfRawSymbols;
+  UINT32  NumberOfSymbols;
+  UINT32  NumberOfCxxSymbols;
+  UINT32  NumberOfVtables;
+  UINT32  NumberOfVtableEntries;
+  UINT8   Uuid[16];
+  //
+  // Cached symbol values are only valid at the same kext addresses.
+  //
+  UINT64  LoadAddress;
+  UINT64  TextAddress;
+  UINT64  TextSize;
+} PRELINKED_SYMBOL_CACHE_KEXT;
+
+typedef struct {
+  UINT64  Value;
+  UINT32  NameOffset;
+  UINT32  Length;
+  UINT32  Hash;
+  UINT32  Reserved;
+} PRELINKED_SYMBOL_CACHE_SYMBOL;
+
+typedef struct {
+  UINT32  NameOffset;
+  UINT32  Length;
+  UINT32  NumEntries;
+  UINT32  Reserved;
+} PRELINKED_SYMBOL_CACHE_VTABLE;
+
+//
+// Owner is kext record index with entry name string table, MAX_UINT32 for no name.
+//
+typedef struct {
+  UINT64  Address;
+  UINT32  Owner;
+  UINT32  NameOffset;
+  UINT32  Length;
+  UINT32  Reserved;
+} PRELINKED_SYMBOL_CACHE_VTABLE_ENTRY;
+
+OC_GLOBAL_STATIC_ASSERT (
+  sizeof (PRELINKED_SYMBOL_CACHE_HEADER) % sizeof (UINT64) == 0
+  && sizeof (PRELINKED_SYMBOL_CACHE_KEXT) % sizeof (UINT64) == 0
+  && sizeof (PRELINKED_SYMBOL_CACHE_SYMBOL) % sizeof (UINT64) == 0
+  && sizeof (PRELINKED_SYMBOL_CACHE_VTABLE) % sizeof (UINT64) == 0
+  && sizeof (PRELINKED_SYMBOL_CACHE_VTABLE_ENTRY) % sizeof (UINT64) == 0,
+  "Symbol cache structures must keep 8-byte alignment"
+  );
+
+//
+// Kext record section offsets.
+//
+typedef struct {
+  UINT64  Symbols;
+  UINT64  SymbolIndex;
+  UINT64  SymbolValues;
+  UINT64  Vtables;
+  UINT64  Size;
+  UINT32  IndexSize;
+} PRELINKED_SYMBOL_CACHE_LAYOUT;
+
+//
+// Validated kext record.
+//
+typedef struct {
+  CONST PRELINKED_SYMBOL_CACHE_KEXT    *Header;
+  CONST PRELINKED_SYMBOL_CACHE_SYMBOL  *Symbols;
+  CONST UINT32                         *SymbolIndex;
+  CONST UINT32                         *SymbolValues;
+  CONST UINT8                          *Vtables;
+  UINT32                               IndexSize;
+  UINT32                               StringsSize;
+  PRELINKED_KEXT                       *Kext;
+} PRELINKED_SYMBOL_CACHE_RECORD;
+
+/**
+  Calculate kext record layout.
+
+  @param[in]  Header  Kext record header.
+  @param[out] Layout  Kext record layout.
+
+  @return FALSE if the record cannot fit the cache.
+**/
+STATIC
+BOOLEAN
+InternalSymbolCacheLayout (
+  IN  CONST PRELINKED_SYMBOL_CACHE_KEXT  *Header,
+  OUT PRELINKED_SYMBOL_CACHE_LAYOUT      *Layout
+  )
+{
+  //
+  // Symbols alone would not fit 4 GB otherwise, which also keeps index size in range.
+  //
+  if (Header->NumberOfSymbols >= BIT28) {
+    return FALSE;
+  }
+
+  Layout->IndexSize    = PRELINKED_SYMBOL_INDEX_SIZE (Header->NumberOfSymbols);
+  Layout->Symbols      = ALIGN_VALUE (
+                           sizeof (*Header) + (UINT64) Header->IdentifierSize + Header->VersionSize,
+                           sizeof (UINT64)
+                           );
+  Layout->SymbolIndex  = Layout->Symbols
+                           + (UINT64) Header->NumberOfSymbols * sizeof (PRELINKED_SYMBOL_CACHE_SYMBOL);
+  Layout->SymbolValues = Layout->SymbolIndex + (UINT64) Layout->IndexSize * sizeof (UINT32);
+  Layout->Vtables      = Layout->SymbolValues
+                           + ALIGN_VALUE ((UINT64) Header->NumberOfSymbols * sizeof (UINT32), sizeof (UINT64));
+  Layout->Size         = Layout->Vtables
+                           + (UINT64) Header->NumberOfVtables * sizeof (PRELINKED_SYMBOL_CACHE_VTABLE)
+                           + (UINT64) Header->NumberOfVtableEntries * sizeof (PRELINKED_SYMBOL_CACHE_VTABLE_ENTRY);
+
+  return Layout->Size <= MAX_UINT32;
+}
+
+/**
+  Get kext load address and __TEXT segment placement.
+
+  @param[in]  Kext         Kext.
+  @param[out] LoadAddress  Kext load address.
+  @param[out] TextAddress  __TEXT segment address, 0 when missing.
+  @param[out] TextSize     __TEXT segment size, 0 when missing.
+**/
+STATIC
+VOID
+InternalSymbolCacheKextAddress (
+  IN  PRELINKED_KEXT  *Kext,
+  OUT UINT64          *LoadAddress,
+  OUT UINT64          *TextAddress,
+  OUT UINT64          *TextSize
+  )
+{
+  MACH_SEGMENT_COMMAND_64  *Segment;
+
+  *LoadAddress = Kext->Context.VirtualBase;
+  *TextAddress = 0;
+  *TextSize    = 0;
+
+  Segment = MachoGetSegmentByName64 (&Kext->Context.MachContext, "__TEXT");
+  if (Segment != NULL) {
+    *TextAddress = Segment->VirtualAddress;
+    *TextSize    = Segment->Size;
+  }
+}
+
+/**
+  Check whether kext has linked symbol table and vtables to export.
+**/
+STATIC
+BOOLEAN
+InternalSymbolCacheExportable (
+  IN PRELINKED_KEXT  *Kext
+  )
+{
+  return !Kext->Injected
+    && Kext->LinkedSymbolTable != NULL
+    && Kext->LinkedVtables != NULL
+    && Kext->StringTable != NULL;
+}
+
+/**
+  Find kext record owning symbol name.
+
+  @param[in]  Kexts          Exported kexts.
+  @param[in]  NumberOfKexts  Number of exported kexts.
+  @param[in]  Name           Symbol name.
+  @param[out] NameOffset     Symbol name offset in owner string table.
+
+  @return owner kext record index or MAX_UINT32.
+**/
+STATIC
+UINT32
+InternalSymbolCacheFindOwner (
+  IN  PRELINKED_KEXT  **Kexts,
+  IN  UINT32          NumberOfKexts,
+  IN  CONST CHAR8     *Name,
+  OUT UINT32          *NameOffset
+  )
+{
+  UINT32  Index;
+  UINTN   Offset;
+
+  for (Index = 0; Index < NumberOfKexts; ++Index) {
+    Offset = (UINTN) Name - (UINTN) Kexts[Index]->StringTable;
+    if ((UINTN) Name >= (UINTN) Kexts[Index]->StringTable
+      && Offset < Kexts[Index]->Context.MachContext.Symtab->StringsSize) {
+      *NameOffset = (UINT32) Offset;
+      return Index;
+    }
+  }
+
+  return MAX_UINT32;
+}
+
+/**
+  Write kext record to symbol cache.
+
+  @param[in]  Kexts          Exported kexts.
+  @param[in]  NumberOfKexts  Number of exported kexts.
+  @param[in]  Kext           Kext to write.
+  @param[in]  Header         Prepared kext record header.
+  @param[in]  Layout         Kext record layout.
+  @param[out] Record         Kext record, zeroed.
+
+  @return RETURN_SUCCESS on success.
+**/
+STATIC
+RETURN_STATUS
+InternalSymbolCacheWriteKext (
+  IN  PRELINKED_KEXT                       **Kexts,
+  IN  UINT32                               NumberOfKexts,
+  IN  PRELINKED_KEXT                       *Kext,
+  IN  CONST PRELINKED_SYMBOL_CACHE_KEXT    *Header,
+  IN  CONST PRELINKED_SYMBOL_CACHE_LAYOUT  *Layout,
+  OUT UINT8                                *Record
+  )
+{
+  PRELINKED_SYMBOL_CACHE_SYMBOL        *Symbols;
+  UINT32                               *SymbolValues;
+  PRELINKED_SYMBOL_CACHE_VTABLE        *Vtable;
+  PRELINKED_SYMBOL_CACHE_VTABLE_ENTRY  *Entry;
+  CONST PRELINKED_VTABLE               *LinkedVtable;
+  UINT32                               Index;
+  UINT32                               EntryIndex;
+
+  CopyMem (Record, Header, sizeof (*Header));
+  CopyMem (Record + sizeof (*Header), Kext->Identifier, Header->IdentifierSize);
+  if (Header->VersionSize > 0) {
+    CopyMem (Record + sizeof (*Header) + Header->IdentifierSize, Kext->Version, Header->VersionSize);
+  }
+
+  Symbols = (PRELINKED_SYMBOL_CACHE_SYMBOL *) (Record + Layout->Symbols);
+  for (Index = 0; Index < Kext->NumberOfSymbols; ++Index) {
+    Symbols[Index].Value      = Kext->LinkedSymbolTable[Index].Value;
+    Symbols[Index].NameOffset = (UINT32) (Kext->LinkedSymbolTable[Index].Name - Kext->StringTable);
+    Symbols[Index].Length     = Kext->LinkedSymbolTable[Index].Length;
+    Symbols[Index].Hash       = Kext->LinkedSymbolTable[Index].Hash;
+  }
+
+  CopyMem (
+    Record + Layout->SymbolIndex,
+    Kext->LinkedSymbolIndex,
+    Layout->IndexSize * sizeof (*Kext->LinkedSymbolIndex)
+    );
+
+  SymbolValues = (UINT32 *) (Record + Layout->SymbolValues);
+  for (Index = 0; Index < Kext->NumberOfSymbols; ++Index) {
+    SymbolValues[Index] = Kext->LinkedSymbolValues[Index].Index;
+  }
+
+  Vtable       = (PRELINKED_SYMBOL_CACHE_VTABLE *) (Record + Layout->Vtables);
+  LinkedVtable = Kext->LinkedVtables;
+  for (Index = 0; Index < Kext->NumberOfVtables; ++Index) {
+    Vtable->NameOffset = (UINT32) (LinkedVtable->Name - Kext->StringTable);
+    Vtable->Length     = (UINT32) AsciiStrLen (LinkedVtable->Name);
+    Vtable->NumEntries = LinkedVtable->NumEntries;
+
+    Entry = (PRELINKED_SYMBOL_CACHE_VTABLE_ENTRY *) (Vtable + 1);
+    for (EntryIndex = 0; EntryIndex < LinkedVtable->NumEntries; ++EntryIndex) {
+      Entry[EntryIndex].Address = LinkedVtable->Entries[EntryIndex].Address;
+      Entry[EntryIndex].Owner   = MAX_UINT32;
+
+      if (LinkedVtable->Entries[EntryIndex].Name != NULL) {
+        Entry[EntryIndex].Owner = InternalSymbolCacheFindOwner (
+                                    Kexts,
+                                    NumberOfKexts,
+                                    LinkedVtable->Entries[EntryIndex].Name,
+                                    &Entry[EntryIndex].NameOffset
+                                    );
+        if (Entry[EntryIndex].Owner == MAX_UINT32) {
+          return RETURN_NOT_FOUND;
+        }
+
+        Entry[EntryIndex].Length = (UINT32) AsciiStrLen (LinkedVtable->Entries[EntryIndex].Name);
+      }
+    }
+
+    Vtable       = (PRELINKED_SYMBOL_CACHE_VTABLE *) &Entry[LinkedVtable->NumEntries];
+    LinkedVtable = GET_NEXT_PRELINKED_VTABLE (LinkedVtable);
+  }
+
+  return RETURN_SUCCESS;
+}
+
+RETURN_STATUS
+PrelinkedExportSymbolCache (
+  IN OUT PRELINKED_CONTEXT  *Context,
+     OUT VOID               **Buffer,
+     OUT UINT32             *BufferSize
+  )
+{
+  RETURN_STATUS                  Status;
+  MACH_UUID_COMMAND              *Uuid;
+  LIST_ENTRY                     *Link;
+  PRELINKED_KEXT                 *Kext;
+  PRELINKED_KEXT                 **Kexts;
+  PRELINKED_SYMBOL_CACHE_KEXT    *KextHeaders;
+  PRELINKED_SYMBOL_CACHE_HEADER  *Header;
+  PRELINKED_SYMBOL_CACHE_LAYOUT  Layout;
+  CONST PRELINKED_VTABLE         *LinkedVtable;
+  UINT32                         NumberOfKexts;
+  UINT32                         Index;
+  UINT32                         VtableIndex;
+  UINT64                         Size;
+  UINT8                          *Cache;
+  UINT8                          *Walker;
+
+  *Buffer     = NULL;
+  *BufferSize = 0;
+
+  Uuid = MachoGetUuid64 (&Context->PrelinkedMachContext);
+  if (Uuid == NULL) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  NumberOfKexts = 0;
+  for (
+    Link = GetFirstNode (&Context->PrelinkedKexts);
+    !IsNull (&Context->PrelinkedKexts, Link);
+    Link = GetNextNode (&Context->PrelinkedKexts, Link)
+    ) {
+    if (InternalSymbolCacheExportable (GET_PRELINKED_KEXT_FROM_LINK (Link))) {
+      ++NumberOfKexts;
+    }
+  }
+
+  if (NumberOfKexts == 0) {
+    return RETURN_NOT_FOUND;
+  }
+
+  Kexts = AllocatePool (NumberOfKexts * (sizeof (*Kexts) + sizeof (*KextHeaders)));
+  if (Kexts == NULL) {
+    return RETURN_OUT_OF_RESOURCES;
+  }
+
+  KextHeaders = (PRELINKED_SYMBOL_CACHE_KEXT *) &Kexts[NumberOfKexts];
+  ZeroMem (KextHeaders, NumberOfKexts * sizeof (*KextHeaders));
+
+  //
+  // Prepare record headers and calculate cache size.
+  //
+  Size  = sizeof (*Header);
+  Index = 0;
+  for (
+    Link = GetFirstNode (&Context->PrelinkedKexts);
+    !IsNull (&Context->PrelinkedKexts, Link);
+    Link = GetNextNode (&Context->PrelinkedKexts, Link)
+    ) {
+    Kext = GET_PRELINKED_KEXT_FROM_LINK (Link);
+    if (!InternalSymbolCacheExportable (Kext)) {
+      continue;
+    }
+
+    Kexts[Index] = Kext;
+
+    KextHeaders[Index].IdentifierSize     = (UINT32) AsciiStrSize (Kext->Identifier);
+    KextHeaders[Index].VersionSize        = Kext->Version != NULL ? (UINT32) AsciiStrSize (Kext->Version) : 0;
+    KextHeaders[Index].NumberOfRawSymbols = Kext->Context.MachContext.Symtab->NumSymbols;
+    KextHeaders[Index].NumberOfSymbols    = Kext->NumberOfSymbols;
+    KextHeaders[Index].NumberOfCxxSymbols = Kext->NumberOfCxxSymbols;
+    KextHeaders[Index].NumberOfVtables    = Kext->NumberOfVtables;
+
+    LinkedVtable = Kext->LinkedVtables;
+    for (VtableIndex = 0; VtableIndex < Kext->NumberOfVtables; ++VtableIndex) {
+      KextHeaders[Index].NumberOfVtableEntries += LinkedVtable->NumEntries;
+      LinkedVtable = GET_NEXT_PRELINKED_VTABLE (LinkedVtable);
+    }
+
+    Uuid = MachoGetUuid64 (&Kext->Context.MachContext);
+    if (Uuid != NULL) {
+      CopyMem (KextHeaders[Index].Uuid, Uuid->Uuid, sizeof (KextHeaders[Index].Uuid));
+    }
+
+    InternalSymbolCacheKextAddress (
+      Kext,
+      &KextHeaders[Index].LoadAddress,
+      &KextHeaders[Index].TextAddress,
+      &KextHeaders[Index].TextSize
+      );
+
+    if (!InternalSymbolCacheLayout (&KextHeaders[Index], &Layout)) {
+      FreePool (Kexts);
+      return RETURN_UNSUPPORTED;
+    }
+
+    KextHeaders[Index].Size = (UINT32) Layout.Size;
+    Size += Layout.Size;
+    ++Index;
+  }
+
+  if (Size > MAX_UINT32) {
+    FreePool (Kexts);
+    return RETURN_UNSUPPORTED;
+  }
+
+  Cache = AllocateZeroPool ((UINTN) Size);
+  if (Cache == NULL) {
+    FreePool (Kexts);
+    return RETURN_OUT_OF_RESOURCES;
+  }
+
+  Header                = (PRELINKED_SYMBOL_CACHE_HEADER *) Cache;
+  Header->Signature     = PRELINK_SYMBOL_CACHE_SIGNATURE;
+  Header->Version       = PRELINK_SYMBOL_CACHE_VERSION;
+  Header->Size          = (UINT32) Size;
+  Header->NumberOfKexts = NumberOfKexts;
+  CopyMem (
+    Header->KernelUuid,
+    MachoGetUuid64 (&Context->PrelinkedMachContext)->Uuid,
+    sizeof (Header->KernelUuid)
+    );
+
+  Walker = (UINT8 *) (Header + 1);
+  for (Index = 0; Index < NumberOfKexts; ++Index) {
+    InternalSymbolCacheLayout (&KextHeaders[Index], &Layout);
+
+    Status = InternalSymbolCacheWriteKext (
+               Kexts,
+               NumberOfKexts,
+               Kexts[Index],
+               &KextHeaders[Index],
+               &Layout,
+               Walker
+               );
+    if (RETURN_ERROR (Status)) {
+      FreePool (Cache);
+      FreePool (Kexts);
+      return Status;
+    }
+
+    Walker += KextHeaders[Index].Size;
+  }
+
+  FreePool (Kexts);
+
+  *Buffer     = Cache;
+  *BufferSize = (UINT32) Size;
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Check whether cached name is terminated at cached length within the string table.
+
+  @param[in] Record      Kext record owning the string table.
+  @param[in] NameOffset  Name offset in the string table.
+  @param[in] Length      Name length.
+
+  @return TRUE on success.
+**/
+STATIC
+BOOLEAN
+InternalSymbolCacheNameValid (
+  IN CONST PRELINKED_SYMBOL_CACHE_RECORD  *Record,
+  IN UINT32                               NameOffset,
+  IN UINT32                               Length
+  )
+{
+  return NameOffset < Record->StringsSize
+    && Length < Record->StringsSize - NameOffset
+    && Record->Kext->StringTable[NameOffset + Length] == '\0';
+}
+
+/**
+  Validate kext record and find its kext in prelinked.
+
+  @param[in,out] Context    Prelinked context.
+  @param[in]     Data       Kext record.
+  @param[in]     DataSize   Maximum kext record size.
+  @param[out]    Record     Validated kext record.
+
+  @return RETURN_SUCCESS on success.
+**/
+STATIC
+RETURN_STATUS
+InternalSymbolCacheParseKext (
+  IN OUT PRELINKED_CONTEXT              *Context,
+  IN     CONST UINT8                    *Data,
+  IN     UINT32                         DataSize,
+     OUT PRELINKED_SYMBOL_CACHE_RECORD  *Record
+  )
+{
+  RETURN_STATUS                        Status;
+  CONST PRELINKED_SYMBOL_CACHE_KEXT    *Header;
+  PRELINKED_SYMBOL_CACHE_LAYOUT        Layout;
+  CONST CHAR8                          *Identifier;
+  CONST CHAR8                          *Version;
+  MACH_UUID_COMMAND                    *Uuid;
+  PRELINKED_KEXT                       *Kext;
+  CONST PRELINKED_SYMBOL_CACHE_SYMBOL  *Symbol;
+  CONST PRELINKED_SYMBOL_CACHE_SYMBOL  *PrevSymbol;
+  UINT32                               Index;
+  UINT32                               NumIndexed;
+  UINT32                               StringsSize;
+  UINT8                                ZeroUuid[16];
+  UINT64                               LoadAddress;
+  UINT64                               TextAddress;
+  UINT64                               TextSize;
+
+  if (DataSize < sizeof (*Header)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  Header = (CONST PRELINKED_SYMBOL_CACHE_KEXT *) Data;
+  if (!InternalSymbolCacheLayout (Header, &Layout)
+    || Header->Size != Layout.Size
+    || Header->Size > DataSize
+    || Header->IdentifierSize == 0
+    || Header->NumberOfSymbols > Header->NumberOfRawSymbols
+    || Header->NumberOfCxxSymbols > Header->NumberOfSymbols) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  Identifier = (CONST CHAR8 *) (Header + 1);
+  if (Identifier[Header->IdentifierSize - 1] != '\0') {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  Version = NULL;
+  if (Header->VersionSize > 0) {
+    Version = Identifier + Header->IdentifierSize;
+    if (Version[Header->VersionSize - 1] != '\0') {
+      return RETURN_INVALID_PARAMETER;
+    }
+  }
+
+  if (AsciiStrCmp (Identifier, PRELINK_KERNEL_IDENTIFIER) == 0) {
+    Kext = InternalCachedPrelinkedKernel (Context);
+  } else {
+    Kext = InternalCachedPrelinkedKext (Context, Identifier);
+  }
+
+  if (Kext == NULL) {
+    DEBUG ((DEBUG_INFO, "OCK: Symbol cache kext %a is missing\n", Identifier));
+    return RETURN_NOT_FOUND;
+  }
+
+  //
+  // Also rejects duplicate records.
+  //
+  if (Kext->Injected || Kext->LinkedSymbolTable != NULL || Kext->LinkedVtables != NULL) {
+    return RETURN_ALREADY_STARTED;
+  }
+
+  if ((Version == NULL) != (Kext->Version == NULL)
+    || (Version != NULL && AsciiStrCmp (Version, Kext->Version) != 0)) {
+    DEBUG ((DEBUG_INFO, "OCK: Symbol cache kext %a version mismatch\n", Identifier));
+    return RETURN_INCOMPATIBLE_VERSION;
+  }
+
+  //
+  // Kexts without UUID are stored with zero UUID.
+  //
+  ZeroMem (ZeroUuid, sizeof (ZeroUuid));
+  Uuid = MachoGetUuid64 (&Kext->Context.MachContext);
+  if (CompareMem (Uuid != NULL ? Uuid->Uuid : ZeroUuid, Header->Uuid, sizeof (Header->Uuid)) != 0) {
+    DEBUG ((DEBUG_INFO, "OCK: Symbol cache kext %a UUID mismatch\n", Identifier));
+    return RETURN_INCOMPATIBLE_VERSION;
+  }
+
+  //
+  // Same kext may be placed differently, e.g. when prelinkedkernel is rebuilt.
+  //
+  InternalSymbolCacheKextAddress (Kext, &LoadAddress, &TextAddress, &TextSize);
+  if (LoadAddress != Header->LoadAddress
+    || TextAddress != Header->TextAddress
+    || TextSize != Header->TextSize) {
+    DEBUG ((DEBUG_INFO, "OCK: Symbol cache kext %a address mismatch\n", Identifier));
+    return RETURN_INCOMPATIBLE_VERSION;
+  }
+
+  Status = InternalScanCurrentPrelinkedKext (Kext);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Kext->NumberOfSymbols != Header->NumberOfRawSymbols) {
+    return RETURN_INCOMPATIBLE_VERSION;
+  }
+
+  StringsSize = Kext->Context.MachContext.Symtab->StringsSize;
+
+  Record->Header       = Header;
+  Record->Symbols      = (CONST PRELINKED_SYMBOL_CACHE_SYMBOL *) (Data + Layout.Symbols);
+  Record->SymbolIndex  = (CONST UINT32 *) (Data + Layout.SymbolIndex);
+  Record->SymbolValues = (CONST UINT32 *) (Data + Layout.SymbolValues);
+  Record->Vtables      = Data + Layout.Vtables;
+  Record->IndexSize    = Layout.IndexSize;
+  Record->StringsSize  = StringsSize;
+  Record->Kext         = Kext;
+
+  //
+  // Symbol names must be terminated at cached length within the string table.
+  //
+  for (Index = 0; Index < Header->NumberOfSymbols; ++Index) {
+    Symbol = &Record->Symbols[Index];
+    if (!InternalSymbolCacheNameValid (Record, Symbol->NameOffset, Symbol->Length)) {
+      return RETURN_INVALID_PARAMETER;
+    }
+  }
+
+  //
+  // Name index must reference every symbol once and have empty slots to stop probing.
+  //
+  NumIndexed = 0;
+  for (Index = 0; Index < Record->IndexSize; ++Index) {
+    if (Record->SymbolIndex[Index] > Header->NumberOfSymbols) {
+      return RETURN_INVALID_PARAMETER;
+    }
+
+    if (Record->SymbolIndex[Index] != 0) {
+      ++NumIndexed;
+    }
+  }
+
+  if (NumIndexed != Header->NumberOfSymbols) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  //
+  // Value index must be sorted by value and then by symbol index for lookups.
+  //
+  for (Index = 0; Index < Header->NumberOfSymbols; ++Index) {
+    if (Record->SymbolValues[Index] >= Header->NumberOfSymbols) {
+      return RETURN_INVALID_PARAMETER;
+    }
+
+    if (Index > 0) {
+      PrevSymbol = &Record->Symbols[Record->SymbolValues[Index - 1]];
+      Symbol     = &Record->Symbols[Record->SymbolValues[Index]];
+      if (PrevSymbol->Value > Symbol->Value
+        || (PrevSymbol->Value == Symbol->Value
+          && Record->SymbolValues[Index - 1] >= Record->SymbolValues[Index])) {
+        return RETURN_INVALID_PARAMETER;
+      }
+    }
+  }
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Validate kext record vtables.
+
+  @param[in] Records        Validated kext records.
+  @param[in] NumberOfKexts  Number of kext records.
+  @param[in] Record         Kext record to validate vtables of.
+
+  @return TRUE on success.
+**/
+STATIC
+BOOLEAN
+InternalSymbolCacheCheckVtables (
+  IN CONST PRELINKED_SYMBOL_CACHE_RECORD  *Records,
+  IN UINT32                               NumberOfKexts,
+  IN CONST PRELINKED_SYMBOL_CACHE_RECORD  *Record
+  )
+{
+  CONST PRELINKED_SYMBOL_CACHE_VTABLE        *Vtable;
+  CONST PRELINKED_SYMBOL_CACHE_VTABLE_ENTRY  *Entry;
+  UINT32                                     Index;
+  UINT32                                     EntryIndex;
+  UINT32                                     RemainingEntries;
+
+  RemainingEntries = Record->Header->NumberOfVtableEntries;
+  Vtable           = (CONST PRELINKED_SYMBOL_CACHE_VTABLE *) Record->Vtables;
+
+  for (Index = 0; Index < Record->Header->NumberOfVtables; ++Index) {
+    if (!InternalSymbolCacheNameValid (Record, Vtable->NameOffset, Vtable->Length)
+      || Vtable->NumEntries > RemainingEntries) {
+      return FALSE;
+    }
+
+    Entry = (CONST PRELINKED_SYMBOL_CACHE_VTABLE_ENTRY *) (Vtable + 1);
+    for (EntryIndex = 0; EntryIndex < Vtable->NumEntries; ++EntryIndex) {
+      if (Entry[EntryIndex].Owner != MAX_UINT32
+        && (Entry[EntryIndex].Owner >= NumberOfKexts
+          || !InternalSymbolCacheNameValid (
+                &Records[Entry[EntryIndex].Owner],
+                Entry[EntryIndex].NameOffset,
+                Entry[EntryIndex].Length
+                ))) {
+        return FALSE;
+      }
+    }
+
+    RemainingEntries -= Vtable->NumEntries;
+    Vtable            = (CONST PRELINKED_SYMBOL_CACHE_VTABLE *) &Entry[Vtable->NumEntries];
+  }
+
+  return RemainingEntries == 0;
+}
+
+/**
+  Construct linked symbol table and vtables from validated kext record.
+
+  @param[in,out] Context        Prelinked context.
+  @param[in]     Records        Validated kext records.
+  @param[in]     Record         Kext record to construct from.
+
+  @return RETURN_SUCCESS on success.
+**/
+STATIC
+RETURN_STATUS
+InternalSymbolCacheLoadKext (
+  IN OUT PRELINKED_CONTEXT                    *Context,
+  IN     CONST PRELINKED_SYMBOL_CACHE_RECORD  *Records,
+  IN     CONST PRELINKED_SYMBOL_CACHE_RECORD  *Record
+  )
+{
+  CONST PRELINKED_SYMBOL_CACHE_KEXT          *Header;
+  CONST PRELINKED_SYMBOL_CACHE_VTABLE        *Vtable;
+  CONST PRELINKED_SYMBOL_CACHE_VTABLE_ENTRY  *Entry;
+  PRELINKED_KEXT                             *Kext;
+  PRELINKED_KEXT_SYMBOL                      *SymbolTable;
+  UINT32                                     *SymbolIndex;
+  PRELINKED_KEXT_SYMBOL_VALUE                *SymbolValues;
+  PRELINKED_VTABLE                           *LinkedVtables;
+  PRELINKED_VTABLE                           *LinkedVtable;
+  UINT32                                     Index;
+  UINT32                                     EntryIndex;
+
+  Header = Record->Header;
+  Kext   = Record->Kext;
+
+  SymbolTable   = OcArenaAllocate (
+                    &Context->Arena,
+                    (Header->NumberOfSymbols | 1U) * sizeof (*SymbolTable)
+                    );
+  SymbolIndex   = OcArenaAllocate (
+                    &Context->Arena,
+                    Record->IndexSize * sizeof (*SymbolIndex)
+                    );
+  SymbolValues  = OcArenaAllocate (
+                    &Context->Arena,
+                    (Header->NumberOfSymbols | 1U) * sizeof (*SymbolValues)
+                    );
+  LinkedVtables = OcArenaAllocate (
+                    &Context->Arena,
+                    (Header->NumberOfVtables * sizeof (*LinkedVtables))
+                      + (Header->NumberOfVtableEntries * sizeof (*LinkedVtables->Entries))
+                    );
+  if (SymbolTable == NULL || SymbolIndex == NULL || SymbolValues == NULL || LinkedVtables == NULL) {
+    return RETURN_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < Header->NumberOfSymbols; ++Index) {
+    SymbolTable[Index].Value  = Record->Symbols[Index].Value;
+    SymbolTable[Index].Name   = Kext->StringTable + Record->Symbols[Index].NameOffset;
+    SymbolTable[Index].Length = Record->Symbols[Index].Length;
+    SymbolTable[Index].Hash   = Record->Symbols[Index].Hash;
+  }
+
+  CopyMem (SymbolIndex, Record->SymbolIndex, Record->IndexSize * sizeof (*SymbolIndex));
+
+  for (Index = 0; Index < Header->NumberOfSymbols; ++Index) {
+    SymbolValues[Index].Value = SymbolTable[Record->SymbolValues[Index]].Value;
+    SymbolValues[Index].Index = Record->SymbolValues[Index];
+  }
+
+  Vtable       = (CONST PRELINKED_SYMBOL_CACHE_VTABLE *) Record->Vtables;
+  LinkedVtable = LinkedVtables;
+  for (Index = 0; Index < Header->NumberOfVtables; ++Index) {
+    LinkedVtable->Name       = Kext->StringTable + Vtable->NameOffset;
+    LinkedVtable->NumEntries = Vtable->NumEntries;
+
+    Entry = (CONST PRELINKED_SYMBOL_CACHE_VTABLE_ENTRY *) (Vtable + 1);
+    for (EntryIndex = 0; EntryIndex < Vtable->NumEntries; ++EntryIndex) {
+      LinkedVtable->Entries[EntryIndex].Address = Entry[EntryIndex].Address;
+      if (Entry[EntryIndex].Owner != MAX_UINT32) {
+        LinkedVtable->Entries[EntryIndex].Name = Records[Entry[EntryIndex].Owner].Kext->StringTable
+          + Entry[EntryIndex].NameOffset;
+      } else {
+        LinkedVtable->Entries[EntryIndex].Name = NULL;
+      }
+    }
+
+    Vtable       = (CONST PRELINKED_SYMBOL_CACHE_VTABLE *) &Entry[Vtable->NumEntries];
+    LinkedVtable = GET_NEXT_PRELINKED_VTABLE (LinkedVtable);
+  }
+
+  Kext->NumberOfSymbols       = Header->NumberOfSymbols;
+  Kext->NumberOfCxxSymbols    = Header->NumberOfCxxSymbols;
+  Kext->LinkedSymbolTable     = SymbolTable;
+  Kext->LinkedSymbolIndex     = SymbolIndex;
+  Kext->LinkedSymbolIndexMask = Record->IndexSize - 1;
+  Kext->LinkedSymbolValues    = SymbolValues;
+  Kext->NumberOfVtables       = Header->NumberOfVtables;
+  Kext->LinkedVtables         = LinkedVtables;
+
+  if (!InternalCreateVtableIndex (Context, Kext, Header->NumberOfVtables)) {
+    Kext->NumberOfVtables = 0;
+    Kext->LinkedVtables   = NULL;
+    return RETURN_OUT_OF_RESOURCES;
+  }
+
+  return RETURN_SUCCESS;
+}
+
+RETURN_STATUS
+PrelinkedImportSymbolCache (
+  IN OUT PRELINKED_CONTEXT  *Context,
+  IN     CONST VOID         *Buffer,
+  IN     UINT32             BufferSize
+  )
+{
+  RETURN_STATUS                        Status;
+  CONST PRELINKED_SYMBOL_CACHE_HEADER  *Header;
+  MACH_UUID_COMMAND                    *Uuid;
+  PRELINKED_SYMBOL_CACHE_RECORD        *Records;
+  UINT32                               Index;
+  UINT32                               Offset;
+
+  Header = Buffer;
+
+  if (!OC_POT_ALIGNED (sizeof (UINT64), Buffer)
+    || BufferSize < sizeof (*Header)
+    || Header->Signature != PRELINK_SYMBOL_CACHE_SIGNATURE
+    || Header->Size != BufferSize
+    || Header->NumberOfKexts == 0
+    || Header->NumberOfKexts > (BufferSize - sizeof (*Header)) / sizeof (PRELINKED_SYMBOL_CACHE_KEXT)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if (Header->Version != PRELINK_SYMBOL_CACHE_VERSION) {
+    return RETURN_INCOMPATIBLE_VERSION;
+  }
+
+  Uuid = MachoGetUuid64 (&Context->PrelinkedMachContext);
+  if (Uuid == NULL || CompareMem (Uuid->Uuid, Header->KernelUuid, sizeof (Header->KernelUuid)) != 0) {
+    DEBUG ((DEBUG_INFO, "OCK: Symbol cache kernel UUID mismatch\n"));
+    return RETURN_INCOMPATIBLE_VERSION;
+  }
+
+  Records = AllocatePool (Header->NumberOfKexts * sizeof (*Records));
+  if (Records == NULL) {
+    return RETURN_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Validate all records first, a stale cache is either used as a whole or not at all.
+  //
+  Offset = sizeof (*Header);
+  for (Index = 0; Index < Header->NumberOfKexts; ++Index) {
+    Status = InternalSymbolCacheParseKext (
+               Context,
+               (CONST UINT8 *) Buffer + Offset,
+               BufferSize - Offset,
+               &Records[Index]
+               );
+    if (RETURN_ERROR (Status)) {
+      FreePool (Records);
+      return Status;
+    }
+
+    Offset += Records[Index].Header->Size;
+  }
+
+  if (Offset != BufferSize) {
+    FreePool (Records);
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  for (Index = 0; Index < Header->NumberOfKexts; ++Index) {
+    if (!InternalSymbolCacheCheckVtables (Records, Header->NumberOfKexts, &Records[Index])) {
+      FreePool (Records);
+      return RETURN_INVALID_PARAMETER;
+    }
+  }
+
+  //
+  // Every loaded kext is consistent on its own, so it is fine to stop midway.
+  //
+  for (Index = 0; Index < Header->NumberOfKexts; ++Index) {
+    Status = InternalSymbolCacheLoadKext (Context, Records, &Records[Index]);
+    if (RETURN_ERROR (Status)) {
+      FreePool (Records);
+      return Status;
+    }
+  }
+
+  FreePool (Records);
+
+  return RETURN_SUCCESS;
+}
+
+RETURN_STATUS
+PrelinkedLoadSymbolCache (
+  IN OUT PRELINKED_CONTEXT   *Context,
+  IN     OC_STORAGE_CONTEXT  *Storage,
+  IN     CONST CHAR16        *FilePath
+  )
+{
+  RETURN_STATUS  Status;
+  VOID           *Buffer;
+  UINT32         BufferSize;
+
+  Buffer = OcStorageReadFileUnicode (Storage, FilePath, &BufferSize);
+  if (Buffer == NULL) {
+    return RETURN_NOT_FOUND;
+  }
+
+  Status = PrelinkedImportSymbolCache (Context, Buffer, BufferSize);
+  DEBUG ((DEBUG_INFO, "OCK: Symbol cache %s import - %r\n", FilePath, Status));
+
+  FreePool (Buffer);
+
+  return Status;
+}
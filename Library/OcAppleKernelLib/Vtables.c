@@ -23,46 +23,105 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Library/OcAppleKernelLib.h>
 #include <Library/OcGuardLib.h>
 #include <Library/OcMachoLib.h>
+#include <Library/OcStringLib.h>
 
 #include "PrelinkedInternal.h"
 
+BOOLEAN
+InternalCreateVtableIndex (
+  IN OUT PRELINKED_CONTEXT  *Context,
+  IN OUT PRELINKED_KEXT     *Kext,
+  IN     UINT32             MaxVtables
+  )
+{
+  CONST PRELINKED_VTABLE *Vtable;
+  UINT32                 IndexSize;
+  UINT32                 Index;
+
+  ASSERT (Kext->LinkedVtableIndex == NULL);
+  ASSERT (Kext->NumberOfVtables <= MaxVtables);
+
+  //
+  // GetPowerOfTwo32 rounds down, so the index has more than 2 * MaxVtables
+  // slots and load factor stays below 1/2. Vtable count is bounded by
+  // symbol count.
+  //
+  IndexSize = GetPowerOfTwo32 (MaxVtables | 1U) << 2U;
+
+  Kext->LinkedVtableIndex = OcArenaAllocateZero (&Context->Arena, IndexSize * sizeof (*Kext->LinkedVtableIndex));
+  if (Kext->LinkedVtableIndex == NULL) {
+    return FALSE;
+  }
+
+  Kext->LinkedVtableIndexMask = IndexSize - 1;
+
+  for (
+    Index = 0, Vtable = Kext->LinkedVtables;
+    Index < Kext->NumberOfVtables;
+    ++Index, Vtable = GET_NEXT_PRELINKED_VTABLE (Vtable)
+    ) {
+    InternalInsertVtableIndex (Kext, Vtable);
+  }
+
+  return TRUE;
+}
+
+VOID
+InternalInsertVtableIndex (
+  IN OUT PRELINKED_KEXT          *Kext,
+  IN     CONST PRELINKED_VTABLE  *Vtable
+  )
+{
+  UINT32  Slot;
+
+  Slot = AsciiStrHash (Vtable->Name, NULL) & Kext->LinkedVtableIndexMask;
+  while (Kext->LinkedVtableIndex[Slot] != NULL) {
+    if (AsciiStrCmp (Kext->LinkedVtableIndex[Slot]->Name, Vtable->Name) == 0) {
+      return;
+    }
+
+    Slot = (Slot + 1) & Kext->LinkedVtableIndexMask;
+  }
+
+  Kext->LinkedVtableIndex[Slot] = Vtable;
+}
+
+STATIC
 CONST PRELINKED_VTABLE *
 InternalGetOcVtableByNameWorker (
   IN PRELINKED_CONTEXT     *Context,
   IN PRELINKED_KEXT        *Kext,
-  IN CONST CHAR8           *Name
+  IN CONST CHAR8           *Name,
+  IN UINT32                NameHash
   )
 {
   CONST PRELINKED_VTABLE *Vtable;
 
   UINTN                  Index;
+  UINT32                 Slot;
   PRELINKED_KEXT         *Dependency;
-  INTN                   Result;
 
   Kext->Processed = TRUE;
 
-  for (
-    Index = 0, Vtable = Kext->LinkedVtables;
-    Index < Kext->NumberOfVtables;
-    ++Index, Vtable = GET_NEXT_PRELINKED_VTABLE (Vtable)
-    ) {
-    Result = AsciiStrCmp (Vtable->Name, Name);
-    if (Result == 0) {
-      return Vtable;
+  if (Kext->LinkedVtableIndex != NULL) {
+    Slot = NameHash & Kext->LinkedVtableIndexMask;
+    while ((Vtable = Kext->LinkedVtableIndex[Slot]) != NULL) {
+      if (AsciiStrCmp (Vtable->Name, Name) == 0) {
+        return Vtable;
+      }
+
+      Slot = (Slot + 1) & Kext->LinkedVtableIndexMask;
     }
   }
 
-  for (Index = 0; Index < ARRAY_SIZE (Kext->Dependencies); ++Index) {
+  for (Index = 0; Index < Kext->NumberOfDependencies; ++Index) {
     Dependency = Kext->Dependencies[Index];
-    if (Dependency == NULL) {
-      break;
-    }
 
     if (Dependency->Processed) {
       continue;
     }
 
-    Vtable = InternalGetOcVtableByName (Context, Dependency, Name);
+    Vtable = InternalGetOcVtableByNameWorker (Context, Dependency, Name, NameHash);
     if (Vtable != NULL) {
       return Vtable;
     }
@@ -80,7 +139,12 @@ InternalGetOcVtableByName (
 {
   CONST PRELINKED_VTABLE *Vtable;
 
-  Vtable = InternalGetOcVtableByNameWorker (Context, Kext, Name);
+  Vtable = InternalGetOcVtableByNameWorker (
+             Context,
+             Kext,
+             Name,
+             AsciiStrHash (Name, NULL)
+             );
 
   InternalUnlockContextKexts (Context);
 
@@ -656,7 +720,8 @@ InternalPatchByVtables64 (
   //
   // One structure contains two VTables, hence (NumTables * 2).
   //
-  Kext->LinkedVtables = AllocatePool (
+  Kext->LinkedVtables = OcArenaAllocate (
+                          &Context->Arena,
                           ((NumTables * 2) * sizeof (*Kext->LinkedVtables))
                             + (NumEntries * sizeof (*Kext->LinkedVtables->Entries))
                           );
@@ -664,6 +729,10 @@ InternalPatchByVtables64 (
     return FALSE;
   }
 
+  if (!InternalCreateVtableIndex (Context, Kext, NumTables * 2)) {
+    return FALSE;
+  }
+
   CurrentVtable = Kext->LinkedVtables;
   //
   // Patch via the previously retrieved SMCPs.
@@ -807,6 +876,7 @@ InternalPatchByVtables64 (
         return FALSE;
       }
 
+      InternalInsertVtableIndex (Kext, CurrentVtable);
       CurrentVtable = GET_NEXT_PRELINKED_VTABLE (CurrentVtable);
       //
       // Get the meta vtable name from the class name
@@ -861,6 +931,7 @@ InternalPatchByVtables64 (
         return FALSE;
       }
 
+      InternalInsertVtableIndex (Kext, CurrentVtable);
       CurrentVtable = GET_NEXT_PRELINKED_VTABLE (CurrentVtable);
 
       Kext->NumberOfVtables += 2;
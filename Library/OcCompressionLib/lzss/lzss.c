@@ -138,6 +138,104 @@ u_int32_t decompress_lzss(
     return (u_int32_t)(dst - dststart);
 }
 
+/*******************************************************************************
+*******************************************************************************/
+u_int32_t decompress_lzss_stream(
+    u_int8_t                  * dst,
+    u_int32_t                   dstlen,
+    u_int32_t                   srclen,
+    OC_DECOMPRESS_STREAM_READ   read,
+    void                      * context,
+    u_int32_t                 * adler)
+{
+    /* ring buffer of size N, with extra F-1 bytes to aid string comparison */
+    u_int8_t text_buf[N + F - 1];
+    u_int8_t * dststart = dst;
+    u_int8_t * dstsum = dst;
+    const u_int8_t * dstend = dst + dstlen;
+    u_int8_t * chunk;
+    u_int8_t * src;
+    u_int8_t * srcend;
+    u_int32_t  srcleft, avail, size, sum;
+    int  i, j, k, r;
+    u_int8_t c;
+    unsigned int flags;
+
+    if (dstlen > OC_COMPRESSION_MAX_LENGTH || srclen > OC_COMPRESSION_MAX_LENGTH) {
+        return 0;
+    }
+
+    chunk = malloc(OC_DECOMPRESS_STREAM_CHUNK_SIZE);
+    if (!chunk)
+        return 0;
+
+    src = srcend = chunk;
+    srcleft = srclen;
+    sum = 1;
+
+    for (i = 0; i < N - F; i++)
+        text_buf[i] = ' ';
+    r = N - F;
+    flags = 0;
+    for ( ; ; ) {
+        if (((flags >>= 1) & 0x100) == 0) {
+            /*
+             * Refill at group boundary, a group of eight units with
+             * the flags byte takes at most 17 bytes.
+             */
+            if (srcend - src < 17 && srcleft > 0) {
+                avail = (u_int32_t)(srcend - src);
+                CopyMem(chunk, src, avail);
+                size = OC_DECOMPRESS_STREAM_CHUNK_SIZE - avail;
+                if (size > srcleft)
+                    size = srcleft;
+                if (!read(context, chunk + avail, size)) {
+                    dst = dststart;
+                    break;
+                }
+                srcleft -= size;
+                src = chunk;
+                srcend = chunk + avail + size;
+
+                /* checksum the output while it is still hot in cache */
+                if (adler) {
+                    sum = adler32_z(sum, dstsum, dst - dstsum);
+                    dstsum = dst;
+                }
+            }
+            if (src < srcend) c = *src++; else break;
+            flags = c | 0xFF00;  /* uses higher byte cleverly */
+        }   /* to count eight */
+        if (flags & 1) {
+            if (src < srcend) c = *src++; else break;
+            if (dst < dstend) *dst++ = c; else break;
+            text_buf[r++] = c;
+            r &= (N - 1);
+        } else {
+            if (src < srcend) i = *src++; else break;
+            if (src < srcend) j = *src++; else break;
+            i |= ((j & 0xF0) << 4);
+            j  =  (j & 0x0F) + THRESHOLD;
+            for (k = 0; k <= j; k++) {
+                c = text_buf[(i + k) & (N - 1)];
+                if (dst < dstend) *dst++ = c; else break;
+                text_buf[r++] = c;
+                r &= (N - 1);
+            }
+        }
+    }
+
+    free(chunk);
+
+    if (adler) {
+        if (dst > dstsum)
+            sum = adler32_z(sum, dstsum, dst - dstsum);
+        *adler = sum;
+    }
+
+    return (u_int32_t)(dst - dststart);
+}
+
 /*
  * initialize state, mostly the trees
  *
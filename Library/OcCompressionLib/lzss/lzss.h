@@ -19,6 +19,8 @@
 #include <Library/MemoryAllocationLib.h>
 #include <Library/OcCompressionLib.h>
 
+#include "../zlib/zlib.h"
+
 typedef UINT8  u_int8_t;
 typedef UINT16 u_int16_t;
 typedef UINT32 u_int32_t;
@@ -29,6 +31,7 @@ typedef INT32 int32_t;
 
 #define compress_lzss CompressLZSS
 #define decompress_lzss DecompressLZSS
+#define decompress_lzss_stream DecompressStreamLZSS
 
 #ifdef bzero
 #undef bzero
@@ -843,3 +843,83 @@ size_t lzvn_decode_buffer(unsigned char *dst, size_t dst_size,
   // This is how much we decompressed
   return dstate.dst - dst;
 }
+
+uint32_t lzvn_decode_stream(unsigned char *dst, uint32_t dst_size,
+                            uint32_t src_size, OC_DECOMPRESS_STREAM_READ read,
+                            void *context, uint32_t *adler) {
+  // Init LZVN decoder state
+  lzvn_decoder_state dstate;
+  unsigned char *chunk;
+  unsigned char *dst_sum;
+  uint32_t src_left;
+  uint32_t avail;
+  uint32_t size;
+  uint32_t sum;
+
+  if (dst_size > OC_COMPRESSION_MAX_LENGTH || src_size > OC_COMPRESSION_MAX_LENGTH) {
+    return 0;
+  }
+
+  chunk = AllocatePool(OC_DECOMPRESS_STREAM_CHUNK_SIZE);
+  if (chunk == NULL) {
+    return 0;
+  }
+
+  memset(&dstate, 0x00, sizeof(dstate));
+  dstate.dst_begin = dst;
+  dstate.dst = dst;
+  dstate.dst_end = dst + dst_size;
+
+  dst_sum = dst;
+  src_left = src_size;
+  avail = 0;
+  sum = 1;
+
+  while (1) {
+    //  The decoder stops before an instruction truncated by the chunk end,
+    //  move the remainder to the chunk start and append the next data.
+    size = OC_DECOMPRESS_STREAM_CHUNK_SIZE - avail;
+    if (size > src_left)
+      size = src_left;
+    if (size > 0) {
+      if (!read(context, chunk + avail, size)) {
+        dstate.dst = dst;
+        break;
+      }
+      src_left -= size;
+      avail += size;
+    }
+
+    dstate.src = chunk;
+    dstate.src_end = chunk + avail;
+
+    // Run LZVN decoder
+    lzvn_decode(&dstate);
+
+    // Checksum the output while it is still hot in cache
+    if (adler != NULL) {
+      sum = adler32_z(sum, dst_sum, dstate.dst - dst_sum);
+      dst_sum = dstate.dst;
+    }
+
+    if (dstate.end_of_stream || dstate.dst == dstate.dst_end)
+      break;
+
+    size = (uint32_t)(dstate.src - chunk);
+    //  No progress is possible without more data.
+    if (size == 0 && (src_left == 0 || avail == OC_DECOMPRESS_STREAM_CHUNK_SIZE))
+      break;
+
+    avail -= size;
+    memmove(chunk, dstate.src, avail);
+  }
+
+  FreePool(chunk);
+
+  if (adler != NULL) {
+    *adler = sum;
+  }
+
+  // This is how much we decompressed
+  return (uint32_t)(dstate.dst - dst);
+}
@@ -13,6 +13,9 @@
 **/
 
 #include <Library/OcConfigurationLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcCryptoLib.h>
 
 OC_STRUCTORS       (OC_ACPI_ADD_ENTRY, ())
 OC_ARRAY_STRUCTORS (OC_ACPI_ADD_ARRAY)
@@ -58,7 +61,30 @@ OC_STRUCTORS       (OC_UEFI_PROTOCOLS, ())
 OC_STRUCTORS       (OC_UEFI_QUIRKS, ())
 OC_STRUCTORS       (OC_UEFI_CONFIG, ())
 
-OC_STRUCTORS       (OC_GLOBAL_CONFIG, ())
+//
+// Configuration loaded from cache references cache memory instead of
+// owning its fields, so drop them all before the field destructors run.
+//
+STATIC
+VOID
+OcConfigurationFreeCache (
+  VOID    *Pointer,
+  UINT32  Size
+  )
+{
+  OC_GLOBAL_CONFIG  *Config;
+  VOID              *Cache;
+
+  Config = (OC_GLOBAL_CONFIG *) Pointer;
+  Cache  = Config->Cache;
+
+  if (Cache != NULL) {
+    ZeroMem (Config, Size);
+    FreePool (Cache);
+  }
+}
+
+OC_STRUCTORS       (OC_GLOBAL_CONFIG, OcConfigurationFreeCache)
 
 //
 // ACPI configuration support
@@ -453,6 +479,13 @@ mRootConfigurationInfo = {
   .Dict = {mRootConfigurationNodes, ARRAY_SIZE (mRootConfigurationNodes)}
 };
 
+//
+// Perfect hashes of mRootConfigurationInfo, created on first use.
+//
+STATIC
+OC_SCHEMA_HASHES *
+mRootConfigurationHashes;
+
 EFI_STATUS
 OcConfigurationInit (
   OUT OC_GLOBAL_CONFIG   *Config,
@@ -462,8 +495,21 @@ OcConfigurationInit (
 {
   BOOLEAN  Success;
 
+  //
+  // Key lookup falls back to binary search if hashes cannot be allocated.
+  //
+  if (mRootConfigurationHashes == NULL) {
+    mRootConfigurationHashes = CreateConfigSchemaHashes (&mRootConfigurationInfo);
+  }
+
   OC_GLOBAL_CONFIG_CONSTRUCT (Config, sizeof (*Config));
-  Success = ParseSerialized (Config, &mRootConfigurationInfo, Buffer, Size);
+  Success = ParseSerializedWithHashes (
+    Config,
+    &mRootConfigurationInfo,
+    mRootConfigurationHashes,
+    Buffer,
+    Size
+    );
 
   if (!Success) {
     OC_GLOBAL_CONFIG_DESTRUCT (Config, sizeof (*Config));
@@ -473,6 +519,86 @@ OcConfigurationInit (
   return EFI_SUCCESS;
 }
 
+EFI_STATUS
+OcConfigurationInitWithCache (
+  OUT OC_GLOBAL_CONFIG   *Config,
+  IN  VOID               *Buffer,
+  IN  UINT32             Size,
+  IN  CONST UINT8        *Digest  OPTIONAL,
+  IN  VOID               *Cache   OPTIONAL,
+  IN  UINT32             CacheSize
+  )
+{
+  UINT8    BufferDigest[SHA256_DIGEST_SIZE];
+  BOOLEAN  Success;
+
+  if (Cache != NULL) {
+    if (Digest == NULL) {
+      Sha256 (BufferDigest, Buffer, Size);
+      Digest = BufferDigest;
+    }
+
+    OC_GLOBAL_CONFIG_CONSTRUCT (Config, sizeof (*Config));
+    Success = MapSerializedImage (
+      Config,
+      sizeof (*Config),
+      &mRootConfigurationInfo,
+      Digest,
+      Cache,
+      CacheSize
+      );
+
+    if (Success) {
+      Config->Cache = Cache;
+      return EFI_SUCCESS;
+    }
+
+    DEBUG ((DEBUG_INFO, "OCS: Configuration cache is unusable, parsing plist\n"));
+    FreePool (Cache);
+  }
+
+  return OcConfigurationInit (Config, Buffer, Size);
+}
+
+EFI_STATUS
+OcConfigurationExportCache (
+  IN  VOID               *Buffer,
+  IN  UINT32             Size,
+  OUT VOID               **Cache,
+  OUT UINT32             *CacheSize
+  )
+{
+  EFI_STATUS        Status;
+  OC_GLOBAL_CONFIG  Config;
+  UINT8             Digest[SHA256_DIGEST_SIZE];
+
+  //
+  // Parsing modifies the buffer, so hash it first.
+  //
+  Sha256 (Digest, Buffer, Size);
+
+  Status = OcConfigurationInit (&Config, Buffer, Size);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *Cache = CompileSerializedImage (
+    &Config,
+    sizeof (Config),
+    &mRootConfigurationInfo,
+    Digest,
+    CacheSize
+    );
+
+  OcConfigurationFree (&Config);
+
+  if (*Cache == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  return EFI_SUCCESS;
+}
+
 /**
   Free configuration structure.
 
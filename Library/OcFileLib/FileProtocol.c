@@ -52,6 +52,106 @@ GetFileData (
   return EFI_SUCCESS;
 }
 
+EFI_STATUS
+GetFileDataAsync (
+  IN  EFI_FILE_PROTOCOL  *File,
+  IN  UINT32             Position,
+  IN  UINT32             Size,
+  OUT UINT8              *Buffer,
+  OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  EFI_STATUS  Status;
+  EFI_TPL     OldTpl;
+
+  Token->Event      = NULL;
+  Token->Status     = EFI_SUCCESS;
+  Token->BufferSize = Size;
+  Token->Buffer     = Buffer;
+
+  Status = File->SetPosition (File, Position);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Completion is waited for with WaitForEvent, which is only allowed
+  // at TPL_APPLICATION. Raising to TPL_HIGH_LEVEL returns the current TPL.
+  //
+  OldTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+  gBS->RestoreTPL (OldTpl);
+
+  if (File->Revision >= EFI_FILE_PROTOCOL_REVISION2 && OldTpl == TPL_APPLICATION) {
+    Status = gBS->CreateEvent (0, 0, NULL, NULL, &Token->Event);
+    if (!EFI_ERROR (Status)) {
+      Status = File->ReadEx (File, Token);
+      if (!EFI_ERROR (Status)) {
+        return EFI_SUCCESS;
+      }
+
+      gBS->CloseEvent (Token->Event);
+      Token->Event      = NULL;
+      Token->BufferSize = Size;
+
+      //
+      // Token reads may be unsupported by the file system driver,
+      // restore the position and read synchronously.
+      //
+      Status = File->SetPosition (File, Position);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+  }
+
+  //
+  // Fallback to synchronous read, the result is reported on completion.
+  //
+  Token->Status = File->Read (File, &Token->BufferSize, Buffer);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+GetFileDataComplete (
+  IN     EFI_FILE_PROTOCOL  *File,
+  IN OUT EFI_FILE_IO_TOKEN  *Token,
+  IN     UINT32             Size
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index;
+
+  (VOID) File;
+
+  if (Token->Event != NULL) {
+    Status = gBS->WaitForEvent (1, &Token->Event, &Index);
+    if (Status == EFI_UNSUPPORTED) {
+      //
+      // TPL was raised after the read was started, poll the event instead.
+      //
+      do {
+        gBS->Stall (10);
+        Status = gBS->CheckEvent (Token->Event);
+      } while (Status == EFI_NOT_READY);
+    }
+    gBS->CloseEvent (Token->Event);
+    Token->Event = NULL;
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  if (EFI_ERROR (Token->Status)) {
+    return Token->Status;
+  }
+
+  if (Token->BufferSize != Size) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  return EFI_SUCCESS;
+}
+
 EFI_STATUS
 GetFileSize (
   IN  EFI_FILE_PROTOCOL  *File,
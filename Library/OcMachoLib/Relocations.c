@@ -16,7 +16,9 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 #include <IndustryStandard/AppleMachoImage.h>
 
+#include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
 #include <Library/OcMachoLib.h>
 
 #include "OcMachoLibInternal.h"
@@ -65,6 +67,25 @@ MachoPreserveRelocationIntel64 (
   return (Type == MachX8664RelocUnsigned);
 }
 
+/**
+  Returns whether the Relocation can be found by the address it targets.
+
+  @param[in] Relocation  The Relocation to check.
+
+**/
+STATIC
+BOOLEAN
+InternalRelocationIsAddressable (
+  IN CONST MACH_RELOCATION_INFO  *Relocation
+  )
+{
+  //
+  // A section-based relocation entry can be skipped for absolute symbols.
+  //
+  return (Relocation->Extern != 0)
+      || (Relocation->SymbolNumber != MACH_RELOC_ABSOLUTE);
+}
+
 /**
   Retrieves an extern Relocation by the address it targets.
 
@@ -86,11 +107,7 @@ InternalLookupRelocationByOffset (
 
   for (Index = 0; Index < NumRelocs; ++Index) {
     Relocation = &Relocs[Index];
-    //
-    // A section-based relocation entry can be skipped for absolute symbols.
-    //
-    if ((Relocation->Extern == 0)
-     && (Relocation->SymbolNumber == MACH_RELOC_ABSOLUTE)) {
+    if (!InternalRelocationIsAddressable (Relocation)) {
       continue;
     }
 
@@ -113,6 +130,237 @@ InternalLookupRelocationByOffset (
   return NULL;
 }
 
+/**
+  Returns whether the first relocation index entry preceeds the second.
+  Entries are ordered by address and then by index to preserve the
+  first match semantics of the linear lookup.
+
+**/
+STATIC
+BOOLEAN
+InternalRelocationIndexLess (
+  IN CONST MACH_RELOCATION_INFO  *Relocs,
+  IN UINT32                      First,
+  IN UINT32                      Second
+  )
+{
+  if (Relocs[First].Address != Relocs[Second].Address) {
+    return (UINT64)Relocs[First].Address < (UINT64)Relocs[Second].Address;
+  }
+
+  return First < Second;
+}
+
+/**
+  Restores max-heap property of the relocation index subtree at Root.
+
+**/
+STATIC
+VOID
+InternalRelocationIndexSiftDown (
+  IN     CONST MACH_RELOCATION_INFO  *Relocs,
+  IN OUT UINT32                      *Entries,
+  IN     UINT32                      Root,
+  IN     UINT32                      Count
+  )
+{
+  UINT32  Child;
+  UINT32  Temp;
+
+  while ((Child = Root * 2 + 1) < Count) {
+    if (Child + 1 < Count
+      && InternalRelocationIndexLess (Relocs, Entries[Child], Entries[Child + 1])) {
+      ++Child;
+    }
+
+    if (!InternalRelocationIndexLess (Relocs, Entries[Root], Entries[Child])) {
+      break;
+    }
+
+    Temp           = Entries[Root];
+    Entries[Root]  = Entries[Child];
+    Entries[Child] = Temp;
+    Root           = Child;
+  }
+}
+
+/**
+  Builds relocation index sorted by address.  Only relocations visible to
+  the linear lookup are indexed, i.e. Pair entries are omitted.
+
+  @param[out] RelocIndex  Index to build.
+  @param[in]  NumRelocs   Number of relocations.
+  @param[in]  Relocs      Relocations.
+
+  @returns  Whether the index has been built successfully.
+
+**/
+STATIC
+BOOLEAN
+InternalBuildRelocationIndex (
+  OUT OC_MACHO_RELOCATION_INDEX   *RelocIndex,
+  IN  UINT32                      NumRelocs,
+  IN  CONST MACH_RELOCATION_INFO  *Relocs
+  )
+{
+  UINT32  *Entries;
+  UINT32  NumEntries;
+  UINT32  Index;
+  UINT32  Temp;
+
+  Entries = AllocatePool (NumRelocs * sizeof (*Entries));
+  if (Entries == NULL) {
+    return FALSE;
+  }
+
+  NumEntries = 0;
+
+  for (Index = 0; Index < NumRelocs; ++Index) {
+    if (!InternalRelocationIsAddressable (&Relocs[Index])) {
+      continue;
+    }
+
+    Entries[NumEntries++] = Index;
+
+    if (MachoRelocationIsPairIntel64 ((UINT8)Relocs[Index].Type)) {
+      if (Index == (MAX_UINT32 - 1)) {
+        break;
+      }
+      ++Index;
+    }
+  }
+
+  for (Index = NumEntries / 2; Index > 0; --Index) {
+    InternalRelocationIndexSiftDown (Relocs, Entries, Index - 1, NumEntries);
+  }
+
+  for (Index = NumEntries; Index > 1; --Index) {
+    Temp               = Entries[0];
+    Entries[0]         = Entries[Index - 1];
+    Entries[Index - 1] = Temp;
+    InternalRelocationIndexSiftDown (Relocs, Entries, 0, Index - 1);
+  }
+
+  RelocIndex->Relocations    = Entries;
+  RelocIndex->NumRelocations = NumEntries;
+
+  return TRUE;
+}
+
+/**
+  Retrieves a Relocation by the address it targets using the index.
+
+  @param[in] Address     The address to search for.
+  @param[in] RelocIndex  Relocation index.
+  @param[in] Relocs      Relocations.
+
+  @retval NULL  NULL is returned on failure.
+
+**/
+STATIC
+MACH_RELOCATION_INFO *
+InternalLookupRelocationByIndex (
+  IN UINT64                           Address,
+  IN CONST OC_MACHO_RELOCATION_INDEX  *RelocIndex,
+  IN MACH_RELOCATION_INFO             *Relocs
+  )
+{
+  CONST UINT32  *Entries;
+  UINT32        NumEntries;
+  UINT32        Half;
+
+  Entries    = RelocIndex->Relocations;
+  NumEntries = RelocIndex->NumRelocations;
+
+  if (NumEntries == 0) {
+    return NULL;
+  }
+
+  while (NumEntries > 1) {
+    Half        = NumEntries / 2;
+    Entries     = ((UINT64)Relocs[Entries[Half]].Address <= Address) ? &Entries[Half] : Entries;
+    NumEntries -= Half;
+  }
+
+  //
+  // Entries points to the last relocation not above Address, go back to
+  // the first one with the same address to preserve first match semantics.
+  //
+  if ((UINT64)Relocs[*Entries].Address != Address) {
+    return NULL;
+  }
+
+  while (Entries > RelocIndex->Relocations
+    && (UINT64)Relocs[Entries[-1]].Address == Address) {
+    --Entries;
+  }
+
+  return &Relocs[*Entries];
+}
+
+/**
+  Retrieves a Relocation by the address it targets via the index, when
+  enabled, and via linear lookup otherwise.
+
+  @param[in,out] Context     Context of the Mach-O.
+  @param[in]     Address     The address to search for.
+  @param[in]     NumRelocs   Number of relocations.
+  @param[in]     Relocs      Relocations.
+  @param[in,out] RelocIndex  Relocation index to use.
+
+  @retval NULL  NULL is returned on failure.
+
+**/
+STATIC
+MACH_RELOCATION_INFO *
+InternalGetRelocationByOffset (
+  IN OUT OC_MACHO_CONTEXT           *Context,
+  IN     UINT64                     Address,
+  IN     UINT32                     NumRelocs,
+  IN     MACH_RELOCATION_INFO       *Relocs,
+  IN OUT OC_MACHO_RELOCATION_INDEX  *RelocIndex
+  )
+{
+  if (Context->UseRelocationIndex && NumRelocs > 0) {
+    if (RelocIndex->Relocations != NULL
+      || InternalBuildRelocationIndex (RelocIndex, NumRelocs, Relocs)) {
+      return InternalLookupRelocationByIndex (Address, RelocIndex, Relocs);
+    }
+  }
+
+  return InternalLookupRelocationByOffset (Address, NumRelocs, Relocs);
+}
+
+VOID
+MachoEnableRelocationIndex (
+  IN OUT OC_MACHO_CONTEXT  *Context
+  )
+{
+  ASSERT (Context != NULL);
+
+  Context->UseRelocationIndex = TRUE;
+}
+
+VOID
+MachoDisableRelocationIndex (
+  IN OUT OC_MACHO_CONTEXT  *Context
+  )
+{
+  ASSERT (Context != NULL);
+
+  if (Context->LocalRelocationIndex.Relocations != NULL) {
+    FreePool (Context->LocalRelocationIndex.Relocations);
+  }
+
+  if (Context->ExternRelocationIndex.Relocations != NULL) {
+    FreePool (Context->ExternRelocationIndex.Relocations);
+  }
+
+  ZeroMem (&Context->LocalRelocationIndex, sizeof (Context->LocalRelocationIndex));
+  ZeroMem (&Context->ExternRelocationIndex, sizeof (Context->ExternRelocationIndex));
+  Context->UseRelocationIndex = FALSE;
+}
+
 /**
   Retrieves an extern Relocation by the address it targets.
 
@@ -128,10 +376,12 @@ InternalGetExternRelocationByOffset (
   IN     UINT64            Address
   )
 {
-  return InternalLookupRelocationByOffset (
+  return InternalGetRelocationByOffset (
+           Context,
            Address,
            Context->DySymtab->NumExternalRelocations,
-           Context->ExternRelocations
+           Context->ExternRelocations,
+           &Context->ExternRelocationIndex
            );
 }
 
@@ -150,9 +400,11 @@ InternalGetLocalRelocationByOffset (
   IN     UINT64            Address
   )
 {
-  return InternalLookupRelocationByOffset (
+  return InternalGetRelocationByOffset (
+           Context,
            Address,
            Context->DySymtab->NumOfLocalRelocations,
-           Context->LocalRelocations
+           Context->LocalRelocations,
+           &Context->LocalRelocationIndex
            );
 }
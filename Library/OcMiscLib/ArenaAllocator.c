@@ -0,0 +1,152 @@
+/** @file
+  Copyright (C) 2019, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcMiscLib.h>
+
+struct OC_ARENA_CHUNK_ {
+  //
+  // Next chunk in arena.
+  //
+  OC_ARENA_CHUNK  *Next;
+  //
+  // Usable chunk size.
+  //
+  UINTN           Size;
+  //
+  // Used chunk size.
+  //
+  UINTN           Used;
+  //
+  // Padding to keep chunk data aligned.
+  //
+  UINTN           Reserved;
+};
+
+VOID
+OcArenaInit (
+  OUT OC_ARENA  *Arena,
+  IN  UINTN     ChunkSize
+  )
+{
+  if (ChunkSize == 0) {
+    ChunkSize = OC_ARENA_DEFAULT_CHUNK_SIZE;
+  }
+
+  Arena->Chunks    = NULL;
+  Arena->ChunkSize = ALIGN_VALUE (ChunkSize, EFI_PAGE_SIZE);
+
+  ZeroMem (&Arena->Stats, sizeof (Arena->Stats));
+}
+
+VOID *
+OcArenaAllocate (
+  IN OUT OC_ARENA  *Arena,
+  IN     UINTN     Size
+  )
+{
+  OC_ARENA_CHUNK  *Chunk;
+  UINTN           ChunkSize;
+  UINT8           *Memory;
+
+  ASSERT (Arena->ChunkSize > 0);
+
+  if (Size > MAX_UINTN - EFI_PAGE_SIZE - sizeof (*Chunk)) {
+    return NULL;
+  }
+
+  Size  = ALIGN_VALUE (Size, OC_ARENA_ALIGNMENT);
+  Chunk = Arena->Chunks;
+
+  if (Chunk == NULL || Chunk->Size - Chunk->Used < Size) {
+    //
+    // Requests bigger than a quarter of a chunk get a dedicated chunk,
+    // which is put after the current one to keep its free space usable.
+    //
+    if (Size > Arena->ChunkSize / 4) {
+      ChunkSize = ALIGN_VALUE (Size + sizeof (*Chunk), EFI_PAGE_SIZE);
+    } else {
+      ChunkSize = Arena->ChunkSize;
+    }
+
+    Chunk = AllocatePool (ChunkSize);
+    if (Chunk == NULL) {
+      return NULL;
+    }
+
+    Chunk->Size = ChunkSize - sizeof (*Chunk);
+    Chunk->Used = 0;
+
+    ++Arena->Stats.NumChunks;
+    Arena->Stats.ReservedSize     += ChunkSize;
+    Arena->Stats.PeakReservedSize  = MAX (Arena->Stats.PeakReservedSize, Arena->Stats.ReservedSize);
+
+    if (Arena->Chunks != NULL && Size > Arena->ChunkSize / 4) {
+      Chunk->Next         = Arena->Chunks->Next;
+      Arena->Chunks->Next = Chunk;
+    } else {
+      Chunk->Next   = Arena->Chunks;
+      Arena->Chunks = Chunk;
+    }
+  }
+
+  Memory       = (UINT8 *) (Chunk + 1) + Chunk->Used;
+  Chunk->Used += Size;
+
+  ++Arena->Stats.NumAllocations;
+  Arena->Stats.UsedSize += Size;
+
+  return Memory;
+}
+
+VOID *
+OcArenaAllocateZero (
+  IN OUT OC_ARENA  *Arena,
+  IN     UINTN     Size
+  )
+{
+  VOID  *Memory;
+
+  Memory = OcArenaAllocate (Arena, Size);
+  if (Memory != NULL) {
+    ZeroMem (Memory, Size);
+  }
+
+  return Memory;
+}
+
+VOID
+OcArenaFree (
+  IN OUT OC_ARENA  *Arena
+  )
+{
+  OC_ARENA_CHUNK  *Chunk;
+  OC_ARENA_CHUNK  *NextChunk;
+
+  Chunk = Arena->Chunks;
+  while (Chunk != NULL) {
+    NextChunk = Chunk->Next;
+    FreePool (Chunk);
+    Chunk = NextChunk;
+  }
+
+  Arena->Chunks                = NULL;
+  Arena->Stats.NumAllocations  = 0;
+  Arena->Stats.NumChunks       = 0;
+  Arena->Stats.UsedSize        = 0;
+  Arena->Stats.ReservedSize    = 0;
+}
@@ -15,20 +15,193 @@
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
 #include <Library/OcMiscLib.h>
 
+//
+// Per patch state of ApplyPatches.
+//
+typedef struct {
+  //
+  // Next patch index plus one sharing the same dispatch list, 0 terminates.
+  //
+  UINT32   Next;
+  //
+  // Offset of the pattern byte used for dispatch.
+  //
+  UINT32   Anchor;
+  //
+  // Minimal data offset the next match may start at.
+  //
+  UINT32   NextOffset;
+  //
+  // End of the data window.
+  //
+  UINT32   End;
+  //
+  // Remaining skip and replace counts.
+  //
+  UINT32   Skip;
+  UINT32   Count;
+  BOOLEAN  Done;
+} DATA_PATCH_STATE;
+
+//
+// Replacement found by ApplyPatches.
+//
+typedef struct {
+  UINT32  Start;
+  UINT32  Patch;
+} DATA_PATCH_WRITE;
+
+//
+// Replacements found by ApplyPatches, written once they are known
+// not to affect the matches of other patches.
+//
+typedef struct {
+  DATA_PATCH_WRITE  *Writes;
+  UINT32            NumWrites;
+  UINT32            MaxWrites;
+  BOOLEAN           Failed;
+} DATA_PATCH_WRITES;
+
+/**
+  Choose the pattern byte used to look up pattern candidates.
+  Only exactly matching bytes may be used. Bytes frequent in
+  executable code are avoided to reduce false candidates.
+
+  @param[in] Pattern      Pattern.
+  @param[in] PatternMask  Pattern mask, optional.
+  @param[in] PatternSize  Pattern size.
+
+  @return  Anchor offset or MAX_UINT32 when no byte matches exactly.
+**/
+STATIC
+UINT32
+InternalPatternAnchor (
+  IN CONST UINT8   *Pattern,
+  IN CONST UINT8   *PatternMask OPTIONAL,
+  IN UINT32        PatternSize
+  )
+{
+  UINT32  Index;
+  UINT32  Anchor;
+  UINT32  Penalty;
+  UINT32  MinPenalty;
+
+  Anchor     = MAX_UINT32;
+  MinPenalty = MAX_UINT32;
+
+  for (Index = 0; Index < PatternSize; ++Index) {
+    if (PatternMask != NULL && PatternMask[Index] != 0xFF) {
+      continue;
+    }
+
+    switch (Pattern[Index]) {
+      case 0x00:
+      case 0xFF:
+        Penalty = 2;
+        break;
+      case 0x0F:
+      case 0x48:
+      case 0x89:
+      case 0x8B:
+      case 0x90:
+      case 0xCC:
+      case 0xE8:
+        Penalty = 1;
+        break;
+      default:
+        Penalty = 0;
+        break;
+    }
+
+    if (Penalty < MinPenalty) {
+      Anchor     = Index;
+      MinPenalty = Penalty;
+      if (Penalty == 0) {
+        break;
+      }
+    }
+  }
+
+  return Anchor;
+}
+
+/**
+  Find the first occurrence of a byte in the data range.
+  Data is scanned one machine word at a time.
+
+  @param[in] Data   Data to look in.
+  @param[in] Start  Start offset.
+  @param[in] End    End offset (exclusive).
+  @param[in] Byte   Byte to find.
+
+  @return  Byte offset or End when the byte was not found.
+**/
+STATIC
+UINT32
+InternalFindByte (
+  IN CONST UINT8   *Data,
+  IN UINT32        Start,
+  IN UINT32        End,
+  IN UINT8         Byte
+  )
+{
+  UINT64  Word;
+  UINT64  Pattern;
+
+  //
+  // Reach the word boundary.
+  //
+  while (Start < End && ((UINTN) &Data[Start] & (sizeof (UINT64) - 1)) != 0) {
+    if (Data[Start] == Byte) {
+      return Start;
+    }
+    ++Start;
+  }
+
+  //
+  // A word contains the byte when XORing it with the byte replicated
+  // to every lane yields a zero lane.
+  //
+  Pattern = 0x0101010101010101ULL * Byte;
+  while (End - Start >= sizeof (UINT64)) {
+    Word = *(CONST UINT64 *) &Data[Start] ^ Pattern;
+    if (((Word - 0x0101010101010101ULL) & ~Word & 0x8080808080808080ULL) != 0) {
+      break;
+    }
+    Start += sizeof (UINT64);
+  }
+
+  while (Start < End) {
+    if (Data[Start] == Byte) {
+      return Start;
+    }
+    ++Start;
+  }
+
+  return End;
+}
+
+/**
+  FindPattern implementation with precomputed anchor.
+**/
+STATIC
 INT32
-FindPattern (
+InternalFindPattern (
   IN CONST UINT8   *Pattern,
   IN CONST UINT8   *PatternMask OPTIONAL,
   IN CONST UINT32  PatternSize,
+  IN CONST UINT32  Anchor,
   IN CONST UINT8   *Data,
   IN UINT32        DataSize,
   IN INT32         DataOff
   )
 {
-  BOOLEAN  Matches;
-  UINT32   Index;
+  UINT32  Offset;
+  UINT32  Last;
+  UINT32  Index;
 
   ASSERT (DataOff >= 0);
 
@@ -36,25 +209,81 @@ FindPattern (
     return -1;
   }
 
-  while (DataOff + PatternSize < DataSize) {
-    Matches = TRUE;
-    for (Index = 0; Index < PatternSize; ++Index) {
-      if ((PatternMask == NULL && Data[DataOff + Index] != Pattern[Index])
-      || (PatternMask != NULL && (Data[DataOff + Index] & PatternMask[Index]) != Pattern[Index])) {
-        Matches = FALSE;
-        break;
+  //
+  // Matches must end before the last byte of data.
+  //
+  Last   = DataSize - PatternSize;
+  Offset = (UINT32) DataOff;
+
+  if (Anchor == MAX_UINT32) {
+    //
+    // No exactly matching bytes, check every offset.
+    //
+    ASSERT (PatternMask != NULL);
+    for (; Offset < Last; ++Offset) {
+      for (Index = 0; Index < PatternSize; ++Index) {
+        if ((Data[Offset + Index] & PatternMask[Index]) != Pattern[Index]) {
+          break;
+        }
       }
+
+      if (Index == PatternSize) {
+        return (INT32) Offset;
+      }
+    }
+
+    return -1;
+  }
+
+  while (Offset < Last) {
+    Offset = InternalFindByte (Data, Offset + Anchor, Last + Anchor, Pattern[Anchor]) - Anchor;
+    if (Offset >= Last) {
+      break;
     }
 
-    if (Matches) {
-      return DataOff;
+    if (PatternMask == NULL) {
+      if (CompareMem (&Data[Offset], Pattern, PatternSize) == 0) {
+        return (INT32) Offset;
+      }
+    } else {
+      for (Index = 0; Index < PatternSize; ++Index) {
+        if ((Data[Offset + Index] & PatternMask[Index]) != Pattern[Index]) {
+          break;
+        }
+      }
+
+      if (Index == PatternSize) {
+        return (INT32) Offset;
+      }
     }
-    ++DataOff;
+
+    ++Offset;
   }
 
   return -1;
 }
 
+INT32
+FindPattern (
+  IN CONST UINT8   *Pattern,
+  IN CONST UINT8   *PatternMask OPTIONAL,
+  IN CONST UINT32  PatternSize,
+  IN CONST UINT8   *Data,
+  IN UINT32        DataSize,
+  IN INT32         DataOff
+  )
+{
+  return InternalFindPattern (
+    Pattern,
+    PatternMask,
+    PatternSize,
+    InternalPatternAnchor (Pattern, PatternMask, PatternSize),
+    Data,
+    DataSize,
+    DataOff
+    );
+}
+
 UINT32
 ApplyPatch (
   IN CONST UINT8   *Pattern,
@@ -70,12 +299,14 @@ ApplyPatch (
 {
   UINT32  ReplaceCount;
   INT32   DataOff;
+  UINT32  Anchor;
 
   ReplaceCount = 0;
   DataOff = 0;
+  Anchor  = InternalPatternAnchor (Pattern, PatternMask, PatternSize);
 
   do {
-    DataOff = FindPattern (Pattern, PatternMask, PatternSize, Data, DataSize, DataOff);
+    DataOff = InternalFindPattern (Pattern, PatternMask, PatternSize, Anchor, Data, DataSize, DataOff);
 
     if (DataOff >= 0) {
       //
@@ -115,3 +346,506 @@ ApplyPatch (
 
   return ReplaceCount;
 }
+
+/**
+  Check whether the patch pattern matches the data.
+**/
+STATIC
+BOOLEAN
+InternalPatternMatches (
+  IN CONST OC_DATA_PATCH  *Patch,
+  IN CONST UINT8          *Data
+  )
+{
+  UINT32  Index;
+
+  if (Patch->PatternMask == NULL) {
+    return CompareMem (Data, Patch->Pattern, Patch->PatternSize) == 0;
+  }
+
+  for (Index = 0; Index < Patch->PatternSize; ++Index) {
+    if ((Data[Index] & Patch->PatternMask[Index]) != Patch->Pattern[Index]) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+  Write patch replacement at Offset, only the bytes within [Begin, End)
+  are written.
+
+  @param[in]     Patch   Patch to write.
+  @param[in,out] Data    Data starting at Begin.
+  @param[in]     Offset  Replacement offset.
+  @param[in]     Begin   Data start offset.
+  @param[in]     End     Data end offset.
+**/
+STATIC
+VOID
+InternalWriteReplace (
+  IN     CONST OC_DATA_PATCH  *Patch,
+  IN OUT UINT8                *Data,
+  IN     UINT32               Offset,
+  IN     UINT32               Begin,
+  IN     UINT32               End
+  )
+{
+  UINT32  Index;
+  UINT8   *Byte;
+
+  for (Index = 0; Index < Patch->PatternSize; ++Index) {
+    if (Offset + Index < Begin || Offset + Index >= End) {
+      continue;
+    }
+
+    Byte = &Data[Offset + Index - Begin];
+    if (Patch->ReplaceMask == NULL) {
+      *Byte = Patch->Replace[Index];
+    } else {
+      *Byte = (*Byte & ~Patch->ReplaceMask[Index]) | (Patch->Replace[Index] & Patch->ReplaceMask[Index]);
+    }
+  }
+}
+
+/**
+  Record replacement to be written by ApplyPatches.
+
+  @param[in,out] Writes  Replacement list.
+  @param[in]     Start   Replacement offset.
+  @param[in]     Patch   Patch index.
+
+  @retval FALSE when out of memory.
+**/
+STATIC
+BOOLEAN
+InternalRecordWrite (
+  IN OUT DATA_PATCH_WRITES  *Writes,
+  IN     UINT32             Start,
+  IN     UINT32             Patch
+  )
+{
+  DATA_PATCH_WRITE  *NewWrites;
+
+  if (Writes->NumWrites == Writes->MaxWrites) {
+    NewWrites = ReallocatePool (
+      Writes->MaxWrites * sizeof (*NewWrites),
+      Writes->MaxWrites * 2 * sizeof (*NewWrites),
+      Writes->Writes
+      );
+    if (NewWrites == NULL) {
+      Writes->Failed = TRUE;
+      return FALSE;
+    }
+
+    Writes->Writes     = NewWrites;
+    Writes->MaxWrites *= 2;
+  }
+
+  Writes->Writes[Writes->NumWrites].Start = Start;
+  Writes->Writes[Writes->NumWrites].Patch = Patch;
+  ++Writes->NumWrites;
+  return TRUE;
+}
+
+/**
+  Try to match the patch at Start offset following ApplyPatch semantics.
+  The replacement is only recorded and is written by ApplyPatches.
+
+  @param[in,out] Patch       Patch to match.
+  @param[in,out] State       Patch state.
+  @param[in]     Data        Data to match.
+  @param[in]     Start       Data offset to try.
+  @param[in,out] Writes      Replacement list.
+  @param[in]     PatchIndex  Patch index.
+
+  @retval TRUE when the patch reached its replace count or failed.
+**/
+STATIC
+BOOLEAN
+InternalMatchPatchAt (
+  IN OUT OC_DATA_PATCH      *Patch,
+  IN OUT DATA_PATCH_STATE   *State,
+  IN     CONST UINT8        *Data,
+  IN     UINT32             Start,
+  IN OUT DATA_PATCH_WRITES  *Writes,
+  IN     UINT32             PatchIndex
+  )
+{
+  //
+  // Matches must not overlap and, as in FindPattern, must end before
+  // the last byte of the window.
+  //
+  if (Start < State->NextOffset || Start + Patch->PatternSize >= State->End) {
+    return FALSE;
+  }
+
+  if (!InternalPatternMatches (Patch, &Data[Start])) {
+    return FALSE;
+  }
+
+  State->NextOffset = Start + Patch->PatternSize;
+
+  //
+  // Skip this finding if requested.
+  //
+  if (State->Skip > 0) {
+    --State->Skip;
+    return FALSE;
+  }
+
+  if (!InternalRecordWrite (Writes, Start, PatchIndex)) {
+    State->Done = TRUE;
+    return TRUE;
+  }
+
+  ++Patch->ReplaceCount;
+
+  //
+  // Check replace count if requested.
+  //
+  if (State->Count > 0) {
+    --State->Count;
+    if (State->Count == 0) {
+      State->Done = TRUE;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+  Sort replacements by offset. Matches are found in almost sorted order,
+  as every patch is dispatched by a byte within its pattern.
+
+  @param[in,out] Writes  Replacement list.
+**/
+STATIC
+VOID
+InternalSortWrites (
+  IN OUT DATA_PATCH_WRITES  *Writes
+  )
+{
+  DATA_PATCH_WRITE  Write;
+  UINT32            Index;
+  UINT32            Index2;
+
+  for (Index = 1; Index < Writes->NumWrites; ++Index) {
+    Write  = Writes->Writes[Index];
+    Index2 = Index;
+    while (Index2 > 0 && Writes->Writes[Index2 - 1].Start > Write.Start) {
+      Writes->Writes[Index2] = Writes->Writes[Index2 - 1];
+      --Index2;
+    }
+    Writes->Writes[Index2] = Write;
+  }
+}
+
+/**
+  Check whether sorted replacements give the same result as applying
+  the patches one by one in list order. This holds when replacements of
+  different patches are at least MaxSize bytes apart, and no replacement
+  changes whether a later patch matches around it.
+
+  @param[in]  Patches     Patches.
+  @param[in]  NumPatches  Number of patches.
+  @param[in]  Data        Unmodified data.
+  @param[in]  DataSize    Data size.
+  @param[in]  Writes      Sorted replacement list.
+  @param[in]  MaxSize     Maximum pattern size.
+  @param[out] View        Scratch buffer of 3 * MaxSize bytes.
+
+  @retval TRUE when the replacements may be written at once.
+**/
+STATIC
+BOOLEAN
+InternalWritesIndependent (
+  IN  CONST OC_DATA_PATCH      *Patches,
+  IN  UINT32                   NumPatches,
+  IN  CONST UINT8              *Data,
+  IN  UINT32                   DataSize,
+  IN  CONST DATA_PATCH_WRITES  *Writes,
+  IN  UINT32                   MaxSize,
+  OUT UINT8                    *View
+  )
+{
+  CONST DATA_PATCH_WRITE  *Write;
+  CONST OC_DATA_PATCH     *Patch;
+  CONST OC_DATA_PATCH     *Reader;
+  UINT32                  Index;
+  UINT32                  Index2;
+  UINT32                  PrevEnd;
+  UINT32                  PrevPatch;
+  UINT32                  SpanStart;
+  UINT32                  SpanEnd;
+  UINT32                  Offset;
+  UINT32                  OffsetEnd;
+
+  PrevEnd   = 0;
+  PrevPatch = MAX_UINT32;
+
+  for (Index = 0; Index < Writes->NumWrites; ++Index) {
+    Write = &Writes->Writes[Index];
+    if (PrevPatch != MAX_UINT32 && Write->Patch != PrevPatch
+      && Write->Start < PrevEnd + MaxSize) {
+      return FALSE;
+    }
+
+    Offset = Write->Start + Patches[Write->Patch].PatternSize;
+    if (Offset >= PrevEnd) {
+      PrevEnd   = Offset;
+      PrevPatch = Write->Patch;
+    }
+  }
+
+  for (Index = 0; Index < Writes->NumWrites; ++Index) {
+    Write = &Writes->Writes[Index];
+    Patch = &Patches[Write->Patch];
+
+    //
+    // Only the replacements of the same patch may be close enough
+    // to affect the matches around this one.
+    //
+    SpanStart = Write->Start > MaxSize ? Write->Start - MaxSize : 0;
+    SpanEnd   = MIN (Write->Start + Patch->PatternSize + MaxSize, DataSize);
+    CopyMem (View, &Data[SpanStart], SpanEnd - SpanStart);
+
+    for (Index2 = Index; Index2 > 0 && Writes->Writes[Index2 - 1].Start + MaxSize > SpanStart; --Index2) {
+    }
+    for (; Index2 < Writes->NumWrites && Writes->Writes[Index2].Start < SpanEnd; ++Index2) {
+      InternalWriteReplace (
+        &Patches[Writes->Writes[Index2].Patch],
+        View,
+        Writes->Writes[Index2].Start,
+        SpanStart,
+        SpanEnd
+        );
+    }
+
+    for (Index2 = Write->Patch + 1; Index2 < NumPatches; ++Index2) {
+      Reader = &Patches[Index2];
+      if (Reader->Pattern == NULL || Reader->PatternSize == 0
+        || Reader->PatternSize >= Reader->DataSize) {
+        continue;
+      }
+
+      Offset    = Write->Start + 1 > Reader->PatternSize ? Write->Start + 1 - Reader->PatternSize : 0;
+      Offset    = MAX (Offset, Reader->DataOffset);
+      OffsetEnd = Write->Start + Patch->PatternSize;
+      OffsetEnd = MIN (OffsetEnd, Reader->DataOffset + Reader->DataSize - Reader->PatternSize);
+
+      for (; Offset < OffsetEnd; ++Offset) {
+        if (InternalPatternMatches (Reader, &Data[Offset])
+          != InternalPatternMatches (Reader, &View[Offset - SpanStart])) {
+          return FALSE;
+        }
+      }
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+  Apply the patches one by one in list order.
+
+  @param[in,out] Patches     Patches to apply, ReplaceCount is updated.
+  @param[in]     NumPatches  Number of patches.
+  @param[in,out] Data        Data to patch.
+**/
+STATIC
+VOID
+InternalApplyPatchesInOrder (
+  IN OUT OC_DATA_PATCH  *Patches,
+  IN     UINT32         NumPatches,
+  IN OUT UINT8          *Data
+  )
+{
+  OC_DATA_PATCH  *Patch;
+  UINT32         PatchIndex;
+
+  for (PatchIndex = 0; PatchIndex < NumPatches; ++PatchIndex) {
+    Patch = &Patches[PatchIndex];
+
+    if (Patch->Pattern == NULL) {
+      Patch->ReplaceCount = 0;
+      if (Patch->PatternSize > 0 && Patch->PatternSize <= Patch->DataSize) {
+        InternalWriteReplace (Patch, Data, Patch->DataOffset, 0, MAX_UINT32);
+        Patch->ReplaceCount = 1;
+      }
+      continue;
+    }
+
+    Patch->ReplaceCount = ApplyPatch (
+      Patch->Pattern,
+      Patch->PatternMask,
+      Patch->PatternSize,
+      Patch->Replace,
+      Patch->ReplaceMask,
+      &Data[Patch->DataOffset],
+      Patch->DataSize,
+      Patch->Count,
+      Patch->Skip
+      );
+  }
+}
+
+UINT32
+ApplyPatches (
+  IN OUT OC_DATA_PATCH  *Patches,
+  IN     UINT32         NumPatches,
+  IN OUT UINT8          *Data,
+  IN     UINT32         DataSize
+  )
+{
+  DATA_PATCH_STATE   *States;
+  DATA_PATCH_STATE   *State;
+  OC_DATA_PATCH      *Patch;
+  DATA_PATCH_WRITES  Writes;
+  UINT8              *View;
+  UINT32             Heads[256];
+  UINT32             SlowHead;
+  UINT32             Index;
+  UINT32             PatchIndex;
+  UINT32             Active;
+  UINT32             Begin;
+  UINT32             End;
+  UINT32             MaxSize;
+  UINT32             Total;
+
+  Total   = 0;
+  MaxSize = 0;
+
+  for (PatchIndex = 0; PatchIndex < NumPatches; ++PatchIndex) {
+    ASSERT (Patches[PatchIndex].DataOffset <= DataSize);
+    ASSERT (Patches[PatchIndex].DataSize <= DataSize - Patches[PatchIndex].DataOffset);
+    Patches[PatchIndex].ReplaceCount = 0;
+    MaxSize = MAX (MaxSize, Patches[PatchIndex].PatternSize);
+  }
+
+  Writes.NumWrites = 0;
+  Writes.MaxWrites = NumPatches + 16;
+  Writes.Failed    = FALSE;
+  Writes.Writes    = AllocatePool (Writes.MaxWrites * sizeof (*Writes.Writes));
+  States           = AllocateZeroPool (NumPatches * sizeof (*States) + 3 * MaxSize);
+  if (States == NULL || Writes.Writes == NULL) {
+    if (States != NULL) {
+      FreePool (States);
+    }
+    if (Writes.Writes != NULL) {
+      FreePool (Writes.Writes);
+    }
+
+    InternalApplyPatchesInOrder (Patches, NumPatches, Data);
+    for (PatchIndex = 0; PatchIndex < NumPatches; ++PatchIndex) {
+      Total += Patches[PatchIndex].ReplaceCount;
+    }
+    return Total;
+  }
+
+  View = (UINT8 *)(States + NumPatches);
+
+  //
+  // Dispatch every patch by a pattern byte it must match exactly, so that
+  // only the patches which can match are tried at each data offset.
+  // Patches with no such byte are tried at every offset.
+  //
+  ZeroMem (Heads, sizeof (Heads));
+  SlowHead = 0;
+  Active   = 0;
+  Begin    = MAX_UINT32;
+  End      = 0;
+
+  for (PatchIndex = NumPatches; PatchIndex > 0; --PatchIndex) {
+    Patch = &Patches[PatchIndex - 1];
+    State = &States[PatchIndex - 1];
+
+    State->NextOffset = Patch->DataOffset;
+    State->End        = Patch->DataOffset + Patch->DataSize;
+    State->Skip       = Patch->Skip;
+    State->Count      = Patch->Count;
+    State->Done       = TRUE;
+
+    if (Patch->Pattern == NULL) {
+      if (Patch->PatternSize > 0 && Patch->PatternSize <= Patch->DataSize
+        && InternalRecordWrite (&Writes, Patch->DataOffset, PatchIndex - 1)) {
+        Patch->ReplaceCount = 1;
+      }
+      continue;
+    }
+
+    if (Patch->PatternSize == 0 || Patch->PatternSize >= Patch->DataSize) {
+      continue;
+    }
+
+    State->Done = FALSE;
+
+    Index = InternalPatternAnchor (Patch->Pattern, Patch->PatternMask, Patch->PatternSize);
+    if (Index != MAX_UINT32) {
+      State->Anchor = Index;
+      State->Next   = Heads[Patch->Pattern[Index]];
+      Heads[Patch->Pattern[Index]] = PatchIndex;
+    } else {
+      State->Anchor = 0;
+      State->Next   = SlowHead;
+      SlowHead      = PatchIndex;
+    }
+
+    Begin = MIN (Begin, State->NextOffset + State->Anchor);
+    End   = MAX (End, State->End);
+    ++Active;
+  }
+
+  //
+  // Matches are looked up in the unmodified data and only recorded.
+  //
+  for (Index = Begin; Index < End && Active > 0 && !Writes.Failed; ++Index) {
+    for (PatchIndex = Heads[Data[Index]]; PatchIndex != 0; PatchIndex = State->Next) {
+      State = &States[PatchIndex - 1];
+      if (!State->Done && Index >= State->Anchor
+        && InternalMatchPatchAt (&Patches[PatchIndex - 1], State, Data, Index - State->Anchor, &Writes, PatchIndex - 1)) {
+        --Active;
+      }
+    }
+
+    for (PatchIndex = SlowHead; PatchIndex != 0; PatchIndex = State->Next) {
+      State = &States[PatchIndex - 1];
+      if (!State->Done
+        && InternalMatchPatchAt (&Patches[PatchIndex - 1], State, Data, Index, &Writes, PatchIndex - 1)) {
+        --Active;
+      }
+    }
+  }
+
+  InternalSortWrites (&Writes);
+
+  //
+  // Replacing a match may create or break a match of a later patch,
+  // in which case the patches have to be applied one by one.
+  //
+  if (!Writes.Failed
+    && InternalWritesIndependent (Patches, NumPatches, Data, DataSize, &Writes, MaxSize, View)) {
+    for (Index = 0; Index < Writes.NumWrites; ++Index) {
+      InternalWriteReplace (
+        &Patches[Writes.Writes[Index].Patch],
+        Data,
+        Writes.Writes[Index].Start,
+        0,
+        MAX_UINT32
+        );
+    }
+  } else {
+    InternalApplyPatchesInOrder (Patches, NumPatches, Data);
+  }
+
+  FreePool (Writes.Writes);
+  FreePool (States);
+
+  for (PatchIndex = 0; PatchIndex < NumPatches; ++PatchIndex) {
+    Total += Patches[PatchIndex].ReplaceCount;
+  }
+
+  return Total;
+}
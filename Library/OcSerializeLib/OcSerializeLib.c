@@ -18,7 +18,333 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 #include <Library/OcSerializeLib.h>
 #include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcGuardLib.h>
+#include <Library/OcStringLib.h>
+
+#include "../OcTemplateLib/OcTemplateLibInternal.h"
+
+//
+// Perfect hash slot for a single schema entry.
+//
+typedef struct {
+  //
+  // Schema name hash (AsciiStrHash), 0 for empty slots.
+  //
+  UINT32     NameHash;
+  //
+  // Schema name length without the terminator.
+  //
+  UINT32     NameLength;
+  //
+  // Matching schema or NULL.
+  //
+  OC_SCHEMA  *Schema;
+} OC_SCHEMA_HASH_SLOT;
+
+//
+// Perfect hash of a schema list. A name hashed by AsciiStrHash lands in
+// Slots[((NameHash ^ Seed) * OC_SCHEMA_HASH_MULTIPLIER) >> Shift], and the slot
+// is either empty or holds the only schema which may match it.
+//
+typedef struct {
+  UINT32               Seed;
+  UINT32               Shift;
+  OC_SCHEMA_HASH_SLOT  Slots[];
+} OC_SCHEMA_HASH;
+
+//
+// Dictionary schema list and its perfect hash, NULL if it could not be hashed.
+//
+typedef struct {
+  OC_SCHEMA_DICT  *Dict;
+  OC_SCHEMA_HASH  *Hash;
+} OC_SCHEMA_HASHES_ENTRY;
+
+//
+// Perfect hashes of all dictionary schema lists reachable from a root schema.
+//
+struct OC_SCHEMA_HASHES_ {
+  UINT32                  Count;
+  UINT32                  AllocCount;
+  OC_SCHEMA_HASHES_ENTRY  *Entries;
+};
+
+//
+// Golden ratio multiplier spreading name hashes over the slots.
+//
+#define OC_SCHEMA_HASH_MULTIPLIER  0x9E3779B1U
+
+//
+// Seeds tried per slot count and slot count growth before giving up on
+// perfect hashing and falling back to binary search.
+//
+#define OC_SCHEMA_HASH_MAX_SEEDS   256U
+#define OC_SCHEMA_HASH_MAX_GROWTH  3U
+
+STATIC
+UINT32
+SchemaHashSlot (
+  IN CONST OC_SCHEMA_HASH  *Hash,
+  IN UINT32                NameHash
+  )
+{
+  return ((NameHash ^ Hash->Seed) * OC_SCHEMA_HASH_MULTIPLIER) >> Hash->Shift;
+}
+
+STATIC
+OC_SCHEMA_HASH *
+SchemaHashCreate (
+  IN OC_SCHEMA  *Schema,
+  IN UINT32     SchemaSize
+  )
+{
+  OC_SCHEMA_HASH       *Hash;
+  OC_SCHEMA_HASH_SLOT  *Names;
+  OC_SCHEMA_HASH_SLOT  *Slot;
+  UINT32               Bits;
+  UINT32               SlotCount;
+  UINT32               Growth;
+  UINT32               Seed;
+  UINT32               Index;
+  UINTN                NameLength;
+
+  if (SchemaSize == 0 || SchemaSize > MAX_UINT16) {
+    return NULL;
+  }
+
+  //
+  // Names are hashed once, seeds only change their slots.
+  //
+  Names = AllocatePool (SchemaSize * sizeof (Names[0]));
+  if (Names == NULL) {
+    return NULL;
+  }
+
+  for (Index = 0; Index < SchemaSize; ++Index) {
+    Names[Index].NameHash   = AsciiStrHash (Schema[Index].Name, &NameLength);
+    Names[Index].NameLength = (UINT32) NameLength;
+    Names[Index].Schema     = &Schema[Index];
+  }
+
+  //
+  // Start with at least twice as many slots as entries to find a seed quickly.
+  //
+  Bits = 1;
+  while ((1U << Bits) < SchemaSize * 2) {
+    ++Bits;
+  }
+
+  for (Growth = 0; Growth < OC_SCHEMA_HASH_MAX_GROWTH; ++Growth, ++Bits) {
+    SlotCount = 1U << Bits;
+    Hash      = AllocatePool (sizeof (*Hash) + SlotCount * sizeof (Hash->Slots[0]));
+    if (Hash == NULL) {
+      break;
+    }
+
+    Hash->Shift = 32 - Bits;
+
+    for (Seed = 0; Seed < OC_SCHEMA_HASH_MAX_SEEDS; ++Seed) {
+      Hash->Seed = Seed * 0x85EBCA6BU;
+      ZeroMem (Hash->Slots, SlotCount * sizeof (Hash->Slots[0]));
+
+      for (Index = 0; Index < SchemaSize; ++Index) {
+        Slot = &Hash->Slots[SchemaHashSlot (Hash, Names[Index].NameHash)];
+        if (Slot->Schema != NULL) {
+          break;
+        }
+
+        *Slot = Names[Index];
+      }
+
+      if (Index == SchemaSize) {
+        FreePool (Names);
+        return Hash;
+      }
+    }
+
+    FreePool (Hash);
+  }
+
+  FreePool (Names);
+  return NULL;
+}
+
+//
+// Finds the entry of a dictionary schema list. This is done once per parsed
+// dictionary, and schemas only have a few dozen dictionaries.
+//
+STATIC
+OC_SCHEMA_HASHES_ENTRY *
+SchemaHashesFind (
+  IN OC_SCHEMA_HASHES  *Hashes,
+  IN OC_SCHEMA_DICT    *Dict
+  )
+{
+  UINT32  Index;
+
+  for (Index = 0; Index < Hashes->Count; ++Index) {
+    if (Hashes->Entries[Index].Dict == Dict) {
+      return &Hashes->Entries[Index];
+    }
+  }
+
+  return NULL;
+}
+
+STATIC
+BOOLEAN
+SchemaHashesAddDict (
+  IN OUT OC_SCHEMA_HASHES  *Hashes,
+  IN     OC_SCHEMA_DICT    *Dict
+  );
+
+STATIC
+BOOLEAN
+SchemaHashesAddSchema (
+  IN OUT OC_SCHEMA_HASHES  *Hashes,
+  IN     OC_SCHEMA         *Schema
+  )
+{
+  if (Schema->Apply == ParseSerializedDict) {
+    return SchemaHashesAddDict (Hashes, &Schema->Info.Dict);
+  }
+
+  if (Schema->Apply == ParseSerializedArray || Schema->Apply == ParseSerializedMap) {
+    return SchemaHashesAddSchema (Hashes, Schema->Info.List.Schema);
+  }
+
+  return TRUE;
+}
+
+STATIC
+BOOLEAN
+SchemaHashesAddDict (
+  IN OUT OC_SCHEMA_HASHES  *Hashes,
+  IN     OC_SCHEMA_DICT    *Dict
+  )
+{
+  OC_SCHEMA_HASHES_ENTRY  *Entries;
+  OC_SCHEMA_HASHES_ENTRY  *Entry;
+  UINT32                  AllocCount;
+  UINT32                  Index;
+
+  //
+  // Dictionary schema lists may be shared by several schemas.
+  //
+  if (SchemaHashesFind (Hashes, Dict) != NULL) {
+    return TRUE;
+  }
+
+  if (Hashes->Count == Hashes->AllocCount) {
+    AllocCount = MAX (Hashes->AllocCount * 2, 16);
+    Entries    = ReallocatePool (
+      Hashes->AllocCount * sizeof (Hashes->Entries[0]),
+      AllocCount * sizeof (Hashes->Entries[0]),
+      Hashes->Entries
+      );
+    if (Entries == NULL) {
+      return FALSE;
+    }
+
+    Hashes->Entries    = Entries;
+    Hashes->AllocCount = AllocCount;
+  }
+
+  //
+  // Entry is not used past the recursion below, which may reallocate Entries.
+  //
+  Entry       = &Hashes->Entries[Hashes->Count++];
+  Entry->Dict = Dict;
+  Entry->Hash = SchemaHashCreate (Dict->Schema, Dict->SchemaSize);
+  if (Entry->Hash == NULL) {
+    DEBUG ((DEBUG_VERBOSE, "OCS: No schema hash for %u entries\n", Dict->SchemaSize));
+  }
+
+  for (Index = 0; Index < Dict->SchemaSize; ++Index) {
+    if (!SchemaHashesAddSchema (Hashes, &Dict->Schema[Index])) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+OC_SCHEMA_HASHES *
+CreateConfigSchemaHashes (
+  OC_SCHEMA_INFO  *RootSchema
+  )
+{
+  OC_SCHEMA_HASHES  *Hashes;
+
+  Hashes = AllocateZeroPool (sizeof (*Hashes));
+  if (Hashes == NULL) {
+    return NULL;
+  }
+
+  if (!SchemaHashesAddDict (Hashes, &RootSchema->Dict)) {
+    DEBUG ((DEBUG_INFO, "OCS: Couldn't allocate schema hashes\n"));
+    FreeConfigSchemaHashes (Hashes);
+    return NULL;
+  }
+
+  return Hashes;
+}
+
+VOID
+FreeConfigSchemaHashes (
+  OC_SCHEMA_HASHES  *Hashes
+  )
+{
+  UINT32  Index;
+
+  for (Index = 0; Index < Hashes->Count; ++Index) {
+    if (Hashes->Entries[Index].Hash != NULL) {
+      FreePool (Hashes->Entries[Index].Hash);
+    }
+  }
+
+  if (Hashes->Entries != NULL) {
+    FreePool (Hashes->Entries);
+  }
+
+  FreePool (Hashes);
+}
+
+//
+// Finds schema in a dictionary schema list by its perfect hash,
+// or by binary search when there is none.
+//
+STATIC
+OC_SCHEMA *
+SchemaHashLookup (
+  IN OC_SCHEMA_HASH  *Hash  OPTIONAL,
+  IN OC_SCHEMA_DICT  *Dict,
+  IN CONST CHAR8     *Name
+  )
+{
+  OC_SCHEMA_HASH_SLOT  *Slot;
+  UINT32               NameHash;
+  UINTN                NameLength;
+
+  if (Hash == NULL) {
+    return LookupConfigSchema (Dict->Schema, Dict->SchemaSize, Name);
+  }
+
+  NameHash = AsciiStrHash (Name, &NameLength);
+  Slot     = &Hash->Slots[SchemaHashSlot (Hash, NameHash)];
+
+  if (Slot->Schema != NULL
+    && Slot->NameHash == NameHash
+    && Slot->NameLength == NameLength
+    && CompareMem (Slot->Schema->Name, Name, NameLength) == 0) {
+    return Slot->Schema;
+  }
+
+  return NULL;
+}
 
 OC_SCHEMA *
 LookupConfigSchema (
@@ -314,38 +640,1256 @@ ParseSerializedArray (
   }
 }
 
+//
+// Builtin schema appliers known to serialized streams and images.
+//
+typedef enum {
+  SERIALIZED_KIND_UNKNOWN,
+  SERIALIZED_KIND_DICT,
+  SERIALIZED_KIND_VALUE,
+  SERIALIZED_KIND_BLOB,
+  SERIALIZED_KIND_ARRAY,
+  SERIALIZED_KIND_MAP
+} SERIALIZED_KIND;
+
+//
+// Serialized stream frame of a plist dictionary or array being parsed.
+//
+typedef struct {
+  //
+  // Dictionary, array, or map applier, unknown for skipped values.
+  //
+  SERIALIZED_KIND  Kind;
+  VOID             *Serialized;
+  OC_SCHEMA_INFO   *Info;
+  //
+  // Last dictionary or map key and its dictionary schema, if any.
+  //
+  CONST CHAR8      *Key;
+  OC_SCHEMA        *Schema;
+  //
+  // Perfect hash of the dictionary schema list, if any.
+  //
+  OC_SCHEMA_HASH   *Hash;
+  //
+  // Number of keys and values, dictionaries have them in pairs.
+  //
+  UINT32           Count;
+} SERIALIZED_STREAM_FRAME;
+
+//
+// Serialized stream parser, applies plist events to the schema.
+// Every plist nest level has at most one frame.
+//
+typedef struct {
+  VOID                     *Serialized;
+  OC_SCHEMA_INFO           *RootSchema;
+  OC_SCHEMA_HASHES         *Hashes;
+  //
+  // Dictionaries with odd children by their order in the plist,
+  // and whether the current one has them.
+  //
+  CONST UINT8              *OddDicts;
+  UINT32                   DictCount;
+  BOOLEAN                  OddDict;
+  UINT32                   Depth;
+  SERIALIZED_STREAM_FRAME  Frames[XML_PARSER_NEST_LEVEL];
+} SERIALIZED_STREAM;
+
+//
+// Serialized stream checker frame of a plist dictionary or array.
+//
+typedef struct {
+  BOOLEAN  IsDict;
+  UINT32   DictIndex;
+  UINT32   Count;
+} SERIALIZED_CHECK_FRAME;
+
+//
+// Serialized stream checker, validates the plist and finds dictionaries
+// with odd children before anything is applied.
+//
+typedef struct {
+  UINT8                   *OddDicts;
+  UINT32                  DictCount;
+  UINT32                  Depth;
+  SERIALIZED_CHECK_FRAME  Frames[XML_PARSER_NEST_LEVEL];
+} SERIALIZED_CHECK;
+
+STATIC
+SERIALIZED_KIND
+SerializedKind (
+  IN OC_SCHEMA  *Schema
+  )
+{
+  if (Schema->Apply == ParseSerializedDict) {
+    return SERIALIZED_KIND_DICT;
+  }
+  if (Schema->Apply == ParseSerializedValue) {
+    return SERIALIZED_KIND_VALUE;
+  }
+  if (Schema->Apply == ParseSerializedBlob) {
+    return SERIALIZED_KIND_BLOB;
+  }
+  if (Schema->Apply == ParseSerializedArray) {
+    return SERIALIZED_KIND_ARRAY;
+  }
+  if (Schema->Apply == ParseSerializedMap) {
+    return SERIALIZED_KIND_MAP;
+  }
+  return SERIALIZED_KIND_UNKNOWN;
+}
+
+STATIC
 BOOLEAN
-ParseSerialized (
-  VOID            *Serialized,
-  OC_SCHEMA_INFO  *RootSchema,
-  VOID            *PlistBuffer,
-  UINT32          PlistSize
+SerializedStreamSupportsDict (
+  IN OC_SCHEMA_DICT  *Dict
+  );
+
+//
+// Checks whether the schema only uses builtin appliers, other appliers
+// need a document node and are only supported by the document parser.
+//
+STATIC
+BOOLEAN
+SerializedStreamSupportsSchema (
+  IN OC_SCHEMA  *Schema
   )
 {
-  XML_DOCUMENT        *Document;
-  XML_NODE            *RootDict;
+  switch (SerializedKind (Schema)) {
+    case SERIALIZED_KIND_DICT:
+      return SerializedStreamSupportsDict (&Schema->Info.Dict);
+    case SERIALIZED_KIND_ARRAY:
+    case SERIALIZED_KIND_MAP:
+      return SerializedStreamSupportsSchema (Schema->Info.List.Schema);
+    case SERIALIZED_KIND_VALUE:
+    case SERIALIZED_KIND_BLOB:
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
 
-  Document = XmlDocumentParse (PlistBuffer, PlistSize, FALSE);
+STATIC
+BOOLEAN
+SerializedStreamSupportsDict (
+  IN OC_SCHEMA_DICT  *Dict
+  )
+{
+  UINT32  Index;
 
-  if (Document == NULL) {
-    DEBUG ((DEBUG_INFO, "OCS: Couldn't parse serialized file!\n"));
-    return FALSE;
+  for (Index = 0; Index < Dict->SchemaSize; ++Index) {
+    if (!SerializedStreamSupportsSchema (&Dict->Schema[Index])) {
+      return FALSE;
+    }
   }
 
-  RootDict = PlistNodeCast (PlistDocumentRoot (Document), PLIST_NODE_TYPE_DICT);
+  return TRUE;
+}
 
-  if (RootDict == NULL) {
-    DEBUG ((DEBUG_INFO, "OCS: Couldn't get serialized root!\n"));
-    XmlDocumentFree (Document);
+//
+// Plist event handler of the serialized stream checker.
+//
+STATIC
+BOOLEAN
+SerializedCheckEvent (
+  IN VOID              *Context,
+  IN PLIST_EVENT_TYPE  Type,
+  IN XML_NODE          *Node
+  )
+{
+  SERIALIZED_CHECK        *Check;
+  SERIALIZED_CHECK_FRAME  *Frame;
+
+  Check = (SERIALIZED_CHECK *) Context;
+
+  if (Type == PLIST_EVENT_END) {
+    ASSERT (Check->Depth > 0);
+    Frame = &Check->Frames[--Check->Depth];
+
+    if (Frame->IsDict && Frame->Count % 2 != 0) {
+      Check->OddDicts[Frame->DictIndex / 8] |= (UINT8) (1U << (Frame->DictIndex % 8));
+    }
+
+    return TRUE;
+  }
+
+  if (Check->Depth > 0) {
+    Check->Frames[Check->Depth - 1].Count++;
+  }
+
+  if (Type == PLIST_EVENT_DICT_BEGIN || Type == PLIST_EVENT_ARRAY_BEGIN) {
+    if (Check->Depth == ARRAY_SIZE (Check->Frames)) {
+      DEBUG ((DEBUG_INFO, "OCS: Serialized nesting is too deep!\n"));
+      return FALSE;
+    }
+
+    Frame = &Check->Frames[Check->Depth++];
+    Frame->IsDict    = Type == PLIST_EVENT_DICT_BEGIN;
+    Frame->DictIndex = Check->DictCount;
+    Frame->Count     = 0;
+
+    if (Frame->IsDict) {
+      Check->DictCount++;
+    }
+  }
+
+  return TRUE;
+}
+
+STATIC
+BOOLEAN
+SerializedStreamPush (
+  IN OUT SERIALIZED_STREAM  *Stream,
+  IN     SERIALIZED_KIND    Kind,
+  IN     VOID               *Serialized,
+  IN     OC_SCHEMA_INFO     *Info
+  )
+{
+  SERIALIZED_STREAM_FRAME  *Frame;
+  OC_SCHEMA_HASHES_ENTRY   *Entry;
+
+  if (Stream->Depth == ARRAY_SIZE (Stream->Frames)) {
+    DEBUG ((DEBUG_INFO, "OCS: Serialized nesting is too deep!\n"));
     return FALSE;
   }
 
-  ParseSerializedDict (
-    Serialized,
-    RootDict,
-    RootSchema
-    );
+  Frame = &Stream->Frames[Stream->Depth++];
+  Frame->Kind       = Kind;
+  Frame->Serialized = Serialized;
+  Frame->Info       = Info;
+  Frame->Key        = NULL;
+  Frame->Schema     = NULL;
+  Frame->Hash       = NULL;
+  Frame->Count      = 0;
 
-  XmlDocumentFree (Document);
+  if (Kind == SERIALIZED_KIND_DICT && Stream->Hashes != NULL) {
+    Entry = SchemaHashesFind (Stream->Hashes, &Info->Dict);
+    if (Entry != NULL) {
+      Frame->Hash = Entry->Hash;
+    }
+  }
+
+  return TRUE;
+}
+
+//
+// Skips the value, dictionaries and arrays are skipped up to their end.
+//
+STATIC
+BOOLEAN
+SerializedStreamSkip (
+  IN OUT SERIALIZED_STREAM  *Stream,
+  IN     PLIST_EVENT_TYPE   Type
+  )
+{
+  if (Type == PLIST_EVENT_DICT_BEGIN || Type == PLIST_EVENT_ARRAY_BEGIN) {
+    return SerializedStreamPush (Stream, SERIALIZED_KIND_UNKNOWN, NULL, NULL);
+  }
+
+  return TRUE;
+}
+
+//
+// Checks whether the value matches the schema like PlistNodeCast does.
+// Dictionaries and arrays only match builtin dictionary, array, and map
+// appliers, as other appliers need a document node.
+//
+STATIC
+BOOLEAN
+SerializedStreamMatch (
+  IN SERIALIZED_STREAM  *Stream,
+  IN OC_SCHEMA          *Schema,
+  IN PLIST_EVENT_TYPE   Type,
+  IN XML_NODE           *Node
+  )
+{
+  SERIALIZED_KIND  Kind;
+
+  if (Type == PLIST_EVENT_KEY || Type == PLIST_EVENT_VALUE) {
+    return Node != NULL && PlistNodeCast (Node, Schema->Type) != NULL;
+  }
+
+  Kind = SerializedKind (Schema);
+
+  if (Type == PLIST_EVENT_DICT_BEGIN) {
+    if (Schema->Type == PLIST_NODE_TYPE_DICT && Stream->OddDict) {
+      return FALSE;
+    }
+
+    return (Schema->Type == PLIST_NODE_TYPE_ANY || Schema->Type == PLIST_NODE_TYPE_DICT)
+      && (Kind == SERIALIZED_KIND_DICT || Kind == SERIALIZED_KIND_MAP);
+  }
+
+  return (Schema->Type == PLIST_NODE_TYPE_ANY || Schema->Type == PLIST_NODE_TYPE_ARRAY)
+    && Kind == SERIALIZED_KIND_ARRAY;
+}
+
+//
+// Applies a matching value to the schema, dictionaries and arrays
+// are applied by the events up to their end.
+//
+STATIC
+BOOLEAN
+SerializedStreamApply (
+  IN OUT SERIALIZED_STREAM  *Stream,
+  IN     OC_SCHEMA          *Schema,
+  IN     PLIST_EVENT_TYPE   Type,
+  IN     XML_NODE           *Node,
+  IN     VOID               *Serialized
+  )
+{
+  if (Type != PLIST_EVENT_DICT_BEGIN && Type != PLIST_EVENT_ARRAY_BEGIN) {
+    Schema->Apply (Serialized, Node, &Schema->Info);
+    return TRUE;
+  }
+
+  return SerializedStreamPush (Stream, SerializedKind (Schema), Serialized, &Schema->Info);
+}
+
+//
+// Plist event handler, mirrors ParseSerializedDict, ParseSerializedArray,
+// and ParseSerializedMap.
+//
+STATIC
+BOOLEAN
+SerializedStreamEvent (
+  IN VOID              *Context,
+  IN PLIST_EVENT_TYPE  Type,
+  IN XML_NODE          *Node
+  )
+{
+  SERIALIZED_STREAM        *Stream;
+  SERIALIZED_STREAM_FRAME  *Frame;
+  OC_SCHEMA                *Schema;
+  CONST CHAR8              *CurrentKey;
+  UINT32                   CurrentKeyLen;
+  UINT32                   Position;
+  UINT32                   Index;
+  VOID                     *NewValue;
+  VOID                     *NewKey;
+  VOID                     *NewKeyValue;
+  BOOLEAN                  Success;
+
+  Stream = (SERIALIZED_STREAM *) Context;
+
+  if (Type == PLIST_EVENT_END) {
+    ASSERT (Stream->Depth > 0);
+    Stream->Depth--;
+    return TRUE;
+  }
+
+  if (Type == PLIST_EVENT_DICT_BEGIN) {
+    Stream->OddDict = (Stream->OddDicts[Stream->DictCount / 8] & (1U << (Stream->DictCount % 8))) != 0;
+    Stream->DictCount++;
+  }
+
+  if (Stream->Depth == 0) {
+    if (Type != PLIST_EVENT_DICT_BEGIN || Stream->OddDict) {
+      DEBUG ((DEBUG_INFO, "OCS: Couldn't get serialized root!\n"));
+      return FALSE;
+    }
+
+    return SerializedStreamPush (Stream, SERIALIZED_KIND_DICT, Stream->Serialized, Stream->RootSchema);
+  }
+
+  Frame    = &Stream->Frames[Stream->Depth - 1];
+  Position = Frame->Count++;
+
+  if (Frame->Kind == SERIALIZED_KIND_UNKNOWN) {
+    return SerializedStreamSkip (Stream, Type);
+  }
+
+  //
+  // Dictionary keys and values alternate like with PlistDictChild,
+  // arrays only have values.
+  //
+  if (Frame->Kind != SERIALIZED_KIND_ARRAY && Position % 2 == 0) {
+    Index         = Position / 2;
+    CurrentKey    = PlistKeyValue (Node);
+    Frame->Key    = CurrentKey;
+    Frame->Schema = NULL;
+
+    if (CurrentKey == NULL) {
+      if (Frame->Kind == SERIALIZED_KIND_DICT) {
+        DEBUG ((DEBUG_WARN, "OCS: No serialized key at %u index!\n", Index));
+      } else {
+        DEBUG ((DEBUG_INFO, "OCS: No get serialized key at %u index!\n", Index));
+      }
+      return SerializedStreamSkip (Stream, Type);
+    }
+
+    //
+    // Skip comments.
+    //
+    if (Frame->Kind != SERIALIZED_KIND_DICT || CurrentKey[0] == '#') {
+      return TRUE;
+    }
+
+    DEBUG ((DEBUG_VERBOSE, "OCS: Parsing serialized at %a at %u index!\n", CurrentKey, Index));
+
+    //
+    // We do not protect from duplicating serialized entries.
+    //
+    Frame->Schema = SchemaHashLookup (Frame->Hash, &Frame->Info->Dict, CurrentKey);
+
+    if (Frame->Schema == NULL) {
+      DEBUG ((DEBUG_WARN, "OCS: No schema for %a at %u index!\n", CurrentKey, Index));
+    }
+
+    return TRUE;
+  }
+
+  CurrentKey = Frame->Key;
+
+  if (Frame->Kind == SERIALIZED_KIND_DICT) {
+    Index  = Position / 2;
+    Schema = Frame->Schema;
+
+    //
+    // Missing keys, comments, and unknown keys have no schema.
+    //
+    if (Schema == NULL) {
+      return SerializedStreamSkip (Stream, Type);
+    }
+
+    if (!SerializedStreamMatch (Stream, Schema, Type, Node)) {
+      DEBUG ((DEBUG_WARN, "OCS: No match for %a at %u index!\n", CurrentKey, Index));
+      return SerializedStreamSkip (Stream, Type);
+    }
+
+    return SerializedStreamApply (Stream, Schema, Type, Node, Frame->Serialized);
+  }
+
+  Schema = Frame->Info->List.Schema;
+
+  if (Frame->Kind == SERIALIZED_KIND_MAP) {
+    Index = Position / 2;
+
+    //
+    // Skip missing keys and comments.
+    //
+    if (CurrentKey == NULL || CurrentKey[0] == '#') {
+      return SerializedStreamSkip (Stream, Type);
+    }
+
+    if (!SerializedStreamMatch (Stream, Schema, Type, Node)) {
+      DEBUG ((DEBUG_INFO, "OCS: No valid serialized value at %u index!\n", Index));
+      return SerializedStreamSkip (Stream, Type);
+    }
+  } else {
+    Index = Position;
+
+    DEBUG ((DEBUG_VERBOSE, "OCS: Processing array %u element\n", Index + 1));
+
+    if (!SerializedStreamMatch (Stream, Schema, Type, Node)) {
+      DEBUG ((DEBUG_INFO, "OCS: Couldn't get array serialized at %u index!\n", Index));
+      return SerializedStreamSkip (Stream, Type);
+    }
+  }
+
+  Success = OcListEntryAllocate (
+    OC_SCHEMA_FIELD (Frame->Serialized, VOID, Frame->Info->List.Field),
+    &NewValue,
+    Frame->Kind == SERIALIZED_KIND_MAP ? &NewKey : NULL
+    );
+  if (Success == FALSE) {
+    DEBUG ((DEBUG_INFO, "OCS: Couldn't insert serialized at %u index!\n", Index));
+    return SerializedStreamSkip (Stream, Type);
+  }
+
+  if (Frame->Kind == SERIALIZED_KIND_MAP) {
+    CurrentKeyLen = (UINT32) (AsciiStrLen (CurrentKey) + 1);
+    NewKeyValue = OcBlobAllocate (NewKey, CurrentKeyLen, NULL);
+    if (NewKeyValue != NULL) {
+      AsciiStrnCpyS ((CHAR8 *) NewKeyValue, CurrentKeyLen, CurrentKey, CurrentKeyLen - 1);
+    } else {
+      DEBUG ((DEBUG_INFO, "OCS: Couldn't allocate key name at %u index!\n", Index));
+    }
+  }
+
+  return SerializedStreamApply (Stream, Schema, Type, Node, NewValue);
+}
+
+//
+// Parses the plist into a document and applies it to the schema.
+//
+STATIC
+BOOLEAN
+ParseSerializedDocument (
+  VOID            *Serialized,
+  OC_SCHEMA_INFO  *RootSchema,
+  VOID            *PlistBuffer,
+  UINT32          PlistSize
+  )
+{
+  XML_DOCUMENT        *Document;
+  XML_NODE            *RootDict;
+
+  Document = XmlDocumentParse (PlistBuffer, PlistSize, FALSE);
+
+  if (Document == NULL) {
+    DEBUG ((DEBUG_INFO, "OCS: Couldn't parse serialized file!\n"));
+    return FALSE;
+  }
+
+  RootDict = PlistNodeCast (PlistDocumentRoot (Document), PLIST_NODE_TYPE_DICT);
+
+  if (RootDict == NULL) {
+    DEBUG ((DEBUG_INFO, "OCS: Couldn't get serialized root!\n"));
+    XmlDocumentFree (Document);
+    return FALSE;
+  }
+
+  ParseSerializedDict (
+    Serialized,
+    RootDict,
+    RootSchema
+    );
+
+  XmlDocumentFree (Document);
+  return TRUE;
+}
+
+//
+// Applies the plist to the schema as it is parsed, which leaves no document
+// to free. A copy of the plist is checked first, so that malformed plists
+// apply nothing and dictionaries with odd children are known in advance.
+//
+STATIC
+BOOLEAN
+ParseSerializedStream (
+  VOID              *Serialized,
+  OC_SCHEMA_INFO    *RootSchema,
+  OC_SCHEMA_HASHES  *Hashes  OPTIONAL,
+  VOID              *PlistBuffer,
+  UINT32            PlistSize
+  )
+{
+  SERIALIZED_CHECK   Check;
+  SERIALIZED_STREAM  Stream;
+  VOID               *PlistCopy;
+  BOOLEAN            Result;
+
+  //
+  // Every dictionary takes more than one byte of the plist.
+  //
+  ZeroMem (&Check, sizeof (Check));
+  Check.OddDicts = AllocateZeroPool (PlistSize / 8 + 1);
+  if (Check.OddDicts == NULL) {
+    return FALSE;
+  }
+
+  PlistCopy = AllocateCopyPool (PlistSize, PlistBuffer);
+  if (PlistCopy == NULL) {
+    FreePool (Check.OddDicts);
+    return FALSE;
+  }
+
+  Result = PlistParseEvents (PlistCopy, PlistSize, SerializedCheckEvent, &Check);
+  FreePool (PlistCopy);
+
+  if (Result) {
+    ZeroMem (&Stream, sizeof (Stream));
+    Stream.Serialized = Serialized;
+    Stream.RootSchema = RootSchema;
+    Stream.Hashes     = Hashes;
+    Stream.OddDicts   = Check.OddDicts;
+
+    //
+    // The same events are reported again, so the only possible failure
+    // is an invalid root, which is rejected before anything is applied.
+    //
+    Result = PlistParseEvents (PlistBuffer, PlistSize, SerializedStreamEvent, &Stream);
+  } else {
+    DEBUG ((DEBUG_INFO, "OCS: Couldn't parse serialized file!\n"));
+  }
+
+  FreePool (Check.OddDicts);
+  return Result;
+}
+
+BOOLEAN
+ParseSerialized (
+  VOID            *Serialized,
+  OC_SCHEMA_INFO  *RootSchema,
+  VOID            *PlistBuffer,
+  UINT32          PlistSize
+  )
+{
+  return ParseSerializedWithHashes (Serialized, RootSchema, NULL, PlistBuffer, PlistSize);
+}
+
+BOOLEAN
+ParseSerializedWithHashes (
+  VOID              *Serialized,
+  OC_SCHEMA_INFO    *RootSchema,
+  OC_SCHEMA_HASHES  *Hashes  OPTIONAL,
+  VOID              *PlistBuffer,
+  UINT32            PlistSize
+  )
+{
+  if (!SerializedStreamSupportsDict (&RootSchema->Dict)) {
+    return ParseSerializedDocument (Serialized, RootSchema, PlistBuffer, PlistSize);
+  }
+
+  return ParseSerializedStream (Serialized, RootSchema, Hashes, PlistBuffer, PlistSize);
+}
+
+//
+// Serialized image writer.
+//
+typedef struct {
+  UINT8    *Buffer;
+  UINT32   Size;
+  UINT32   AllocSize;
+  BOOLEAN  Failed;
+} SERIALIZED_IMAGE_WRITER;
+
+//
+// Serialized image mapper.
+//
+typedef struct {
+  UINT8    *Image;
+  UINT32   Size;
+  //
+  // Regions are claimed in the order they were written, so every next region
+  // must start at or after Next. This rules out aliasing and cycles.
+  //
+  UINT32   Next;
+} SERIALIZED_IMAGE_MAPPER;
+
+STATIC
+UINT32
+SerializedHashData (
+  IN UINT32       Hash,
+  IN CONST VOID   *Data,
+  IN UINTN        Size
+  )
+{
+  CONST UINT8  *Walker;
+
+  for (Walker = Data; Size > 0; --Size, ++Walker) {
+    Hash ^= *Walker;
+    Hash *= 16777619U;
+  }
+
+  return Hash;
+}
+
+STATIC
+UINT32
+SerializedHashDict (
+  IN UINT32          Hash,
+  IN OC_SCHEMA_DICT  *Dict
+  );
+
+STATIC
+UINT32
+SerializedHashSchema (
+  IN UINT32     Hash,
+  IN OC_SCHEMA  *Schema
+  )
+{
+  SERIALIZED_KIND  Kind;
+
+  Kind = SerializedKind (Schema);
+  Hash = SerializedHashData (Hash, &Kind, sizeof (Kind));
+  Hash = SerializedHashData (Hash, &Schema->Type, sizeof (Schema->Type));
+  if (Schema->Name != NULL) {
+    Hash = SerializedHashData (Hash, Schema->Name, AsciiStrSize (Schema->Name));
+  }
+
+  switch (Kind) {
+    case SERIALIZED_KIND_DICT:
+      Hash = SerializedHashDict (Hash, &Schema->Info.Dict);
+      break;
+    case SERIALIZED_KIND_VALUE:
+      Hash = SerializedHashData (Hash, &Schema->Info.Value.Field, sizeof (Schema->Info.Value.Field));
+      Hash = SerializedHashData (Hash, &Schema->Info.Value.FieldSize, sizeof (Schema->Info.Value.FieldSize));
+      Hash = SerializedHashData (Hash, &Schema->Info.Value.Type, sizeof (Schema->Info.Value.Type));
+      break;
+    case SERIALIZED_KIND_BLOB:
+      Hash = SerializedHashData (Hash, &Schema->Info.Blob.Field, sizeof (Schema->Info.Blob.Field));
+      Hash = SerializedHashData (Hash, &Schema->Info.Blob.Type, sizeof (Schema->Info.Blob.Type));
+      break;
+    case SERIALIZED_KIND_ARRAY:
+    case SERIALIZED_KIND_MAP:
+      Hash = SerializedHashData (Hash, &Schema->Info.List.Field, sizeof (Schema->Info.List.Field));
+      Hash = SerializedHashSchema (Hash, Schema->Info.List.Schema);
+      break;
+    default:
+      break;
+  }
+
+  return Hash;
+}
+
+STATIC
+UINT32
+SerializedHashDict (
+  IN UINT32          Hash,
+  IN OC_SCHEMA_DICT  *Dict
+  )
+{
+  UINT32  Index;
+
+  Hash = SerializedHashData (Hash, &Dict->SchemaSize, sizeof (Dict->SchemaSize));
+  for (Index = 0; Index < Dict->SchemaSize; ++Index) {
+    Hash = SerializedHashSchema (Hash, &Dict->Schema[Index]);
+  }
+
+  return Hash;
+}
+
+STATIC
+UINT32
+SerializedImageSchemaHash (
+  IN OC_SCHEMA_INFO  *RootSchema
+  )
+{
+  UINT32  PointerSize;
+
+  PointerSize = sizeof (VOID *);
+  return SerializedHashDict (
+    SerializedHashData (2166136261U, &PointerSize, sizeof (PointerSize)),
+    &RootSchema->Dict
+    );
+}
+
+STATIC
+UINT32
+SerializedImageAppend (
+  IN OUT SERIALIZED_IMAGE_WRITER  *Writer,
+  IN     CONST VOID               *Data  OPTIONAL,
+  IN     UINT32                   Size
+  )
+{
+  UINT32  Offset;
+  UINT32  NewSize;
+  UINT32  NewAllocSize;
+  UINT8   *NewBuffer;
+
+  Offset = ALIGN_VALUE (Writer->Size, sizeof (UINT64));
+
+  if (Writer->Failed
+    || Offset < Writer->Size
+    || OcOverflowAddU32 (Offset, Size, &NewSize)) {
+    Writer->Failed = TRUE;
+    return 0;
+  }
+
+  if (NewSize > Writer->AllocSize) {
+    if (OcOverflowMulU32 (Writer->AllocSize, 2, &NewAllocSize)) {
+      NewAllocSize = NewSize;
+    }
+    NewAllocSize = MAX (MAX (NewAllocSize, NewSize), BASE_4KB);
+
+    NewBuffer = AllocatePool (NewAllocSize);
+    if (NewBuffer == NULL) {
+      Writer->Failed = TRUE;
+      return 0;
+    }
+
+    if (Writer->Buffer != NULL) {
+      CopyMem (NewBuffer, Writer->Buffer, Writer->Size);
+      FreePool (Writer->Buffer);
+    }
+
+    Writer->Buffer    = NewBuffer;
+    Writer->AllocSize = NewAllocSize;
+  }
+
+  ZeroMem (Writer->Buffer + Writer->Size, Offset - Writer->Size);
+  if (Data != NULL) {
+    CopyMem (Writer->Buffer + Offset, Data, Size);
+  } else {
+    ZeroMem (Writer->Buffer + Offset, Size);
+  }
+
+  Writer->Size = NewSize;
+  return Offset;
+}
+
+STATIC
+VOID
+SerializedImageSetPointer (
+  IN OUT SERIALIZED_IMAGE_WRITER  *Writer,
+  IN     UINT32                   Slot,
+  IN     UINT32                   Target
+  )
+{
+  if (!Writer->Failed) {
+    *(UINTN *) (Writer->Buffer + Slot) = Target;
+  }
+}
+
+STATIC
+VOID
+SerializedImageWriteDict (
+  IN OUT SERIALIZED_IMAGE_WRITER  *Writer,
+  IN     UINT32                   ObjectOffset,
+  IN     VOID                     *Object,
+  IN     OC_SCHEMA_DICT           *Dict
+  );
+
+STATIC
+VOID
+SerializedImageWriteBlob (
+  IN OUT SERIALIZED_IMAGE_WRITER  *Writer,
+  IN     UINT32                   BlobOffset,
+  IN     PRIV_OC_BLOB             *Blob
+  )
+{
+  UINT32  Target;
+
+  if (Blob->DynValue != NULL) {
+    Target = SerializedImageAppend (Writer, Blob->DynValue, Blob->Size);
+    SerializedImageSetPointer (Writer, BlobOffset + OFFSET_OF (PRIV_OC_BLOB, DynValue), Target);
+  }
+}
+
+STATIC
+VOID
+SerializedImageWriteNode (
+  IN OUT SERIALIZED_IMAGE_WRITER  *Writer,
+  IN     UINT32                   ObjectOffset,
+  IN     VOID                     *Object,
+  IN     OC_SCHEMA                *Schema
+  );
+
+STATIC
+VOID
+SerializedImageWriteList (
+  IN OUT SERIALIZED_IMAGE_WRITER  *Writer,
+  IN     UINT32                   ListOffset,
+  IN     PRIV_OC_LIST             *List,
+  IN     OC_SCHEMA                *EntrySchema,
+  IN     BOOLEAN                  IsMap
+  )
+{
+  PRIV_OC_LIST  *ImageList;
+  UINT32        Count;
+  UINT32        TableSize;
+  UINT32        ValuesOffset;
+  UINT32        KeysOffset;
+  UINT32        Entry;
+  UINT32        Index;
+
+  Count        = List->Array.Count;
+  ValuesOffset = 0;
+  KeysOffset   = 0;
+
+  if (Count > 0) {
+    if (OcOverflowMulU32 (Count, sizeof (VOID *), &TableSize)) {
+      Writer->Failed = TRUE;
+      return;
+    }
+
+    ValuesOffset = SerializedImageAppend (Writer, NULL, TableSize);
+    if (IsMap) {
+      KeysOffset = SerializedImageAppend (Writer, NULL, TableSize);
+    }
+
+    for (Index = 0; Index < Count && !Writer->Failed; ++Index) {
+      Entry = SerializedImageAppend (Writer, List->Array.Values[Index], List->Array.ValueSize);
+      SerializedImageSetPointer (Writer, ValuesOffset + Index * sizeof (VOID *), Entry);
+      SerializedImageWriteNode (Writer, Entry, List->Array.Values[Index], EntrySchema);
+
+      if (IsMap) {
+        Entry = SerializedImageAppend (Writer, List->Map.Keys[Index], List->Map.KeySize);
+        SerializedImageSetPointer (Writer, KeysOffset + Index * sizeof (VOID *), Entry);
+        SerializedImageWriteBlob (Writer, Entry, List->Map.Keys[Index]);
+      }
+    }
+  }
+
+  if (Writer->Failed) {
+    return;
+  }
+
+  //
+  // Structors are host pointers, they are replaced when mapping.
+  //
+  ImageList = (PRIV_OC_LIST *) (Writer->Buffer + ListOffset);
+  ImageList->Array.AllocCount = Count;
+  ImageList->Array.Construct  = NULL;
+  ImageList->Array.Destruct   = NULL;
+  SerializedImageSetPointer (Writer, ListOffset + OFFSET_OF (PRIV_OC_ARRAY, Values), ValuesOffset);
+
+  if (IsMap) {
+    ImageList->Map.KeyConstruct = NULL;
+    ImageList->Map.KeyDestruct  = NULL;
+    SerializedImageSetPointer (Writer, ListOffset + OFFSET_OF (PRIV_OC_MAP, Keys), KeysOffset);
+  }
+}
+
+STATIC
+VOID
+SerializedImageWriteNode (
+  IN OUT SERIALIZED_IMAGE_WRITER  *Writer,
+  IN     UINT32                   ObjectOffset,
+  IN     VOID                     *Object,
+  IN     OC_SCHEMA                *Schema
+  )
+{
+  SERIALIZED_KIND  Kind;
+
+  Kind = SerializedKind (Schema);
+
+  switch (Kind) {
+    case SERIALIZED_KIND_DICT:
+      SerializedImageWriteDict (Writer, ObjectOffset, Object, &Schema->Info.Dict);
+      break;
+    case SERIALIZED_KIND_VALUE:
+      break;
+    case SERIALIZED_KIND_BLOB:
+      SerializedImageWriteBlob (
+        Writer,
+        (UINT32) (ObjectOffset + Schema->Info.Blob.Field),
+        OC_SCHEMA_FIELD (Object, PRIV_OC_BLOB, Schema->Info.Blob.Field)
+        );
+      break;
+    case SERIALIZED_KIND_ARRAY:
+    case SERIALIZED_KIND_MAP:
+      SerializedImageWriteList (
+        Writer,
+        (UINT32) (ObjectOffset + Schema->Info.List.Field),
+        OC_SCHEMA_FIELD (Object, PRIV_OC_LIST, Schema->Info.List.Field),
+        Schema->Info.List.Schema,
+        Kind == SERIALIZED_KIND_MAP
+        );
+      break;
+    default:
+      DEBUG ((DEBUG_INFO, "OCS: Cannot serialize custom schema %a\n", Schema->Name));
+      Writer->Failed = TRUE;
+      break;
+  }
+}
+
+STATIC
+VOID
+SerializedImageWriteDict (
+  IN OUT SERIALIZED_IMAGE_WRITER  *Writer,
+  IN     UINT32                   ObjectOffset,
+  IN     VOID                     *Object,
+  IN     OC_SCHEMA_DICT           *Dict
+  )
+{
+  UINT32  Index;
+
+  for (Index = 0; Index < Dict->SchemaSize; ++Index) {
+    SerializedImageWriteNode (Writer, ObjectOffset, Object, &Dict->Schema[Index]);
+  }
+}
+
+VOID *
+CompileSerializedImage (
+  VOID            *Serialized,
+  UINT32          SerializedSize,
+  OC_SCHEMA_INFO  *RootSchema,
+  CONST UINT8     *SourceDigest,
+  UINT32          *ImageSize
+  )
+{
+  SERIALIZED_IMAGE_WRITER     Writer;
+  OC_SERIALIZED_IMAGE_HEADER  *Header;
+  UINT32                      RootOffset;
+
+  ZeroMem (&Writer, sizeof (Writer));
+
+  SerializedImageAppend (&Writer, NULL, sizeof (*Header));
+  RootOffset = SerializedImageAppend (&Writer, Serialized, SerializedSize);
+  SerializedImageWriteDict (&Writer, RootOffset, Serialized, &RootSchema->Dict);
+
+  if (Writer.Failed) {
+    DEBUG ((DEBUG_INFO, "OCS: Failed to create serialized image\n"));
+    if (Writer.Buffer != NULL) {
+      FreePool (Writer.Buffer);
+    }
+    return NULL;
+  }
+
+  Header             = (OC_SERIALIZED_IMAGE_HEADER *) Writer.Buffer;
+  Header->Signature  = OC_SERIALIZED_IMAGE_SIGNATURE;
+  Header->Version    = OC_SERIALIZED_IMAGE_VERSION;
+  Header->Size       = Writer.Size;
+  Header->SchemaHash = SerializedImageSchemaHash (RootSchema);
+  Header->RootOffset = RootOffset;
+  Header->RootSize   = SerializedSize;
+  CopyMem (Header->SourceDigest, SourceDigest, sizeof (Header->SourceDigest));
+
+  *ImageSize = Writer.Size;
+  return Writer.Buffer;
+}
+
+STATIC
+BOOLEAN
+SerializedImageMapRegion (
+  IN OUT SERIALIZED_IMAGE_MAPPER  *Mapper,
+  IN OUT VOID                     **Slot,
+  IN     UINT32                   Size
+  )
+{
+  UINTN  Offset;
+
+  Offset = (UINTN) *Slot;
+
+  if (Offset < Mapper->Next
+    || Offset > Mapper->Size
+    || Size > Mapper->Size - Offset
+    || !OC_POT_ALIGNED (sizeof (UINT64), Offset)) {
+    return FALSE;
+  }
+
+  *Slot        = Mapper->Image + Offset;
+  Mapper->Next = (UINT32) (Offset + Size);
+  return TRUE;
+}
+
+STATIC
+BOOLEAN
+SerializedImageMapDict (
+  IN OUT SERIALIZED_IMAGE_MAPPER  *Mapper,
+  IN     VOID                     *Object,
+  IN     VOID                     *Template,
+  IN     OC_SCHEMA_DICT           *Dict
+  );
+
+STATIC
+BOOLEAN
+SerializedImageMapBlob (
+  IN OUT SERIALIZED_IMAGE_MAPPER  *Mapper,
+  IN     PRIV_OC_BLOB             *Blob,
+  IN     PRIV_OC_BLOB             *Template
+  )
+{
+  if (Blob->MaxSize != Template->MaxSize) {
+    return FALSE;
+  }
+
+  if (Blob->DynValue == NULL) {
+    return Blob->Size <= Blob->MaxSize;
+  }
+
+  return Blob->Size > Blob->MaxSize
+    && SerializedImageMapRegion (Mapper, (VOID **) &Blob->DynValue, Blob->Size);
+}
+
+STATIC
+BOOLEAN
+SerializedImageMapNode (
+  IN OUT SERIALIZED_IMAGE_MAPPER  *Mapper,
+  IN     VOID                     *Object,
+  IN     VOID                     *Template,
+  IN     OC_SCHEMA                *Schema
+  );
+
+STATIC
+BOOLEAN
+SerializedImageMapList (
+  IN OUT SERIALIZED_IMAGE_MAPPER  *Mapper,
+  IN     PRIV_OC_LIST             *List,
+  IN     PRIV_OC_LIST             *Template,
+  IN     OC_SCHEMA                *EntrySchema,
+  IN     BOOLEAN                  IsMap
+  )
+{
+  UINT32   Count;
+  UINT32   TableSize;
+  UINT32   Index;
+  VOID     *TemplateValue;
+  VOID     *TemplateKey;
+  BOOLEAN  Result;
+
+  //
+  // Entry and key sizes come from the image, and are only trusted
+  // when they match the constructed container.
+  //
+  if (List->Array.ValueSize != Template->Array.ValueSize
+    || (IsMap && List->Map.KeySize != Template->Map.KeySize)) {
+    return FALSE;
+  }
+
+  //
+  // Mapped containers reference image memory, they are read-only
+  // and must never free it. OcListEntryAllocate refuses to insert into
+  // containers without a constructor.
+  //
+  List->Array.Construct = NULL;
+  List->Array.Destruct  = OcDestructEmpty;
+  if (IsMap) {
+    List->Map.KeyConstruct = NULL;
+    List->Map.KeyDestruct  = OcDestructEmpty;
+  }
+
+  Count = List->Array.Count;
+
+  if (Count != List->Array.AllocCount) {
+    return FALSE;
+  }
+
+  if (Count == 0) {
+    return List->Array.Values == NULL && (!IsMap || List->Map.Keys == NULL);
+  }
+
+  if (OcOverflowMulU32 (Count, sizeof (VOID *), &TableSize)
+    || !SerializedImageMapRegion (Mapper, (VOID **) &List->Array.Values, TableSize)
+    || (IsMap && !SerializedImageMapRegion (Mapper, (VOID **) &List->Map.Keys, TableSize))) {
+    return FALSE;
+  }
+
+  //
+  // Entries and keys are checked against freshly constructed ones.
+  //
+  TemplateValue = AllocatePool (Template->Array.ValueSize);
+  if (TemplateValue == NULL) {
+    return FALSE;
+  }
+
+  TemplateKey = NULL;
+  if (IsMap) {
+    TemplateKey = AllocatePool (Template->Map.KeySize);
+    if (TemplateKey == NULL) {
+      FreePool (TemplateValue);
+      return FALSE;
+    }
+    Template->Map.KeyConstruct (TemplateKey, Template->Map.KeySize);
+  }
+
+  Template->Array.Construct (TemplateValue, Template->Array.ValueSize);
+
+  Result = TRUE;
+  for (Index = 0; Index < Count && Result; ++Index) {
+    Result = SerializedImageMapRegion (Mapper, (VOID **) &List->Array.Values[Index], List->Array.ValueSize)
+      && SerializedImageMapNode (Mapper, List->Array.Values[Index], TemplateValue, EntrySchema);
+
+    if (Result && IsMap) {
+      Result = SerializedImageMapRegion (Mapper, (VOID **) &List->Map.Keys[Index], List->Map.KeySize)
+        && SerializedImageMapBlob (Mapper, List->Map.Keys[Index], TemplateKey);
+    }
+  }
+
+  Template->Array.Destruct (TemplateValue, Template->Array.ValueSize);
+  FreePool (TemplateValue);
+
+  if (IsMap) {
+    Template->Map.KeyDestruct (TemplateKey, Template->Map.KeySize);
+    FreePool (TemplateKey);
+  }
+
+  return Result;
+}
+
+STATIC
+BOOLEAN
+SerializedImageMapNode (
+  IN OUT SERIALIZED_IMAGE_MAPPER  *Mapper,
+  IN     VOID                     *Object,
+  IN     VOID                     *Template,
+  IN     OC_SCHEMA                *Schema
+  )
+{
+  SERIALIZED_KIND  Kind;
+
+  Kind = SerializedKind (Schema);
+
+  switch (Kind) {
+    case SERIALIZED_KIND_DICT:
+      return SerializedImageMapDict (Mapper, Object, Template, &Schema->Info.Dict);
+    case SERIALIZED_KIND_VALUE:
+      return TRUE;
+    case SERIALIZED_KIND_BLOB:
+      return SerializedImageMapBlob (
+        Mapper,
+        OC_SCHEMA_FIELD (Object, PRIV_OC_BLOB, Schema->Info.Blob.Field),
+        OC_SCHEMA_FIELD (Template, PRIV_OC_BLOB, Schema->Info.Blob.Field)
+        );
+    case SERIALIZED_KIND_ARRAY:
+    case SERIALIZED_KIND_MAP:
+      return SerializedImageMapList (
+        Mapper,
+        OC_SCHEMA_FIELD (Object, PRIV_OC_LIST, Schema->Info.List.Field),
+        OC_SCHEMA_FIELD (Template, PRIV_OC_LIST, Schema->Info.List.Field),
+        Schema->Info.List.Schema,
+        Kind == SERIALIZED_KIND_MAP
+        );
+    default:
+      return FALSE;
+  }
+}
+
+STATIC
+BOOLEAN
+SerializedImageMapDict (
+  IN OUT SERIALIZED_IMAGE_MAPPER  *Mapper,
+  IN     VOID                     *Object,
+  IN     VOID                     *Template,
+  IN     OC_SCHEMA_DICT           *Dict
+  )
+{
+  UINT32  Index;
+
+  for (Index = 0; Index < Dict->SchemaSize; ++Index) {
+    if (!SerializedImageMapNode (Mapper, Object, Template, &Dict->Schema[Index])) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+BOOLEAN
+MapSerializedImage (
+  VOID            *Serialized,
+  UINT32          SerializedSize,
+  OC_SCHEMA_INFO  *RootSchema,
+  CONST UINT8     *SourceDigest,
+  VOID            *Image,
+  UINT32          ImageSize
+  )
+{
+  OC_SERIALIZED_IMAGE_HEADER  *Header;
+  SERIALIZED_IMAGE_MAPPER     Mapper;
+  VOID                        *Root;
+
+  Header = Image;
+
+  if (!OC_POT_ALIGNED (sizeof (UINT64), Image)
+    || ImageSize < sizeof (*Header)
+    || Header->Signature != OC_SERIALIZED_IMAGE_SIGNATURE
+    || Header->Version != OC_SERIALIZED_IMAGE_VERSION
+    || Header->Size != ImageSize
+    || Header->RootOffset != sizeof (*Header)
+    || Header->RootSize != SerializedSize
+    || SerializedSize > ImageSize - Header->RootOffset) {
+    DEBUG ((DEBUG_INFO, "OCS: Unsupported serialized image\n"));
+    return FALSE;
+  }
+
+  if (Header->SchemaHash != SerializedImageSchemaHash (RootSchema)) {
+    DEBUG ((DEBUG_INFO, "OCS: Serialized image schema mismatch\n"));
+    return FALSE;
+  }
+
+  if (CompareMem (Header->SourceDigest, SourceDigest, sizeof (Header->SourceDigest)) != 0) {
+    DEBUG ((DEBUG_INFO, "OCS: Serialized image is stale\n"));
+    return FALSE;
+  }
+
+  Mapper.Image = Image;
+  Mapper.Size  = ImageSize;
+  Mapper.Next  = Header->RootOffset + Header->RootSize;
+
+  Root = (UINT8 *) Image + Header->RootOffset;
+  //
+  // Constructed Serialized describes the expected container layout.
+  //
+  if (!SerializedImageMapDict (&Mapper, Root, Serialized, &RootSchema->Dict)) {
+    DEBUG ((DEBUG_INFO, "OCS: Corrupted serialized image\n"));
+    return FALSE;
+  }
+
+  CopyMem (Serialized, Root, SerializedSize);
   return TRUE;
 }
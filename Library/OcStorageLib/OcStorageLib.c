@@ -106,7 +106,6 @@ OcStorageInitializeVault (
   return EFI_SUCCESS;
 }
 
-STATIC
 UINT8 *
 OcStorageGetDigest (
   IN OUT OC_STORAGE_CONTEXT  *Context,
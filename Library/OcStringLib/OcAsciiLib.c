@@ -130,3 +130,27 @@ AsciiUint64ToLowerHex (
   return TRUE;
 }
 
+
+UINT32
+AsciiStrHash (
+  IN  CONST CHAR8  *String,
+  OUT UINTN        *Length  OPTIONAL
+  )
+{
+  CONST CHAR8  *Walker;
+  UINT32       Hash;
+
+  ASSERT (String != NULL);
+
+  Hash = 2166136261U;
+  for (Walker = String; *Walker != '\0'; ++Walker) {
+    Hash ^= (UINT8) *Walker;
+    Hash *= 16777619U;
+  }
+
+  if (Length != NULL) {
+    *Length = (UINTN) (Walker - String);
+  }
+
+  return Hash;
+}
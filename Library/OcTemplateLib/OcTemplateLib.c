@@ -23,22 +23,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Library/MemoryAllocationLib.h>
 #include <Library/OcGuardLib.h>
 
-#define PRIV_OC_BLOB_FIELDS(_, __) \
-  OC_BLOB (CHAR8, [], {0}, _, __)
-  OC_DECLARE (PRIV_OC_BLOB)
-
-#define PRIV_OC_MAP_FIELDS(_, __) \
-  OC_MAP (PRIV_OC_BLOB, PRIV_OC_BLOB, _, __)
-  OC_DECLARE (PRIV_OC_MAP)
-
-#define PRIV_OC_ARRAY_FIELDS(_, __) \
-  OC_ARRAY (PRIV_OC_BLOB, _, __)
-  OC_DECLARE (PRIV_OC_ARRAY)
-
-typedef union PRIV_OC_LIST_ {
-  PRIV_OC_MAP    Map;
-  PRIV_OC_ARRAY  Array;
-} PRIV_OC_LIST;
+#include "OcTemplateLibInternal.h"
 
 //
 // We have to be a bit careful about this hack, so assert that type layouts match at the very least.
@@ -201,6 +186,14 @@ OcListEntryAllocate (
 
   List = (PRIV_OC_LIST *) Pointer;
 
+  //
+  // Containers without a constructor are read-only, e.g. mapped serialized images.
+  //
+  if (List->Array.Construct == NULL) {
+    DEBUG ((DEBUG_VERBOSE, "Refusing to insert into read-only list %p\n", List));
+    return FALSE;
+  }
+
   //
   // Prepare new pair.
   //
@@ -0,0 +1,45 @@
+/** @file
+
+Private data of OcTemplateLib, shared with OcSerializeLib.
+
+Copyright (c) 2018, vit9696
+
+All rights reserved.
+
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef OC_TEMPLATE_LIB_INTERNAL_H
+#define OC_TEMPLATE_LIB_INTERNAL_H
+
+#include <Library/OcTemplateLib.h>
+
+//
+// Type-erased views of OC_BLOB, OC_MAP, and OC_ARRAY containers
+// for code working with arbitrary containers.
+//
+#define PRIV_OC_BLOB_FIELDS(_, __) \
+  OC_BLOB (CHAR8, [], {0}, _, __)
+  OC_DECLARE (PRIV_OC_BLOB)
+
+#define PRIV_OC_MAP_FIELDS(_, __) \
+  OC_MAP (PRIV_OC_BLOB, PRIV_OC_BLOB, _, __)
+  OC_DECLARE (PRIV_OC_MAP)
+
+#define PRIV_OC_ARRAY_FIELDS(_, __) \
+  OC_ARRAY (PRIV_OC_BLOB, _, __)
+  OC_DECLARE (PRIV_OC_ARRAY)
+
+typedef union PRIV_OC_LIST_ {
+  PRIV_OC_MAP    Map;
+  PRIV_OC_ARRAY  Array;
+} PRIV_OC_LIST;
+
+#endif // OC_TEMPLATE_LIB_INTERNAL_H
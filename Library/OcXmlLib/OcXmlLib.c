@@ -47,15 +47,33 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Library/OcMiscLib.h>
 #include <Library/OcStringLib.h>
 
+//
+// Absent ID or IDREF attribute value.
+//
+#define XML_NO_REFERENCE MAX_UINT32
+
 //
 // Minimal extra allocation size during export.
 //
 #define XML_EXPORT_MIN_ALLOCATION_SIZE 4096
 
+//
+// Word-at-a-time byte matching. XML_SWAR_HAS_LESS is non-zero when a word
+// may contain a byte below Value, which may not exceed 128.
+//
+#define XML_SWAR_ONES  0x0101010101010101ULL
+#define XML_SWAR_HIGHS 0x8080808080808080ULL
+#define XML_SWAR_HAS_LESS(Word, Value) \
+  (((Word) - XML_SWAR_ONES * (Value)) & ~(Word) & XML_SWAR_HIGHS)
+#define XML_SWAR_HAS_BYTE(Word, Value) \
+  XML_SWAR_HAS_LESS ((Word) ^ (XML_SWAR_ONES * (UINT8) (Value)), 1)
+
 struct XML_NODE_LIST_;
+struct XML_NODE_LAZY_;
 struct XML_PARSER_;
 
 typedef struct XML_NODE_LIST_ XML_NODE_LIST;
+typedef struct XML_NODE_LAZY_ XML_NODE_LAZY;
 typedef struct XML_PARSER_ XML_PARSER;
 
 //
@@ -68,11 +86,25 @@ struct XML_NODE_ {
   CONST CHAR8    *Content;
   XML_NODE       *Real;
   XML_NODE_LIST  *Children;
+  //
+  // Arena the node and its children are allocated from, NULL for pool.
+  //
+  OC_ARENA       *Arena;
+  //
+  // Unparsed children deferred by XmlDocumentParseLazy, NULL otherwise.
+  //
+  XML_NODE_LAZY  *Lazy;
 };
 
 struct XML_NODE_LIST_ {
   UINT32    NodeCount;
   UINT32    AllocCount;
+  //
+  // Lazily built plist dictionary key lookup index, see PlistDictFind.
+  // Slots contain key/value pair index + 1, and 0 for empty slots.
+  //
+  UINT32    *DictIndex;
+  UINT32    DictIndexMask;
   XML_NODE  *NodeList[];
 };
 
@@ -82,6 +114,18 @@ typedef struct {
   XML_NODE      **RefList;
 } XML_REFLIST;
 
+//
+// Children of a lazy node are kept as the original text, which stays
+// untouched until the node is materialised on first access.
+//
+struct XML_NODE_LAZY_ {
+  XML_DOCUMENT  *Document;
+  XML_REFLIST   *References;
+  CHAR8         *Buffer;
+  UINT32        Length;
+  UINT32        Level;
+};
+
 //
 // An XML_DOCUMENT simply contains the root node and the underlying buffer.
 //
@@ -93,16 +137,29 @@ struct XML_DOCUMENT_ {
 
   XML_NODE      *Root;
   XML_REFLIST   References;
+  //
+  // Arena for document nodes when parsed with XmlDocumentParseArena.
+  //
+  OC_ARENA      Arena;
+  //
+  // Set when a lazy node failed to materialise, the document is incomplete.
+  //
+  BOOLEAN       LazyFailed;
 };
 
 //
 // Parser context.
 //
 struct XML_PARSER_ {
-  CHAR8  *Buffer;
-  UINT32 Position;
-  UINT32 Length;
-  UINT32 Level;
+  CHAR8    *Buffer;
+  UINT32   Position;
+  UINT32   Length;
+  UINT32   Level;
+  OC_ARENA *Arena;
+  //
+  // Document to defer nested containers for, NULL to parse everything.
+  //
+  XML_DOCUMENT *LazyDocument;
 };
 
 //
@@ -133,42 +190,87 @@ PlistNodeTypes[PLIST_NODE_TYPE_MAX] = {
 };
 
 
+//
+// Parses ID and IDREF attribute values out of the attribute list, which
+// ends at Length bytes or at the terminating zero. Absent or malformed
+// values are set to XML_NO_REFERENCE, and other attributes are ignored.
+//
 STATIC
-BOOLEAN
-XmlParseAttributeNumber (
+VOID
+XmlParseReferences (
   CONST CHAR8  *Attributes,
-  CONST CHAR8  *Argument,
-  UINT32       ArgumentLength,
-  UINT32       *ArgumentValue
+  UINT32       Length,
+  UINT32       *Id,
+  UINT32       *IdRef
   )
 {
-  CONST CHAR8  *ArgumentStart;
-  CONST CHAR8  *ArgumentEnd;
-  UINTN        Number;
-  CHAR8        NumberStr[16];
+  UINT32  Index;
+  UINT32  NameStart;
+  UINT32  NameLength;
+  UINT32  Number;
+  UINT32  *Value;
+  CHAR8   Quote;
 
-  //
-  // FIXME: This may give false positives.
-  //
+  *Id    = XML_NO_REFERENCE;
+  *IdRef = XML_NO_REFERENCE;
 
-  ArgumentStart = AsciiStrStr (Attributes, Argument);
-  if (ArgumentStart == NULL) {
-    return FALSE;
-  }
+  Index = 0;
+  while (TRUE) {
+    while (Index < Length && IsAsciiSpace (Attributes[Index])) {
+      ++Index;
+    }
 
-  ArgumentStart += ArgumentLength;
-  ArgumentEnd   = AsciiStrStr (ArgumentStart, "\"");
-  Number        = ArgumentEnd - ArgumentStart;
+    NameStart = Index;
+    while (Index < Length && Attributes[Index] != '\0'
+      && Attributes[Index] != '=' && !IsAsciiSpace (Attributes[Index])) {
+      ++Index;
+    }
 
-  if (ArgumentEnd == NULL || Number > sizeof (NumberStr) - 1) {
-    return FALSE;
-  }
+    NameLength = Index - NameStart;
+    if (NameLength == 0 || Length - Index < 2 || Attributes[Index] != '=') {
+      return;
+    }
+
+    Quote = Attributes[Index + 1];
+    if (Quote != '"' && Quote != '\'') {
+      return;
+    }
 
-  CopyMem (&NumberStr, ArgumentStart, Number);
-  NumberStr[Number] = '\0';
-  *ArgumentValue = (UINT32) AsciiStrDecimalToUint64 (NumberStr);
+    Value = NULL;
+    if (NameLength == L_STR_LEN ("ID")
+      && CompareMem (&Attributes[NameStart], "ID", L_STR_LEN ("ID")) == 0) {
+      Value = Id;
+    } else if (NameLength == L_STR_LEN ("IDREF")
+      && CompareMem (&Attributes[NameStart], "IDREF", L_STR_LEN ("IDREF")) == 0) {
+      Value = IdRef;
+    }
 
-  return TRUE;
+    //
+    // References above the limit are kept as is to be rejected later.
+    //
+    Number = 0;
+    for (Index += 2; Index < Length && Attributes[Index] != Quote; ++Index) {
+      if (Attributes[Index] == '\0') {
+        return;
+      }
+
+      if (Attributes[Index] < '0' || Attributes[Index] > '9') {
+        Value = NULL;
+      } else if (Number < XML_PARSER_MAX_REFERENCE_COUNT) {
+        Number = Number * 10 + (Attributes[Index] - '0');
+      }
+    }
+
+    if (Index == Length) {
+      return;
+    }
+
+    if (Value != NULL && Index > NameStart + NameLength + 2) {
+      *Value = Number;
+    }
+
+    ++Index;
+  }
 }
 
 //
@@ -177,6 +279,7 @@ XmlParseAttributeNumber (
 STATIC
 XML_NODE *
 XmlNodeCreate (
+  OC_ARENA       *Arena,
   CONST CHAR8    *Name,
   CONST CHAR8    *Attributes,
   CONST CHAR8    *Content,
@@ -186,7 +289,11 @@ XmlNodeCreate (
 {
   XML_NODE  *Node;
 
-  Node = AllocatePool (sizeof (XML_NODE));
+  if (Arena != NULL) {
+    Node = OcArenaAllocate (Arena, sizeof (XML_NODE));
+  } else {
+    Node = AllocatePool (sizeof (XML_NODE));
+  }
 
   if (Node != NULL) {
     Node->Name       = Name;
@@ -194,11 +301,31 @@ XmlNodeCreate (
     Node->Content    = Content;
     Node->Real       = Real;
     Node->Children   = Children;
+    Node->Arena      = Arena;
+    Node->Lazy       = NULL;
   }
 
   return Node;
 }
 
+//
+// Releases plist dictionary index of the node if any.
+//
+STATIC
+VOID
+XmlNodeDropDictIndex (
+  XML_NODE  *Node
+  )
+{
+  if (Node->Children != NULL && Node->Children->DictIndex != NULL) {
+    if (Node->Arena == NULL) {
+      FreePool (Node->Children->DictIndex);
+    }
+    Node->Children->DictIndex     = NULL;
+    Node->Children->DictIndexMask = 0;
+  }
+}
+
 //
 // Adds child nodes to node.
 //
@@ -223,6 +350,11 @@ XmlNodeChildPush (
     NodeCount = Node->Children->NodeCount;
     AllocCount = Node->Children->AllocCount;
 
+    //
+    // Dictionary index is rebuilt on next lookup.
+    //
+    XmlNodeDropDictIndex (Node);
+
     if (NodeCount < XML_PARSER_NODE_COUNT && AllocCount > NodeCount) {
       Node->Children->NodeList[NodeCount] = Child;
       Node->Children->NodeCount++;
@@ -243,16 +375,25 @@ XmlNodeChildPush (
   //
   AllocCount *= 3;
 
-  NewList = (XML_NODE_LIST *) AllocatePool (
-    sizeof (XML_NODE_LIST) + sizeof (NewList->NodeList[0]) * AllocCount
-    );
+  if (Node->Arena != NULL) {
+    NewList = (XML_NODE_LIST *) OcArenaAllocate (
+      Node->Arena,
+      sizeof (XML_NODE_LIST) + sizeof (NewList->NodeList[0]) * AllocCount
+      );
+  } else {
+    NewList = (XML_NODE_LIST *) AllocatePool (
+      sizeof (XML_NODE_LIST) + sizeof (NewList->NodeList[0]) * AllocCount
+      );
+  }
 
   if (NewList == NULL) {
     return FALSE;
   }
 
-  NewList->NodeCount  = NodeCount + 1;
-  NewList->AllocCount = AllocCount;
+  NewList->NodeCount     = NodeCount + 1;
+  NewList->AllocCount    = AllocCount;
+  NewList->DictIndex     = NULL;
+  NewList->DictIndexMask = 0;
 
   if (Node->Children != NULL) {
     CopyMem (
@@ -261,7 +402,9 @@ XmlNodeChildPush (
       sizeof (NewList->NodeList[0]) * NodeCount
       );
 
-    FreePool (Node->Children);
+    if (Node->Arena == NULL) {
+      FreePool (Node->Children);
+    }
   }
 
   NewList->NodeList[NodeCount] = Child;
@@ -316,32 +459,39 @@ XmlPushReference (
   return TRUE;
 }
 
+STATIC
+BOOLEAN
+XmlNodeMaterialize (
+  XML_NODE  *Node
+  );
+
 STATIC
 XML_NODE *
 XmlNodeReal (
   XML_REFLIST  *References,
-  CONST CHAR8  *Attributes
+  UINT32       Number
   )
 {
-  BOOLEAN      HasArgument;
-  UINT32       Number;
+  XML_NODE     *Node;
 
-  if (References == NULL || Attributes == NULL) {
+  if (References == NULL || Number >= References->RefCount) {
     return NULL;
   }
 
-  HasArgument = XmlParseAttributeNumber (
-    Attributes,
-    "IDREF=\"",
-    L_STR_LEN ("IDREF=\""),
-    &Number
-    );
+  //
+  // References defined within lazy nodes point to these nodes until they are
+  // materialised, which in turn may defer the reference to a nested node.
+  //
+  Node = References->RefList[Number];
+  while (Node != NULL && Node->Lazy != NULL) {
+    if (!XmlNodeMaterialize (Node) || References->RefList[Number] == Node) {
+      return NULL;
+    }
 
-  if (!HasArgument || Number >= References->RefCount) {
-    return NULL;
+    Node = References->RefList[Number];
   }
 
-  return References->RefList[Number];
+  return Node;
 }
 
 //
@@ -355,10 +505,18 @@ XmlNodeFree (
 {
   UINT32  Index;
 
+  //
+  // Arena nodes only have arena children and are freed with the document.
+  //
+  if (Node->Arena != NULL) {
+    return;
+  }
+
   if (Node->Children != NULL) {
     for (Index = 0; Index < Node->Children->NodeCount; ++Index) {
       XmlNodeFree (Node->Children->NodeList[Index]);
     }
+    XmlNodeDropDictIndex (Node);
     FreePool (Node->Children);
   }
 
@@ -537,6 +695,58 @@ XmlSkipWhitespace (
   }
 }
 
+//
+// Returns the position of the first byte starting from Position, which is
+// either First, Second, or whitespace when Space is TRUE, or Length if none.
+// Aligned words without candidate bytes are skipped at once, and the others
+// are checked byte by byte, so the result does not depend on byte order.
+//
+STATIC
+UINT32
+XmlScanBytes (
+  CONST CHAR8  *Buffer,
+  UINT32       Position,
+  UINT32       Length,
+  CHAR8        First,
+  CHAR8        Second,
+  BOOLEAN      Space
+  )
+{
+  UINT64  Word;
+  UINT64  Mask;
+  UINT32  Limit;
+  CHAR8   Current;
+
+  while (Position < Length) {
+    Limit = Position + 1;
+
+    if (((UINTN) &Buffer[Position] & (sizeof (UINT64) - 1)) == 0
+      && Length - Position >= sizeof (UINT64)) {
+      Word = *(CONST UINT64 *) &Buffer[Position];
+      Mask = XML_SWAR_HAS_BYTE (Word, First) | XML_SWAR_HAS_BYTE (Word, Second);
+      if (Space) {
+        Mask |= XML_SWAR_HAS_LESS (Word, ' ' + 1);
+      }
+
+      if (Mask == 0) {
+        Position += sizeof (UINT64);
+        continue;
+      }
+
+      Limit = Position + sizeof (UINT64);
+    }
+
+    for (; Position < Limit; ++Position) {
+      Current = Buffer[Position];
+      if (Current == First || Current == Second || (Space && IsAsciiSpace (Current))) {
+        return Position;
+      }
+    }
+  }
+
+  return Length;
+}
+
 //
 // Parses the name out of the an XML tag's ending.
 //
@@ -560,32 +770,30 @@ XmlParseTagEnd (
 
   XML_PARSER_INFO (Parser, "tag_end");
 
-  Current = XmlParserPeek (Parser, CURRENT_CHARACTER);
   Start = Parser->Position;
 
   //
   // Parse until `>' or a whitespace is reached.
   //
-  while (Start + Length < Parser->Length) {
-    if (('/' == Current) || ('>' == Current)) {
-      break;
-    }
+  Parser->Position = XmlScanBytes (Parser->Buffer, Start, Parser->Length, '/', '>', TRUE);
 
-    if (NameLength == 0 && IsAsciiSpace (Current)) {
-      NameLength = Length;
+  if (Parser->Position < Parser->Length && IsAsciiSpace (Parser->Buffer[Parser->Position])) {
+    NameLength = Parser->Position - Start;
 
-      if (NameLength == 0) {
-        XML_PARSER_ERROR (Parser, CURRENT_CHARACTER, "XmlParseTagEnd::expected tag name");
-        return NULL;
-      }
+    if (NameLength == 0) {
+      XML_PARSER_ERROR (Parser, CURRENT_CHARACTER, "XmlParseTagEnd::expected tag name");
+      return NULL;
     }
 
-    XmlParserConsume (Parser, 1);
-    Length++;
-
-    Current = XmlParserPeek (Parser, CURRENT_CHARACTER);
+    //
+    // Attributes follow the name until `>'.
+    //
+    Parser->Position = XmlScanBytes (Parser->Buffer, Parser->Position, Parser->Length, '/', '>', FALSE);
   }
 
+  Length  = Parser->Position - Start;
+  Current = XmlParserPeek (Parser, CURRENT_CHARACTER);
+
   //
   // Handle attributes.
   //
@@ -766,7 +974,6 @@ XmlParseContent (
 {
   UINTN  Start;
   UINTN  Length;
-  CHAR8  Current;
 
   XML_PARSER_INFO(Parser, "content");
 
@@ -776,21 +983,12 @@ XmlParseContent (
   XmlSkipWhitespace (Parser);
 
   Start = Parser->Position;
-  Length = 0;
 
   //
   // Consume until `<' is reached.
   //
-  while (Start + Length < Parser->Length) {
-    Current = XmlParserPeek (Parser, CURRENT_CHARACTER);
-
-    if ('<' == Current) {
-      break;
-    } else {
-      XmlParserConsume (Parser, 1);
-      Length++;
-    }
-  }
+  Parser->Position = XmlScanBytes (Parser->Buffer, Parser->Position, Parser->Length, '<', '<', FALSE);
+  Length = Parser->Position - Start;
 
   //
   // Next character must be an `<' or we have reached end of file.
@@ -817,6 +1015,8 @@ XmlParseContent (
 
 //
 // Prints to growing buffer always preserving one byte extra.
+// When Buffer is NULL only CurrentSize is updated, which allows to
+// estimate the exported size without writing anything.
 //
 STATIC
 VOID
@@ -831,15 +1031,29 @@ XmlBufferAppend (
   CHAR8   *NewBuffer;
   UINT32  NewSize;
 
-  NewSize = *AllocSize;
+  if (*Buffer == NULL) {
+    if (OcOverflowAddU32 (*CurrentSize, DataLength, CurrentSize)) {
+      *CurrentSize = MAX_UINT32;
+    }
+    return;
+  }
 
-  if (NewSize - *CurrentSize <= DataLength) {
-    if (DataLength + 1 <= XML_EXPORT_MIN_ALLOCATION_SIZE) {
-      NewSize += XML_EXPORT_MIN_ALLOCATION_SIZE;
-    } else {
-      NewSize += DataLength + 1;
+  if (*AllocSize - *CurrentSize <= DataLength) {
+    //
+    // Grow geometrically, so that the total amount of copying stays
+    // linear in the exported size.
+    //
+    if (OcOverflowTriAddU32 (*CurrentSize, DataLength, 1, &NewSize)) {
+      XML_USAGE_ERROR ("XmlBufferAppend::size overflow");
+      return;
+    }
+
+    if (*AllocSize <= MAX_UINT32 / 2) {
+      NewSize = MAX (NewSize, *AllocSize * 2);
     }
 
+    NewSize = MAX (NewSize, XML_EXPORT_MIN_ALLOCATION_SIZE);
+
     NewBuffer = AllocatePool (NewSize);
     if (NewBuffer == NULL) {
       XML_USAGE_ERROR("XmlBufferAppend::failed to allocate");
@@ -872,6 +1086,13 @@ XmlNodeExportRecursive (
   UINT32  Index;
   UINT32  NameLength;
 
+  //
+  // Lazy nodes are copied verbatim unless their children are skipped into.
+  //
+  if (Skip != 0 && Node->Lazy != NULL) {
+    XmlNodeMaterialize (Node);
+  }
+
   if (Skip != 0) {
     if (Node->Children != NULL) {
       for (Index = 0; Index < Node->Children->NodeCount; ++Index) {
@@ -892,10 +1113,12 @@ XmlNodeExportRecursive (
     XmlBufferAppend (Buffer, AllocSize, CurrentSize, Node->Attributes, (UINT32)AsciiStrLen (Node->Attributes));
   }
 
-  if (Node->Children != NULL || Node->Content != NULL) {
+  if (Node->Children != NULL || Node->Content != NULL || Node->Lazy != NULL) {
     XmlBufferAppend (Buffer, AllocSize, CurrentSize, ">", L_STR_LEN (">"));
 
-    if (Node->Children != NULL) {
+    if (Node->Lazy != NULL) {
+      XmlBufferAppend (Buffer, AllocSize, CurrentSize, Node->Lazy->Buffer, Node->Lazy->Length);
+    } else if (Node->Children != NULL) {
       for (Index = 0; Index < Node->Children->NodeCount; ++Index) {
         XmlNodeExportRecursive (Node->Children->NodeList[Index], Buffer, AllocSize, CurrentSize, 0);
       }
@@ -911,6 +1134,185 @@ XmlNodeExportRecursive (
   }
 }
 
+//
+// Registers the reference defined by an opening tag in the original document
+// text to resolve through Lazy node. Like XmlParseNode, only nodes without
+// child nodes may define references.
+//
+STATIC
+BOOLEAN
+XmlSourcePushReference (
+  CONST CHAR8  *Source,
+  UINT32       Length,
+  UINT32       TagStart,
+  UINT32       TagEnd,
+  XML_REFLIST  *References,
+  XML_NODE     *Lazy
+  )
+{
+  UINT32  Position;
+  UINT32  Number;
+  UINT32  RealNumber;
+
+  //
+  // Attributes are separated from the tag name by whitespace.
+  //
+  Position = XmlScanBytes (Source, TagStart, TagEnd, '>', '>', TRUE);
+  if (Position == TagEnd) {
+    return TRUE;
+  }
+
+  XmlParseReferences (&Source[Position], TagEnd - Position, &Number, &RealNumber);
+  if (Number == XML_NO_REFERENCE) {
+    return TRUE;
+  }
+
+  Position = TagEnd + 1;
+  while (Position < Length && IsAsciiSpace (Source[Position])) {
+    ++Position;
+  }
+
+  if (Length - Position >= 2 && Source[Position] == '<' && Source[Position + 1] != '/') {
+    return TRUE;
+  }
+
+  return XmlPushReference (References, Lazy, Number);
+}
+
+//
+// Skips a complete node in the original document text starting at its
+// opening `<' and returns the offset right past its closing tag or 0.
+// When References are given, references defined within the node are
+// registered to resolve through Lazy node.
+//
+STATIC
+UINT32
+XmlSourceSkipNode (
+  CONST CHAR8  *Source,
+  UINT32       Length,
+  UINT32       Position,
+  XML_REFLIST  *References  OPTIONAL,
+  XML_NODE     *Lazy        OPTIONAL
+  )
+{
+  UINT32   Level;
+  UINT32   TagStart;
+  BOOLEAN  Closing;
+  BOOLEAN  Control;
+  CHAR8    Quote;
+
+  Level = 0;
+
+  do {
+    //
+    // Text content never contains `<', skip to the next tag.
+    //
+    Position = XmlScanBytes (Source, Position, Length, '<', '<', FALSE);
+
+    if (Length - Position < 2) {
+      return 0;
+    }
+
+    ++Position;
+    TagStart = Position;
+    Closing  = Source[Position] == '/';
+    Control  = Source[Position] == '?' || Source[Position] == '!';
+
+    //
+    // Find `>' ignoring the ones in quoted attribute values.
+    //
+    Quote = '\0';
+    while (Position < Length && (Quote != '\0' || Source[Position] != '>')) {
+      if (Quote != '\0') {
+        if (Source[Position] == Quote) {
+          Quote = '\0';
+        }
+      } else if (Source[Position] == '"' || Source[Position] == '\'') {
+        Quote = Source[Position];
+      }
+      ++Position;
+    }
+
+    if (Position == Length) {
+      return 0;
+    }
+
+    if (Closing) {
+      if (Level == 0) {
+        return 0;
+      }
+      --Level;
+    } else if (!Control && Source[Position - 1] != '/') {
+      if (References != NULL
+        && !XmlSourcePushReference (Source, Length, TagStart, Position, References, Lazy)) {
+        return 0;
+      }
+      ++Level;
+    }
+
+    ++Position;
+  } while (Level > 0);
+
+  return Position;
+}
+
+//
+// Defers parsing of nested plist dictionaries and arrays in lazy mode by
+// recording their children as unparsed text. Parser is moved to the closing
+// tag of such nodes, and other nodes are left intact.
+//
+STATIC
+BOOLEAN
+XmlParseLazy (
+  XML_PARSER   *Parser,
+  XML_REFLIST  *References,
+  XML_NODE     *Node
+  )
+{
+  XML_NODE_LAZY  *Lazy;
+  UINT32         Position;
+
+  if (Parser->LazyDocument == NULL
+    || Parser->Level <= XML_PARSER_LAZY_LEVEL
+    || Node->Attributes != NULL
+    || '/' == XmlParserPeek (Parser, NEXT_CHARACTER)
+    || (AsciiStrCmp (Node->Name, PlistNodeTypes[PLIST_NODE_TYPE_DICT]) != 0
+      && AsciiStrCmp (Node->Name, PlistNodeTypes[PLIST_NODE_TYPE_ARRAY]) != 0)) {
+    return TRUE;
+  }
+
+  Lazy = OcArenaAllocate (Parser->Arena, sizeof (XML_NODE_LAZY));
+  if (Lazy == NULL) {
+    return FALSE;
+  }
+
+  Position = Parser->Position;
+  do {
+    Position = XmlSourceSkipNode (Parser->Buffer, Parser->Length, Position, References, Node);
+    if (Position == 0) {
+      return FALSE;
+    }
+
+    while (Position < Parser->Length && IsAsciiSpace (Parser->Buffer[Position])) {
+      ++Position;
+    }
+
+    if (Parser->Length - Position < 2) {
+      return FALSE;
+    }
+  } while (Parser->Buffer[Position] != '<' || Parser->Buffer[Position + 1] != '/');
+
+  Lazy->Document   = Parser->LazyDocument;
+  Lazy->References = References;
+  Lazy->Buffer     = &Parser->Buffer[Parser->Position];
+  Lazy->Length     = Position - Parser->Position;
+  Lazy->Level      = Parser->Level;
+
+  Node->Lazy       = Lazy;
+  Parser->Position = Position;
+  return TRUE;
+}
+
 //
 // Parses an XML fragment node.
 //
@@ -939,6 +1341,7 @@ XmlParseNode (
   XML_NODE     *Node;
   XML_NODE     *Child;
   UINT32       ReferenceNumber;
+  UINT32       RealNumber;
   BOOLEAN      IsReference;
   BOOLEAN      SelfClosing;
   BOOLEAN      Unprefixed;
@@ -964,7 +1367,16 @@ XmlParseNode (
 
   XmlSkipWhitespace (Parser);
 
-  Node = XmlNodeCreate (TagOpen, Attributes, NULL, XmlNodeReal (References, Attributes), NULL);
+  //
+  // Reference attributes are parsed once and resolved by index.
+  //
+  ReferenceNumber = XML_NO_REFERENCE;
+  RealNumber      = XML_NO_REFERENCE;
+  if (References != NULL && Attributes != NULL) {
+    XmlParseReferences (Attributes, MAX_UINT32, &ReferenceNumber, &RealNumber);
+  }
+
+  Node = XmlNodeCreate (Parser->Arena, TagOpen, Attributes, NULL, XmlNodeReal (References, RealNumber), NULL);
   if (Node == NULL) {
     XML_PARSER_ERROR (Parser, NO_CHARACTER, "XmlParseNode::node alloc fail");
     return NULL;
@@ -992,14 +1404,7 @@ XmlParseNode (
     //
     // All references must be defined sequentially.
     //
-    if (References != NULL && Node->Attributes != NULL) {
-      IsReference = XmlParseAttributeNumber (
-        Node->Attributes,
-        "ID=\"",
-        L_STR_LEN ("ID=\""),
-        &ReferenceNumber
-        );
-    }
+    IsReference = ReferenceNumber != XML_NO_REFERENCE;
 
     Unprefixed = TRUE;
 
@@ -1017,7 +1422,13 @@ XmlParseNode (
 
     HasChildren = FALSE;
 
-    while ('/' != XmlParserPeek (Parser, NEXT_CHARACTER)) {
+    if (!XmlParseLazy (Parser, References, Node)) {
+      XML_PARSER_ERROR (Parser, NO_CHARACTER, "XmlParseNode::lazy");
+      XmlNodeFree (Node);
+      return NULL;
+    }
+
+    while (Node->Lazy == NULL && '/' != XmlParserPeek (Parser, NEXT_CHARACTER)) {
 
       //
       // Parse child node.
@@ -1047,13 +1458,8 @@ XmlParseNode (
 
     Parser->Level--;
 
-    if (!HasChildren && References != NULL && Attributes != NULL) {
-      IsReference = XmlParseAttributeNumber (
-        Node->Attributes,
-        "ID=\"",
-        L_STR_LEN ("ID=\""),
-        &ReferenceNumber
-        );
+    if (!HasChildren) {
+      IsReference = ReferenceNumber != XML_NO_REFERENCE;
     }
   }
 
@@ -1085,16 +1491,113 @@ XmlParseNode (
   return Node;
 }
 
-XML_DOCUMENT *
-XmlDocumentParse (
-  CHAR8    *Buffer,
-  UINT32   Length,
-  BOOLEAN  WithRefs
-  )
-{
-  XML_NODE      *Root;
-  XML_DOCUMENT  *Document;
-  XML_REFLIST   References;
+//
+// Parses the children of a lazy node. Failures leave the node empty and
+// mark the document incomplete, as its text is already modified.
+//
+STATIC
+BOOLEAN
+XmlNodeMaterialize (
+  XML_NODE  *Node
+  )
+{
+  XML_NODE_LAZY  *Lazy;
+  XML_NODE       *Child;
+  XML_PARSER     Parser;
+
+  //
+  // Drop the lazy state first to never parse the same text twice.
+  //
+  Lazy       = Node->Lazy;
+  Node->Lazy = NULL;
+
+  ZeroMem (&Parser, sizeof (Parser));
+  Parser.Buffer       = Lazy->Buffer;
+  Parser.Length       = Lazy->Length;
+  Parser.Level        = Lazy->Level;
+  Parser.Arena        = Node->Arena;
+  Parser.LazyDocument = Lazy->Document;
+
+  while (TRUE) {
+    XmlSkipWhitespace (&Parser);
+    if (Parser.Position == Parser.Length) {
+      return TRUE;
+    }
+
+    Child = XmlParseNode (&Parser, Lazy->References);
+    if (Child == NULL || !XmlNodeChildPush (Node, Child)) {
+      XML_PARSER_ERROR (&Parser, NO_CHARACTER, "XmlNodeMaterialize::child");
+      Node->Children             = NULL;
+      Lazy->Document->LazyFailed = TRUE;
+      return FALSE;
+    }
+  }
+}
+
+//
+// Estimates arena chunk size for the document nodes. Every node takes at
+// least one tag, and most nodes take two.
+//
+STATIC
+UINTN
+XmlArenaChunkSize (
+  CONST CHAR8  *Buffer,
+  UINT32       Length
+  )
+{
+  UINT32  Index;
+  UINTN   TagCount;
+  UINT64  Word;
+
+  TagCount = 0;
+  Index    = 0;
+
+  while (Index < Length
+    && (((UINTN) &Buffer[Index] & (sizeof (UINT64) - 1)) != 0 || Length - Index < sizeof (UINT64))) {
+    if (Buffer[Index] == '<') {
+      ++TagCount;
+    }
+    ++Index;
+  }
+
+  //
+  // Count `<' a word at a time. Unlike XML_SWAR_HAS_BYTE this marks exactly
+  // the matching bytes, so their number is summed with a multiplication.
+  //
+  for (; Length - Index >= sizeof (UINT64); Index += sizeof (UINT64)) {
+    Word      = *(CONST UINT64 *) &Buffer[Index] ^ (XML_SWAR_ONES * '<');
+    Word      = ~(((Word & ~XML_SWAR_HIGHS) + ~XML_SWAR_HIGHS) | Word) & XML_SWAR_HIGHS;
+    TagCount += (UINTN) (((Word >> 7U) * XML_SWAR_ONES) >> 56U);
+  }
+
+  for (; Index < Length; ++Index) {
+    if (Buffer[Index] == '<') {
+      ++TagCount;
+    }
+  }
+
+  //
+  // Account for the node itself and its pointer in the parent child list,
+  // but do not exceed the size of the document twice for malformed input.
+  //
+  return MIN (
+    (TagCount / 2 + 1) * (sizeof (XML_NODE) + 2 * sizeof (XML_NODE *)),
+    (UINTN) Length * 2
+    );
+}
+
+STATIC
+XML_DOCUMENT *
+XmlDocumentParseInternal (
+  CHAR8    *Buffer,
+  UINT32   Length,
+  BOOLEAN  WithRefs,
+  BOOLEAN  WithArena,
+  BOOLEAN  WithLazy
+  )
+{
+  XML_NODE      *Root;
+  XML_DOCUMENT  *Document;
 
   //
   // Initialize parser.
@@ -1103,7 +1606,6 @@ XmlDocumentParse (
   ZeroMem (&Parser, sizeof (Parser));
   Parser.Buffer = Buffer;
   Parser.Length = Length;
-  ZeroMem (&References, sizeof (References));
 
   //
   // An empty buffer can never contain a valid document.
@@ -1113,35 +1615,89 @@ XmlDocumentParse (
     return NULL;
   }
 
+  //
+  // Document is allocated first as it owns the arena nodes come from,
+  // and the references lazy nodes resolve through.
+  //
+  Document = AllocateZeroPool (sizeof (XML_DOCUMENT));
+  if (Document == NULL) {
+    XML_PARSER_ERROR (&Parser, NO_CHARACTER, "XmlDocumentParse::document allocation failed");
+    return NULL;
+  }
+
+  if (WithArena) {
+    OcArenaInit (&Document->Arena, XmlArenaChunkSize (Buffer, Length));
+    Parser.Arena = &Document->Arena;
+
+    if (WithLazy) {
+      Parser.LazyDocument = Document;
+    }
+  }
+
   //
   // Parse the root node.
   //
-  Root = XmlParseNode (&Parser, WithRefs ? &References : NULL);
+  Root = XmlParseNode (&Parser, WithRefs ? &Document->References : NULL);
   if (Root == NULL) {
     XML_PARSER_ERROR (&Parser, NO_CHARACTER, "XmlDocumentParse::parsing document failed");
+    XmlFreeRefs (&Document->References);
+    OcArenaFree (&Document->Arena);
+    FreePool (Document);
     return NULL;
   }
 
   //
   // Return parsed document.
   //
-  Document = AllocatePool (sizeof(XML_DOCUMENT));
-
-  if (Document == NULL) {
-    XML_PARSER_ERROR (&Parser, NO_CHARACTER, "XmlDocumentParse::document allocation failed");
-    XmlNodeFree (Root);
-    XmlFreeRefs (&References);
-    return NULL;
-  }
-
   Document->Buffer.Buffer = Buffer;
   Document->Buffer.Length = Length;
   Document->Root = Root;
-  CopyMem (&Document->References, &References, sizeof (References));
 
   return Document;
 }
 
+XML_DOCUMENT *
+XmlDocumentParse (
+  CHAR8    *Buffer,
+  UINT32   Length,
+  BOOLEAN  WithRefs
+  )
+{
+  return XmlDocumentParseInternal (Buffer, Length, WithRefs, FALSE, FALSE);
+}
+
+XML_DOCUMENT *
+XmlDocumentParseArena (
+  CHAR8    *Buffer,
+  UINT32   Length,
+  BOOLEAN  WithRefs
+  )
+{
+  return XmlDocumentParseInternal (Buffer, Length, WithRefs, TRUE, FALSE);
+}
+
+XML_DOCUMENT *
+XmlDocumentParseLazy (
+  CHAR8    *Buffer,
+  UINT32   Length,
+  BOOLEAN  WithRefs
+  )
+{
+  return XmlDocumentParseInternal (Buffer, Length, WithRefs, TRUE, TRUE);
+}
+
+CONST OC_ARENA_STATS *
+XmlDocumentArenaStats (
+  XML_DOCUMENT  *Document
+  )
+{
+  if (Document->Arena.ChunkSize == 0) {
+    return NULL;
+  }
+
+  return &Document->Arena.Stats;
+}
+
 CHAR8 *
 XmlDocumentExport (
   XML_DOCUMENT  *Document,
@@ -1163,6 +1719,12 @@ XmlDocumentExport (
   CurrentSize = 0;
   XmlNodeExportRecursive (Document->Root, &Buffer, &AllocSize, &CurrentSize, Skip);
 
+  if (Document->LazyFailed) {
+    XML_USAGE_ERROR ("XmlDocumentExport::incomplete document");
+    FreePool (Buffer);
+    return NULL;
+  }
+
   if (Length != NULL) {
     *Length = CurrentSize;
   }
@@ -1175,6 +1737,138 @@ XmlDocumentExport (
   return Buffer;
 }
 
+BOOLEAN
+XmlDocumentExportInto (
+  XML_DOCUMENT  *Document,
+  CHAR8         *Buffer,
+  UINT32        BufferSize,
+  UINT32        *Length,
+  UINT32        Skip
+  )
+{
+  CHAR8   *SizeBuffer;
+  UINT32  CurrentSize;
+
+  //
+  // Estimate the size first, as caller buffer cannot grow.
+  //
+  SizeBuffer  = NULL;
+  CurrentSize = 0;
+  XmlNodeExportRecursive (Document->Root, &SizeBuffer, &BufferSize, &CurrentSize, Skip);
+
+  *Length = CurrentSize;
+
+  if (Document->LazyFailed) {
+    XML_USAGE_ERROR ("XmlDocumentExportInto::incomplete document");
+    return FALSE;
+  }
+
+  if (Buffer == NULL || CurrentSize >= BufferSize) {
+    return FALSE;
+  }
+
+  CurrentSize = 0;
+  XmlNodeExportRecursive (Document->Root, &Buffer, &BufferSize, &CurrentSize, Skip);
+  Buffer[CurrentSize] = '\0';
+
+  return TRUE;
+}
+
+BOOLEAN
+XmlDocumentExportAppended (
+  XML_DOCUMENT  *Document,
+  CONST CHAR8   *Source,
+  XML_NODE      *Node,
+  UINT32        ParsedCount,
+  CHAR8         *Buffer,
+  UINT32        BufferSize,
+  UINT32        *Length
+  )
+{
+  XML_NODE  *LastChild;
+  CHAR8     *SizeBuffer;
+  UINT32    AppendedSize;
+  UINT32    SourceLength;
+  UINT32    Position;
+  UINT32    NameLength;
+  UINT32    CurrentSize;
+  UINT32    Index;
+
+  *Length = 0;
+
+  if (Node->Children == NULL || ParsedCount == 0 || ParsedCount > Node->Children->NodeCount) {
+    XML_USAGE_ERROR ("XmlDocumentExportAppended::no parsed children");
+    return FALSE;
+  }
+
+  //
+  // Section data may be padded with zeroes, which must go after the splice.
+  //
+  SourceLength = Document->Buffer.Length;
+  while (SourceLength > 0 && Source[SourceLength - 1] == '\0') {
+    --SourceLength;
+  }
+
+  //
+  // Parsed names point right past `<' of their opening tags, so the end of
+  // the last parsed child is where its closing tag is found in the source.
+  //
+  LastChild = Node->Children->NodeList[ParsedCount - 1];
+  if (LastChild->Name <= Document->Buffer.Buffer
+    || LastChild->Name >= Document->Buffer.Buffer + SourceLength) {
+    XML_USAGE_ERROR ("XmlDocumentExportAppended::child is not parsed");
+    return FALSE;
+  }
+
+  Position = (UINT32) (LastChild->Name - Document->Buffer.Buffer) - 1;
+  if (Source[Position] != '<') {
+    XML_USAGE_ERROR ("XmlDocumentExportAppended::source mismatch");
+    return FALSE;
+  }
+
+  Position = XmlSourceSkipNode (Source, SourceLength, Position, NULL, NULL);
+  while (Position > 0 && Position < SourceLength && IsAsciiSpace (Source[Position])) {
+    ++Position;
+  }
+
+  NameLength = (UINT32) AsciiStrLen (Node->Name);
+  if (Position == 0
+    || SourceLength - Position < NameLength + L_STR_LEN ("</>")
+    || Source[Position] != '<'
+    || Source[Position + 1] != '/'
+    || AsciiStrnCmp (&Source[Position + 2], Node->Name, NameLength) != 0
+    || (Source[Position + 2 + NameLength] != '>' && !IsAsciiSpace (Source[Position + 2 + NameLength]))) {
+    XML_USAGE_ERROR ("XmlDocumentExportAppended::closing tag not found");
+    return FALSE;
+  }
+
+  SizeBuffer   = NULL;
+  AppendedSize = 0;
+  for (Index = ParsedCount; Index < Node->Children->NodeCount; ++Index) {
+    XmlNodeExportRecursive (Node->Children->NodeList[Index], &SizeBuffer, &BufferSize, &AppendedSize, 0);
+  }
+
+  if (OcOverflowAddU32 (SourceLength, AppendedSize, Length)) {
+    *Length = MAX_UINT32;
+  }
+
+  if (Buffer == NULL || *Length >= BufferSize) {
+    return FALSE;
+  }
+
+  CopyMem (Buffer, Source, Position);
+
+  CurrentSize = Position;
+  for (Index = ParsedCount; Index < Node->Children->NodeCount; ++Index) {
+    XmlNodeExportRecursive (Node->Children->NodeList[Index], &Buffer, &BufferSize, &CurrentSize, 0);
+  }
+
+  CopyMem (&Buffer[CurrentSize], &Source[Position], SourceLength - Position);
+  Buffer[*Length] = '\0';
+
+  return TRUE;
+}
+
 VOID
 XmlDocumentFree (
   XML_DOCUMENT  *Document
@@ -1182,6 +1876,7 @@ XmlDocumentFree (
 {
   XmlNodeFree (Document->Root);
   XmlFreeRefs (&Document->References);
+  OcArenaFree (&Document->Arena);
   FreePool (Document);
 }
 
@@ -1214,6 +1909,10 @@ XmlNodeChildren (
   XML_NODE  *Node
   )
 {
+  if (Node->Lazy != NULL) {
+    XmlNodeMaterialize (Node);
+  }
+
   return Node->Children ? Node->Children->NodeCount : 0;
 }
 
@@ -1223,6 +1922,10 @@ XmlNodeChild (
   UINT32    Child
   )
 {
+  if (Node->Lazy != NULL) {
+    XmlNodeMaterialize (Node);
+  }
+
   return Node->Children->NodeList[Child];
 }
 
@@ -1298,7 +2001,11 @@ XmlNodeAppend (
 {
   XML_NODE  *NewNode;
 
-  NewNode = XmlNodeCreate (Name, Attributes, Content, NULL, NULL);
+  if (Node->Lazy != NULL && !XmlNodeMaterialize (Node)) {
+    return NULL;
+  }
+
+  NewNode = XmlNodeCreate (Node->Arena, Name, Attributes, Content, NULL, NULL);
   if (NewNode == NULL) {
     return NULL;
   }
@@ -1354,6 +2061,230 @@ PlistDocumentRoot (
   return XmlNodeChild(Node, 0);
 }
 
+//
+// Plist event parser context.
+//
+typedef struct {
+  XML_PARSER           Parser;
+  PLIST_EVENT_HANDLER  Handler;
+  VOID                 *Context;
+  //
+  // Nest level of keys and values with tags inside, which are not reported.
+  //
+  UINT32               Muted;
+  //
+  // Set when Handler returned FALSE, which is not a parsing error.
+  //
+  BOOLEAN              Aborted;
+} PLIST_EVENT_PARSER;
+
+//
+// Reports an event unless it is nested in a key or value.
+//
+STATIC
+BOOLEAN
+PlistReportEvent (
+  PLIST_EVENT_PARSER  *EventParser,
+  PLIST_EVENT_TYPE    Type,
+  XML_NODE            *Node
+  )
+{
+  if (EventParser->Muted > 0) {
+    return TRUE;
+  }
+
+  if (!EventParser->Handler (EventParser->Context, Type, Node)) {
+    EventParser->Aborted = TRUE;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+//
+// Parses a plist node like XmlParseNode, but reports it instead of
+// allocating. Closing is set when a closing tag was found instead.
+//
+STATIC
+BOOLEAN
+PlistParseEventNode (
+  PLIST_EVENT_PARSER  *EventParser,
+  BOOLEAN             *Closing
+  )
+{
+  XML_PARSER        *Parser;
+  CONST CHAR8       *TagOpen;
+  CONST CHAR8       *TagClose;
+  CONST CHAR8       *Content;
+  XML_NODE          Node;
+  PLIST_EVENT_TYPE  Type;
+  BOOLEAN           IsContainer;
+  BOOLEAN           SelfClosing;
+  BOOLEAN           Unprefixed;
+  BOOLEAN           HasChildren;
+  BOOLEAN           ChildClosing;
+
+  Parser      = &EventParser->Parser;
+  Content     = NULL;
+  SelfClosing = FALSE;
+  Unprefixed  = FALSE;
+  HasChildren = FALSE;
+  *Closing    = FALSE;
+
+  TagOpen = XmlParseTagOpen (Parser, &SelfClosing, NULL);
+  if (TagOpen == NULL) {
+    *Closing = '/' == XmlParserPeek (Parser, CURRENT_CHARACTER);
+    return FALSE;
+  }
+
+  IsContainer = TRUE;
+  if (AsciiStrCmp (TagOpen, PlistNodeTypes[PLIST_NODE_TYPE_DICT]) == 0) {
+    Type = PLIST_EVENT_DICT_BEGIN;
+  } else if (AsciiStrCmp (TagOpen, PlistNodeTypes[PLIST_NODE_TYPE_ARRAY]) == 0) {
+    Type = PLIST_EVENT_ARRAY_BEGIN;
+  } else {
+    IsContainer = FALSE;
+    if (AsciiStrCmp (TagOpen, PlistNodeTypes[PLIST_NODE_TYPE_KEY]) == 0) {
+      Type = PLIST_EVENT_KEY;
+    } else {
+      Type = PLIST_EVENT_VALUE;
+    }
+  }
+
+  if (IsContainer && !PlistReportEvent (EventParser, Type, NULL)) {
+    return FALSE;
+  }
+
+  if (!SelfClosing) {
+    XmlSkipWhitespace (Parser);
+
+    if ('<' != XmlParserPeek (Parser, CURRENT_CHARACTER)) {
+      //
+      // Text in dictionaries and arrays is ignored like PlistNodeCast does.
+      //
+      Content = XmlParseContent (Parser);
+      if (Content == NULL) {
+        XML_PARSER_ERROR (Parser, 0, "PlistParseEventNode::content");
+        return FALSE;
+      }
+
+      Unprefixed = TRUE;
+    } else {
+      Parser->Level++;
+
+      if (Parser->Level > XML_PARSER_NEST_LEVEL) {
+        XML_PARSER_ERROR (Parser, NO_CHARACTER, "PlistParseEventNode::level overflow");
+        return FALSE;
+      }
+
+      //
+      // Tags in keys and values are skipped, and the value is reported
+      // without a node.
+      //
+      if (!IsContainer) {
+        EventParser->Muted++;
+      }
+
+      while ('/' != XmlParserPeek (Parser, NEXT_CHARACTER)) {
+        if (!PlistParseEventNode (EventParser, &ChildClosing)) {
+          if (EventParser->Aborted) {
+            return FALSE;
+          }
+
+          if (ChildClosing) {
+            Unprefixed = TRUE;
+            break;
+          }
+
+          XML_PARSER_ERROR (Parser, NEXT_CHARACTER, "PlistParseEventNode::child");
+          return FALSE;
+        }
+
+        HasChildren = TRUE;
+      }
+
+      if (!IsContainer) {
+        EventParser->Muted--;
+      }
+
+      Parser->Level--;
+    }
+
+    TagClose = XmlParseTagClose (Parser, Unprefixed);
+    if (TagClose == NULL || AsciiStrCmp (TagOpen, TagClose) != 0) {
+      XML_PARSER_ERROR (Parser, NO_CHARACTER, "PlistParseEventNode::tag close");
+      return FALSE;
+    }
+  }
+
+  if (IsContainer) {
+    return PlistReportEvent (EventParser, PLIST_EVENT_END, NULL);
+  }
+
+  ZeroMem (&Node, sizeof (Node));
+  Node.Name    = TagOpen;
+  Node.Content = Content;
+
+  return PlistReportEvent (EventParser, Type, HasChildren ? NULL : &Node);
+}
+
+BOOLEAN
+PlistParseEvents (
+  CHAR8                *Buffer,
+  UINT32               Length,
+  PLIST_EVENT_HANDLER  Handler,
+  VOID                 *Context
+  )
+{
+  PLIST_EVENT_PARSER  EventParser;
+  XML_PARSER          *Parser;
+  CONST CHAR8         *TagOpen;
+  CONST CHAR8         *TagClose;
+  BOOLEAN             SelfClosing;
+  BOOLEAN             Closing;
+
+  ZeroMem (&EventParser, sizeof (EventParser));
+  Parser              = &EventParser.Parser;
+  Parser->Buffer      = Buffer;
+  Parser->Length      = Length;
+  EventParser.Handler = Handler;
+  EventParser.Context = Context;
+
+  if (Length == 0 || Length > XML_PARSER_MAX_SIZE) {
+    XML_PARSER_ERROR (Parser, NO_CHARACTER, "PlistParseEvents::length is too small or too large");
+    return FALSE;
+  }
+
+  //
+  // Plist root must contain exactly one node like in PlistDocumentRoot.
+  //
+  SelfClosing = FALSE;
+  TagOpen = XmlParseTagOpen (Parser, &SelfClosing, NULL);
+  if (TagOpen == NULL || SelfClosing || AsciiStrCmp (TagOpen, "plist") != 0) {
+    XML_USAGE_ERROR ("PlistParseEvents::not plist root");
+    return FALSE;
+  }
+
+  Parser->Level++;
+
+  if (!PlistParseEventNode (&EventParser, &Closing)) {
+    if (EventParser.Aborted) {
+      return FALSE;
+    }
+
+    XML_PARSER_ERROR (Parser, NO_CHARACTER, "PlistParseEvents::no single first node");
+    return FALSE;
+  }
+
+  TagClose = XmlParseTagClose (Parser, FALSE);
+  if (TagClose == NULL || AsciiStrCmp (TagOpen, TagClose) != 0) {
+    XML_PARSER_ERROR (Parser, NO_CHARACTER, "PlistParseEvents::tag close");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 XML_NODE *
 PlistNodeCast (
   XML_NODE         *Node,
@@ -1428,6 +2359,112 @@ PlistDictChild (
   return XmlNodeChild (Node, Child);
 }
 
+//
+// Builds plist dictionary key lookup index, first key occurrence wins.
+//
+STATIC
+BOOLEAN
+PlistDictBuildIndex (
+  XML_NODE  *Node
+  )
+{
+  XML_NODE_LIST  *Children;
+  UINT32         *DictIndex;
+  UINT32         Count;
+  UINT32         Size;
+  UINT32         Index;
+  UINT32         Slot;
+  CONST CHAR8    *Key;
+
+  Children = Node->Children;
+  Count    = Children->NodeCount / 2;
+
+  //
+  // Keep the load factor at or below 50%.
+  //
+  Size = GetPowerOfTwo32 (Count) << 2U;
+
+  if (Node->Arena != NULL) {
+    DictIndex = OcArenaAllocateZero (Node->Arena, Size * sizeof (DictIndex[0]));
+  } else {
+    DictIndex = AllocateZeroPool (Size * sizeof (DictIndex[0]));
+  }
+
+  if (DictIndex == NULL) {
+    return FALSE;
+  }
+
+  for (Index = 0; Index < Count; ++Index) {
+    Key = PlistKeyValue (Children->NodeList[Index * 2]);
+    if (Key == NULL) {
+      continue;
+    }
+
+    Slot = AsciiStrHash (Key, NULL) & (Size - 1);
+    while (DictIndex[Slot] != 0
+      && AsciiStrCmp (PlistKeyValue (Children->NodeList[(DictIndex[Slot] - 1) * 2]), Key) != 0) {
+      Slot = (Slot + 1) & (Size - 1);
+    }
+
+    if (DictIndex[Slot] == 0) {
+      DictIndex[Slot] = Index + 1;
+    }
+  }
+
+  Children->DictIndex     = DictIndex;
+  Children->DictIndexMask = Size - 1;
+  return TRUE;
+}
+
+XML_NODE *
+PlistDictFind (
+  XML_NODE     *Node,
+  CONST CHAR8  *Key
+  )
+{
+  XML_NODE_LIST  *Children;
+  UINT32         Count;
+  UINT32         Index;
+  UINT32         Slot;
+  CONST CHAR8    *CurrentKey;
+
+  Count = PlistDictChildren (Node);
+  if (Count == 0) {
+    return NULL;
+  }
+
+  Children = Node->Children;
+
+  if (Children->DictIndex == NULL && Count >= XML_PLIST_DICT_INDEX_MIN_ENTRIES) {
+    PlistDictBuildIndex (Node);
+  }
+
+  if (Children->DictIndex != NULL) {
+    Slot = AsciiStrHash (Key, NULL) & Children->DictIndexMask;
+    while (Children->DictIndex[Slot] != 0) {
+      Index = (Children->DictIndex[Slot] - 1) * 2;
+      if (AsciiStrCmp (PlistKeyValue (Children->NodeList[Index]), Key) == 0) {
+        return Children->NodeList[Index + 1];
+      }
+      Slot = (Slot + 1) & Children->DictIndexMask;
+    }
+
+    return NULL;
+  }
+
+  //
+  // Small dictionaries and allocation failures fall back to linear lookup.
+  //
+  for (Index = 0; Index < Count; ++Index) {
+    CurrentKey = PlistKeyValue (Children->NodeList[Index * 2]);
+    if (CurrentKey != NULL && AsciiStrCmp (CurrentKey, Key) == 0) {
+      return Children->NodeList[Index * 2 + 1];
+    }
+  }
+
+  return NULL;
+}
+
 CONST CHAR8 *
 PlistKeyValue (
   XML_NODE  *Node
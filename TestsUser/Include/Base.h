@@ -75,6 +75,12 @@ typedef UINT64 EFI_PHYSICAL_ADDRESS;
 typedef UINT64 EFI_VIRTUAL_ADDRESS;
 typedef VOID *EFI_HANDLE;
 typedef VOID *EFI_EVENT;
+typedef UINTN EFI_TPL;
+
+#define TPL_APPLICATION  4
+#define TPL_CALLBACK     8
+#define TPL_NOTIFY       16
+#define TPL_HIGH_LEVEL   31
 typedef UINTN *BASE_LIST;
 typedef UINT64 EFI_LBA;
 
@@ -1686,6 +1692,13 @@ struct EFI_BOOT_SERVICES_ {
   EFI_STATUS (*GetMemoryMap) (UINTN *MemoryMapSize, EFI_MEMORY_DESCRIPTOR *MemoryMap, UINTN *MapKey, UINTN *DescriptorSize, UINT32 *DescriptorVersion);
   EFI_STATUS (*FreePool) (void *x);
   EFI_STATUS (*LocateDevicePath) (EFI_GUID *Protocol, EFI_DEVICE_PATH_PROTOCOL **DevicePath, EFI_HANDLE *Device);
+  EFI_TPL (*RaiseTPL) (EFI_TPL NewTpl);
+  VOID (*RestoreTPL) (EFI_TPL OldTpl);
+  EFI_STATUS (*CreateEvent) (UINT32 Type, EFI_TPL NotifyTpl, EFI_EVENT_NOTIFY NotifyFunction, VOID *NotifyContext, EFI_EVENT *Event);
+  EFI_STATUS (*WaitForEvent) (UINTN NumberOfEvents, EFI_EVENT *Event, UINTN *Index);
+  EFI_STATUS (*CloseEvent) (EFI_EVENT Event);
+  EFI_STATUS (*CheckEvent) (EFI_EVENT Event);
+  EFI_STATUS (*Stall) (UINTN Microseconds);
 };
 
 struct EFI_RUNTIME_SERVICES_ {
@@ -1755,6 +1768,33 @@ STATIC EFI_STATUS NilLocateDevicePath (EFI_GUID *Protocol, EFI_DEVICE_PATH_PROTO
   return EFI_UNSUPPORTED;
 }
 
+STATIC EFI_TPL NilRaiseTPL (EFI_TPL NewTpl) {
+  return TPL_APPLICATION;
+}
+
+STATIC VOID NilRestoreTPL (EFI_TPL OldTpl) {
+}
+
+STATIC EFI_STATUS NilCreateEvent (UINT32 Type, EFI_TPL NotifyTpl, EFI_EVENT_NOTIFY NotifyFunction, VOID *NotifyContext, EFI_EVENT *Event) {
+  return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_STATUS NilWaitForEvent (UINTN NumberOfEvents, EFI_EVENT *Event, UINTN *Index) {
+  return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_STATUS NilCloseEvent (EFI_EVENT Event) {
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS NilCheckEvent (EFI_EVENT Event) {
+  return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_STATUS NilStall (UINTN Microseconds) {
+  return EFI_SUCCESS;
+}
+
 extern EFI_STATUS NilInstallConfigurationTableCustom(EFI_GUID *Guid, VOID *Table);
 
 #ifndef CONFIG_TABLE_INSTALLER
@@ -1771,7 +1811,14 @@ STATIC EFI_BOOT_SERVICES gNilBS = {
   .InstallProtocolInterface = NilInstallProtocolInterface,
   .GetMemoryMap = NilGetMemoryMap,
   .FreePool = FreePool,
-  .LocateDevicePath = NilLocateDevicePath
+  .LocateDevicePath = NilLocateDevicePath,
+  .RaiseTPL = NilRaiseTPL,
+  .RestoreTPL = NilRestoreTPL,
+  .CreateEvent = NilCreateEvent,
+  .WaitForEvent = NilWaitForEvent,
+  .CloseEvent = NilCloseEvent,
+  .CheckEvent = NilCheckEvent,
+  .Stall = NilStall
 };
 
 STATIC EFI_BOOT_SERVICES *gBS = &gNilBS;
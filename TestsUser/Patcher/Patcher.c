@@ -0,0 +1,379 @@
+/** @file
+  Copyright (C) 2019, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Library/OcMiscLib.h>
+
+#include <sys/time.h>
+
+/*
+ clang -g -O3 -I../Include -I../../Include -I../../../MdePkg/Include/ -I../../../EfiPkg/Include/ -include ../Include/Base.h Patcher.c ../../Library/OcMiscLib/DataPatcher.c ../../Tests/KernelTest/Lilu.c -o Patcher
+
+ ./Patcher prelinkedkernel.unpack
+
+ Without arguments embedded Lilu binary is used.
+
+ rm -rf Patcher.dSYM Patcher
+*/
+
+extern UINT8 LiluKextData[];
+extern UINT32 LiluKextDataSize;
+
+long long current_timestamp() {
+    struct timeval te;
+    gettimeofday(&te, NULL); // get current time
+    long long milliseconds = te.tv_sec*1000LL + te.tv_usec/1000; // calculate milliseconds
+    // printf("milliseconds: %lld\n", milliseconds);
+    return milliseconds;
+}
+
+uint8_t *readFile(const char *str, uint32_t *size) {
+  FILE *f = fopen(str, "rb");
+
+  if (!f) return NULL;
+
+  fseek(f, 0, SEEK_END);
+  long fsize = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  uint8_t *string = malloc(fsize + 1);
+  fread(string, fsize, 1, f);
+  fclose(f);
+
+  string[fsize] = 0;
+  *size = fsize;
+
+  return string;
+}
+
+//
+// Original byte by byte FindPattern implementation used as a reference.
+//
+STATIC
+INT32
+LegacyFindPattern (
+  IN CONST UINT8   *Pattern,
+  IN CONST UINT8   *PatternMask OPTIONAL,
+  IN CONST UINT32  PatternSize,
+  IN CONST UINT8   *Data,
+  IN UINT32        DataSize,
+  IN INT32         DataOff
+  )
+{
+  BOOLEAN  Matches;
+  UINT32   Index;
+
+  if (PatternSize == 0 || DataSize == 0 || (DataOff < 0) || (UINT32)DataOff >= DataSize || DataSize - DataOff < PatternSize) {
+    return -1;
+  }
+
+  while (DataOff + PatternSize < DataSize) {
+    Matches = TRUE;
+    for (Index = 0; Index < PatternSize; ++Index) {
+      if ((PatternMask == NULL && Data[DataOff + Index] != Pattern[Index])
+      || (PatternMask != NULL && (Data[DataOff + Index] & PatternMask[Index]) != Pattern[Index])) {
+        Matches = FALSE;
+        break;
+      }
+    }
+
+    if (Matches) {
+      return DataOff;
+    }
+    ++DataOff;
+  }
+
+  return -1;
+}
+
+typedef struct {
+  CONST CHAR8  *Name;
+  CONST UINT8  *Pattern;
+  CONST UINT8  *PatternMask;
+  UINT32       PatternSize;
+} BENCH_PATTERN;
+
+STATIC CONST UINT8 mWrmsrE2[] = {
+  0xB9, 0xE2, 0x00, 0x00, 0x00,     // mov ecx, 0xe2
+  0x0F, 0x30                        // wrmsr
+};
+
+STATIC CONST UINT8 mWrmsrE2Mov[] = {
+  0xB9, 0xE2, 0x00, 0x00, 0x00,     // mov ecx, 0xe2
+  0x48, 0x89, 0xF0,                 // mov rax, <some register>
+  0x0F, 0x30                        // wrmsr
+};
+
+STATIC CONST UINT8 mWrmsrE2MovMask[] = {
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xF0,
+  0xFF, 0xFF
+};
+
+STATIC CONST UINT8 mPrologue[] = {
+  0x55,                             // push rbp
+  0x48, 0x89, 0xE5                  // mov rbp, rsp
+};
+
+STATIC CONST UINT8 mMissing[] = {
+  0x0F, 0x0B, 0xDE, 0xAD, 0xBE, 0xEF, 0x0F, 0x0B
+};
+
+STATIC CONST UINT8 mAnyCall[] = {
+  0xE8, 0x00, 0x00, 0x00, 0x00
+};
+
+STATIC CONST UINT8 mAnyCallMask[] = {
+  0xFF, 0x00, 0x00, 0x00, 0x00
+};
+
+STATIC CONST UINT8 mMaskedOnly[] = {
+  0x40, 0x80
+};
+
+STATIC CONST UINT8 mMaskedOnlyMask[] = {
+  0xF0, 0xF0
+};
+
+STATIC BENCH_PATTERN mPatterns[] = {
+  {"wrmsr e2",        mWrmsrE2,    NULL,            sizeof (mWrmsrE2)},
+  {"wrmsr e2 masked", mWrmsrE2Mov, mWrmsrE2MovMask, sizeof (mWrmsrE2Mov)},
+  {"prologue",        mPrologue,   NULL,            sizeof (mPrologue)},
+  {"missing",         mMissing,    NULL,            sizeof (mMissing)},
+  {"any call",        mAnyCall,    mAnyCallMask,    sizeof (mAnyCall)},
+  {"masked only",     mMaskedOnly, mMaskedOnlyMask, sizeof (mMaskedOnly)}
+};
+
+//
+// Overlapping patches: the first one writes the pattern of the second,
+// which in turn creates the pattern of the third.
+//
+STATIC CONST UINT8 mChainWrite[]   = {0x11, 0x22};
+STATIC CONST UINT8 mChainFind[]    = {0x11, 0x22};
+STATIC CONST UINT8 mChainReplace[] = {0x33, 0x44};
+STATIC CONST UINT8 mChainFind2[]   = {0x44, 0x55};
+STATIC CONST UINT8 mChainReplace2[] = {0x66, 0x77};
+
+STATIC
+BOOLEAN
+TestApplyPatches (
+  IN CONST CHAR8    *Name,
+  IN OC_DATA_PATCH  *Patches,
+  IN UINT32         NumPatches,
+  IN CONST UINT8    *Data,
+  IN UINT32         DataSize
+  )
+{
+  UINT8    *Legacy;
+  UINT8    *Current;
+  UINT32   *LegacyCounts;
+  UINT32   Index;
+  BOOLEAN  Result;
+
+  Legacy       = malloc (DataSize);
+  Current      = malloc (DataSize);
+  LegacyCounts = malloc (NumPatches * sizeof (*LegacyCounts));
+  if (Legacy == NULL || Current == NULL || LegacyCounts == NULL) {
+    abort ();
+  }
+
+  memcpy (Legacy, Data, DataSize);
+  memcpy (Current, Data, DataSize);
+
+  //
+  // Apply the patches one by one.
+  //
+  for (Index = 0; Index < NumPatches; ++Index) {
+    if (Patches[Index].Pattern == NULL) {
+      CopyMem (&Legacy[Patches[Index].DataOffset], Patches[Index].Replace, Patches[Index].PatternSize);
+      LegacyCounts[Index] = 1;
+      continue;
+    }
+
+    LegacyCounts[Index] = ApplyPatch (
+      Patches[Index].Pattern,
+      Patches[Index].PatternMask,
+      Patches[Index].PatternSize,
+      Patches[Index].Replace,
+      Patches[Index].ReplaceMask,
+      &Legacy[Patches[Index].DataOffset],
+      Patches[Index].DataSize,
+      Patches[Index].Count,
+      Patches[Index].Skip
+      );
+  }
+
+  ApplyPatches (Patches, NumPatches, Current, DataSize);
+
+  Result = memcmp (Legacy, Current, DataSize) == 0;
+  for (Index = 0; Index < NumPatches; ++Index) {
+    if (LegacyCounts[Index] != Patches[Index].ReplaceCount) {
+      printf("%s patch %u count mismatch - %u vs %u\n", Name, Index, LegacyCounts[Index], Patches[Index].ReplaceCount);
+      Result = FALSE;
+    }
+  }
+
+  printf("%s patches - %s\n", Name, Result ? "ok" : "data mismatch");
+
+  free(Legacy);
+  free(Current);
+  free(LegacyCounts);
+  return Result;
+}
+
+STATIC
+BOOLEAN
+TestPatches (
+  IN CONST UINT8  *Data,
+  IN UINT32       DataSize
+  )
+{
+  OC_DATA_PATCH  Patches[ARRAY_SIZE (mPatterns)];
+  UINT8          Chain[64];
+  UINT32         Index;
+  BOOLEAN        Result;
+
+  //
+  // Independent patches are applied at once, masked only pattern
+  // is skipped as it matches within the prologue.
+  //
+  ZeroMem (Patches, sizeof (Patches));
+  for (Index = 0; Index < ARRAY_SIZE (mPatterns) - 1; ++Index) {
+    Patches[Index].Pattern     = mPatterns[Index].Pattern;
+    Patches[Index].PatternMask = mPatterns[Index].PatternMask;
+    Patches[Index].Replace     = mMissing;
+    Patches[Index].PatternSize = mPatterns[Index].PatternSize;
+    Patches[Index].Count       = 1;
+    Patches[Index].DataSize    = DataSize;
+  }
+
+  Result = TestApplyPatches ("Independent", Patches, ARRAY_SIZE (mPatterns) - 1, Data, DataSize);
+
+  //
+  // Find-less patch followed by two overlapping ones.
+  //
+  ZeroMem (Chain, sizeof (Chain));
+  Chain[10] = 0x55;
+  Chain[40] = 0x11;
+  Chain[41] = 0x22;
+  Chain[42] = 0x55;
+
+  ZeroMem (Patches, sizeof (Patches));
+  Patches[0].Replace     = mChainWrite;
+  Patches[0].PatternSize = sizeof (mChainWrite);
+  Patches[0].DataOffset  = 8;
+  Patches[0].DataSize    = sizeof (mChainWrite);
+  Patches[1].Pattern     = mChainFind;
+  Patches[1].Replace     = mChainReplace;
+  Patches[1].PatternSize = sizeof (mChainFind);
+  Patches[1].DataSize    = sizeof (Chain);
+  Patches[2].Pattern     = mChainFind2;
+  Patches[2].Replace     = mChainReplace2;
+  Patches[2].PatternSize = sizeof (mChainFind2);
+  Patches[2].Count       = 1;
+  Patches[2].DataSize    = sizeof (Chain);
+
+  Result &= TestApplyPatches ("Overlapping", Patches, 3, Chain, sizeof (Chain));
+
+  return Result;
+}
+
+int main(int argc, char** argv) {
+  UINT8      *Data;
+  UINT32     DataSize;
+  UINT32     Index;
+  UINT32     Round;
+  UINT32     Rounds;
+  INT32      Offset;
+  UINT32     LegacyCount;
+  UINT32     Count;
+  long long  a;
+  long long  LegacyTime;
+  long long  Time;
+  int        Result;
+
+  if (argc > 1) {
+    if ((Data = readFile(argv[1], &DataSize)) == NULL) {
+      printf("Read fail\n");
+      return -1;
+    }
+    Rounds = 10;
+  } else {
+    Data     = LiluKextData;
+    DataSize = LiluKextDataSize;
+    Rounds   = 1000;
+  }
+
+  Result = 0;
+
+  for (Index = 0; Index < ARRAY_SIZE (mPatterns); ++Index) {
+    a = current_timestamp();
+    for (Round = 0; Round < Rounds; ++Round) {
+      LegacyCount = 0;
+      Offset      = 0;
+      while ((Offset = LegacyFindPattern (mPatterns[Index].Pattern, mPatterns[Index].PatternMask,
+        mPatterns[Index].PatternSize, Data, DataSize, Offset)) >= 0) {
+        ++LegacyCount;
+        ++Offset;
+      }
+    }
+    LegacyTime = current_timestamp() - a;
+
+    a = current_timestamp();
+    for (Round = 0; Round < Rounds; ++Round) {
+      Count  = 0;
+      Offset = 0;
+      while ((Offset = FindPattern (mPatterns[Index].Pattern, mPatterns[Index].PatternMask,
+        mPatterns[Index].PatternSize, Data, DataSize, Offset)) >= 0) {
+        ++Count;
+        ++Offset;
+      }
+    }
+    Time = current_timestamp() - a;
+
+    //
+    // Match offsets must be identical.
+    //
+    Offset = 0;
+    while (Offset >= 0) {
+      INT32 Legacy = LegacyFindPattern (mPatterns[Index].Pattern, mPatterns[Index].PatternMask,
+        mPatterns[Index].PatternSize, Data, DataSize, Offset);
+      INT32 Current = FindPattern (mPatterns[Index].Pattern, mPatterns[Index].PatternMask,
+        mPatterns[Index].PatternSize, Data, DataSize, Offset);
+      if (Legacy != Current) {
+        printf("%s mismatch at %d - %d vs %d\n", mPatterns[Index].Name, Offset, Legacy, Current);
+        Result = -1;
+        break;
+      }
+      Offset = Current < 0 ? -1 : Current + 1;
+    }
+
+    printf("%-16s %6u matches, legacy %llu ms, current %llu ms\n",
+      mPatterns[Index].Name, Count, LegacyTime, Time);
+
+    if (Count != LegacyCount) {
+      printf("%s count mismatch - %u vs %u\n", mPatterns[Index].Name, LegacyCount, Count);
+      Result = -1;
+    }
+  }
+
+  if (!TestPatches (Data, DataSize)) {
+    Result = -1;
+  }
+
+  if (Data != LiluKextData) {
+    free(Data);
+  }
+
+  return Result;
+}
@@ -18,21 +18,30 @@
 #include <Library/OcAppleKernelLib.h>
 
 #include <sys/time.h>
+#include <pthread.h>
+#include <unistd.h>
 
 /*
- clang -g -fsanitize=undefined,address -Wno-incompatible-pointer-types-discards-qualifiers -I../Include -I../../Include -I../../../MdePkg/Include/ -I../../../EfiPkg/Include/ -include ../Include/Base.h Prelinked.c ../../Library/OcXmlLib/OcXmlLib.c ../../Library/OcTemplateLib/OcTemplateLib.c ../../Library/OcSerializeLib/OcSerializeLib.c ../../Library/OcMiscLib/Base64Decode.c ../../Library/OcStringLib/OcAsciiLib.c ../../Library/OcMachoLib/CxxSymbols.c ../../Library/OcMachoLib/Header.c ../../Library/OcMachoLib/Relocations.c ../../Library/OcMachoLib/Symbols.c ../../Library/OcAppleKernelLib/PrelinkedContext.c ../../Library/OcAppleKernelLib/PrelinkedKext.c ../../Library/OcAppleKernelLib/KextPatcher.c ../../Library/OcMiscLib/DataPatcher.c ../../Library/OcAppleKernelLib/Link.c ../../Library/OcAppleKernelLib/Vtables.c ../../Library/OcAppleKernelLib/KernelReader.c ../../Library/OcCompressionLib/lzss/lzss.c ../../Library/OcCompressionLib/lzvn/lzvn.c ../../Tests/KernelTest/Lilu.c ../../Tests/KernelTest/Vsmc.c -o Prelinked
+ clang -g -fsanitize=undefined,address -Wno-incompatible-pointer-types-discards-qualifiers -I../Include -I../../Include -I../../../MdePkg/Include/ -I../../../EfiPkg/Include/ -include ../Include/Base.h Prelinked.c ../../Library/OcXmlLib/OcXmlLib.c ../../Library/OcTemplateLib/OcTemplateLib.c ../../Library/OcSerializeLib/OcSerializeLib.c ../../Library/OcMiscLib/Base64Decode.c ../../Library/OcStringLib/OcAsciiLib.c ../../Library/OcMachoLib/CxxSymbols.c ../../Library/OcMachoLib/Header.c ../../Library/OcMachoLib/Relocations.c ../../Library/OcMachoLib/Symbols.c ../../Library/OcAppleKernelLib/PrelinkedContext.c ../../Library/OcAppleKernelLib/PrelinkedKext.c ../../Library/OcAppleKernelLib/KextPatcher.c ../../Library/OcMiscLib/DataPatcher.c ../../Library/OcMiscLib/ArenaAllocator.c ../../Library/OcAppleKernelLib/Link.c ../../Library/OcAppleKernelLib/Vtables.c ../../Library/OcAppleKernelLib/SymbolCache.c ../../Library/OcAppleKernelLib/KernelReader.c ../../Library/OcCompressionLib/zlib/adler32.c ../../Library/OcCompressionLib/lzss/lzss.c ../../Library/OcCompressionLib/lzvn/lzvn.c ../../Tests/KernelTest/Lilu.c ../../Tests/KernelTest/Vsmc.c -o Prelinked
 
  for fuzzing:
- clang-mp-7.0 -DFUZZING_TEST=1 -g -fsanitize=undefined,address,fuzzer -Wno-incompatible-pointer-types-discards-qualifiers -I../Include -I../../Include -I../../../MdePkg/Include/ -I../../../EfiPkg/Include/ -include ../Include/Base.h Prelinked.c ../../Library/OcXmlLib/OcXmlLib.c ../../Library/OcTemplateLib/OcTemplateLib.c ../../Library/OcSerializeLib/OcSerializeLib.c ../../Library/OcMiscLib/Base64Decode.c ../../Library/OcStringLib/OcAsciiLib.c ../../Library/OcMachoLib/CxxSymbols.c ../../Library/OcMachoLib/Header.c ../../Library/OcMachoLib/Relocations.c ../../Library/OcMachoLib/Symbols.c ../../Library/OcAppleKernelLib/PrelinkedContext.c ../../Library/OcAppleKernelLib/PrelinkedKext.c ../../Library/OcAppleKernelLib/KextPatcher.c ../../Library/OcMiscLib/DataPatcher.c ../../Library/OcAppleKernelLib/Link.c ../../Library/OcAppleKernelLib/Vtables.c ../../Library/OcAppleKernelLib/KernelReader.c ../../Library/OcCompressionLib/lzss/lzss.c ../../Library/OcCompressionLib/lzvn/lzvn.c ../../Tests/KernelTest/Lilu.c ../../Tests/KernelTest/Vsmc.c -o Prelinked
+ clang-mp-7.0 -DFUZZING_TEST=1 -g -fsanitize=undefined,address,fuzzer -Wno-incompatible-pointer-types-discards-qualifiers -I../Include -I../../Include -I../../../MdePkg/Include/ -I../../../EfiPkg/Include/ -include ../Include/Base.h Prelinked.c ../../Library/OcXmlLib/OcXmlLib.c ../../Library/OcTemplateLib/OcTemplateLib.c ../../Library/OcSerializeLib/OcSerializeLib.c ../../Library/OcMiscLib/Base64Decode.c ../../Library/OcStringLib/OcAsciiLib.c ../../Library/OcMachoLib/CxxSymbols.c ../../Library/OcMachoLib/Header.c ../../Library/OcMachoLib/Relocations.c ../../Library/OcMachoLib/Symbols.c ../../Library/OcAppleKernelLib/PrelinkedContext.c ../../Library/OcAppleKernelLib/PrelinkedKext.c ../../Library/OcAppleKernelLib/KextPatcher.c ../../Library/OcMiscLib/DataPatcher.c ../../Library/OcMiscLib/ArenaAllocator.c ../../Library/OcAppleKernelLib/Link.c ../../Library/OcAppleKernelLib/Vtables.c ../../Library/OcAppleKernelLib/SymbolCache.c ../../Library/OcAppleKernelLib/KernelReader.c ../../Library/OcCompressionLib/zlib/adler32.c ../../Library/OcCompressionLib/lzss/lzss.c ../../Library/OcCompressionLib/lzvn/lzvn.c ../../Tests/KernelTest/Lilu.c ../../Tests/KernelTest/Vsmc.c -o Prelinked
  rm -rf DICT fuzz*.log ; mkdir DICT ; find /System/Library/Extensions/<< * >>/Contents/MacOS -type f -exec cp {} DICT \; UBSAN_OPTIONS='halt_on_error=1' ./Prelinked -jobs=4 DICT -rss_limit_mb=4096
 
  rm -rf Prelinked.dSYM DICT fuzz*.log Prelinked
 
- clang -DTEST_SLE=1 -g -O3 -fno-sanitize=undefined,address -Wno-incompatible-pointer-types-discards-qualifiers -I../Include -I../../Include -I../../../MdePkg/Include/ -I../../../EfiPkg/Include/ -include ../Include/Base.h Prelinked.c ../../Library/OcXmlLib/OcXmlLib.c ../../Library/OcTemplateLib/OcTemplateLib.c ../../Library/OcSerializeLib/OcSerializeLib.c ../../Library/OcMiscLib/Base64Decode.c ../../Library/OcStringLib/OcAsciiLib.c ../../Library/OcMachoLib/CxxSymbols.c ../../Library/OcMachoLib/Header.c ../../Library/OcMachoLib/Relocations.c ../../Library/OcMachoLib/Symbols.c ../../Library/OcAppleKernelLib/PrelinkedContext.c ../../Library/OcAppleKernelLib/PrelinkedKext.c ../../Library/OcAppleKernelLib/KextPatcher.c ../../Library/OcMiscLib/DataPatcher.c ../../Library/OcAppleKernelLib/Link.c ../../Library/OcAppleKernelLib/Vtables.c ../../Library/OcAppleKernelLib/KernelReader.c ../../Library/OcCompressionLib/lzss/lzss.c ../../Library/OcCompressionLib/lzvn/lzvn.c ../../Tests/KernelTest/Lilu.c ../../Tests/KernelTest/Vsmc.c  -o Prelinked
+ clang -DTEST_SLE=1 -g -O3 -fno-sanitize=undefined,address -Wno-incompatible-pointer-types-discards-qualifiers -I../Include -I../../Include -I../../../MdePkg/Include/ -I../../../EfiPkg/Include/ -include ../Include/Base.h Prelinked.c ../../Library/OcXmlLib/OcXmlLib.c ../../Library/OcTemplateLib/OcTemplateLib.c ../../Library/OcSerializeLib/OcSerializeLib.c ../../Library/OcMiscLib/Base64Decode.c ../../Library/OcStringLib/OcAsciiLib.c ../../Library/OcMachoLib/CxxSymbols.c ../../Library/OcMachoLib/Header.c ../../Library/OcMachoLib/Relocations.c ../../Library/OcMachoLib/Symbols.c ../../Library/OcAppleKernelLib/PrelinkedContext.c ../../Library/OcAppleKernelLib/PrelinkedKext.c ../../Library/OcAppleKernelLib/KextPatcher.c ../../Library/OcMiscLib/DataPatcher.c ../../Library/OcMiscLib/ArenaAllocator.c ../../Library/OcAppleKernelLib/Link.c ../../Library/OcAppleKernelLib/Vtables.c ../../Library/OcAppleKernelLib/SymbolCache.c ../../Library/OcAppleKernelLib/KernelReader.c ../../Library/OcCompressionLib/zlib/adler32.c ../../Library/OcCompressionLib/lzss/lzss.c ../../Library/OcCompressionLib/lzvn/lzvn.c ../../Tests/KernelTest/Lilu.c ../../Tests/KernelTest/Vsmc.c  -o Prelinked
 
  for i in /System/Library/Extensions/<< * >>.kext ; do plist=$i/Contents/Info.plist ; kext="$i/Contents/MacOS/$(/usr/libexec/PlistBuddy -c 'Print CFBundleExecutable' "$plist")" ; echo "$kext $plist" ; ./Prelinked prelinkedkernel.unpack "$kext" "$plist" ; done
 
  /[^\n]+\nPassed.kext injected - 0x8[^\n]+
+
+ PRELINK_INFO parsing with pool and arena DOM allocation can be compared with:
+ PRELINKED_XML_BENCH=20 ./Prelinked prelinkedkernel
+
+ Compressed kernel reading on slow media can be emulated with a throttled reader (-pthread is needed on Linux):
+ PRELINKED_READ_KBPS=16384 ./Prelinked prelinkedkernel
+ PRELINKED_READ_KBPS=16384 PRELINKED_READ_SYNC=1 ./Prelinked prelinkedkernel
 */
 
 STATIC CHAR8 KextInfoPlistData[] = {
@@ -426,6 +435,19 @@ static EFI_FILE_PROTOCOL nilFilProtocol;
 UINT8  *Prelinked;
 UINT32 PrelinkedSize;
 
+//
+// Emulated media speed in KB/s, set PRELINKED_READ_KBPS to throttle reads.
+// Set PRELINKED_READ_SYNC to disable asynchronous reads.
+//
+UINT32  ReadSpeed;
+BOOLEAN ReadSync;
+
+static void ThrottleRead (UINT32 Size) {
+  if (ReadSpeed > 0) {
+    usleep ((useconds_t) ((UINT64) Size * 1000000 / (ReadSpeed * 1024ULL)));
+  }
+}
+
 EFI_STATUS
 GetFileData (
   IN  EFI_FILE_PROTOCOL  *File,
@@ -440,10 +462,110 @@ GetFileData (
     return EFI_INVALID_PARAMETER;
   }
 
+  ThrottleRead (Size);
   memcpy (&Buffer[0], &Prelinked[Position], Size);
   return EFI_SUCCESS;
 }
 
+typedef struct {
+  pthread_t  Thread;
+  UINT32     Position;
+  UINT32     Size;
+  UINT8      *Buffer;
+} ASYNC_READ;
+
+static void *AsyncReadThread (void *Context) {
+  ASYNC_READ *Read = Context;
+  ThrottleRead (Read->Size);
+  memcpy (Read->Buffer, &Prelinked[Read->Position], Read->Size);
+  return NULL;
+}
+
+EFI_STATUS
+GetFileDataAsync (
+  IN  EFI_FILE_PROTOCOL  *File,
+  IN  UINT32             Position,
+  IN  UINT32             Size,
+  OUT UINT8              *Buffer,
+  OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  ASYNC_READ  *Read;
+
+  ASSERT (File == &nilFilProtocol);
+
+  Token->Event      = NULL;
+  Token->Status     = EFI_SUCCESS;
+  Token->BufferSize = Size;
+  Token->Buffer     = Buffer;
+
+  if ((UINT64) Position + Size > PrelinkedSize) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (ReadSync) {
+    return GetFileData (File, Position, Size, Buffer);
+  }
+
+  Read = malloc (sizeof (*Read));
+  if (Read == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Read->Position = Position;
+  Read->Size     = Size;
+  Read->Buffer   = Buffer;
+  if (pthread_create (&Read->Thread, NULL, AsyncReadThread, Read) != 0) {
+    free (Read);
+    return GetFileData (File, Position, Size, Buffer);
+  }
+
+  Token->Event = Read;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+GetFileDataComplete (
+  IN     EFI_FILE_PROTOCOL  *File,
+  IN OUT EFI_FILE_IO_TOKEN  *Token,
+  IN     UINT32             Size
+  )
+{
+  ASYNC_READ  *Read;
+
+  ASSERT (File == &nilFilProtocol);
+
+  if (Token->Event != NULL) {
+    Read = Token->Event;
+    pthread_join (Read->Thread, NULL);
+    free (Read);
+    Token->Event = NULL;
+  }
+
+  return Token->BufferSize == Size ? Token->Status : EFI_BAD_BUFFER_SIZE;
+}
+
+VOID *
+OcStorageReadFileUnicode (
+  IN  OC_STORAGE_CONTEXT               *Context,
+  IN  CONST CHAR16                     *FilePath,
+  OUT UINT32                           *FileSize OPTIONAL
+  )
+{
+  UINT32  Size;
+  VOID    *Data;
+
+  //
+  // Symbol cache is the only file read from storage here.
+  //
+  Data = readFile ("symcache.bin", &Size);
+  if (Data != NULL && FileSize != NULL) {
+    *FileSize = Size;
+  }
+
+  return Data;
+}
+
 EFI_STATUS
 GetFileSize (
   IN  EFI_FILE_PROTOCOL  *File,
@@ -455,9 +577,253 @@ GetFileSize (
   return EFI_SUCCESS;
 }
 
+//
+// Checks PatcherGetSymbolAddresses against PatcherGetSymbolAddress on the
+// embedded Lilu binary with repeated defined and unresolvable names.
+//
+static void TestSymbolAddresses (void) {
+  PATCHER_CONTEXT Patcher;
+  CONST CHAR8     *Defined[2] = {NULL, NULL};
+  CONST CHAR8     *Undefined = NULL;
+  UINT8           *Address;
+  UINT32          Index;
+
+  if (RETURN_ERROR (PatcherInitContextFromBuffer (&Patcher, LiluKextData, LiluKextDataSize))) {
+    DEBUG ((DEBUG_WARN, "Symbol address test - no Lilu context\n"));
+    return;
+  }
+
+  for (Index = 0; Defined[1] == NULL || Undefined == NULL; ++Index) {
+    MACH_NLIST_64 *Symbol = MachoGetSymbolByIndex64 (&Patcher.MachContext, Index);
+    if (Symbol == NULL) {
+      break;
+    }
+    CONST CHAR8 *Name = MachoGetSymbolName64 (&Patcher.MachContext, Symbol);
+    if (Name == NULL || Name[0] == '\0') {
+      continue;
+    }
+    RETURN_STATUS Status = PatcherGetSymbolAddress (&Patcher, Name, &Address);
+    if (!RETURN_ERROR (Status) && Defined[0] == NULL) {
+      Defined[0] = Name;
+    } else if (!RETURN_ERROR (Status) && Defined[1] == NULL && AsciiStrCmp (Name, Defined[0]) != 0) {
+      Defined[1] = Name;
+    } else if (Status == RETURN_INVALID_PARAMETER && Undefined == NULL) {
+      Undefined = Name;
+    }
+  }
+
+  if (Defined[1] == NULL || Undefined == NULL) {
+    DEBUG ((DEBUG_WARN, "Symbol address test - no suitable symbols\n"));
+    return;
+  }
+
+  CONST CHAR8 *Names[] = {
+    Defined[0], Undefined, Defined[1], Defined[0], Undefined, NULL, Defined[1]
+  };
+  UINT8 *Addresses[ARRAY_SIZE (Names)];
+  BOOLEAN Matches = PatcherGetSymbolAddresses (&Patcher, Names, ARRAY_SIZE (Names), Addresses) == RETURN_INVALID_PARAMETER;
+
+  for (Index = 0; Index < ARRAY_SIZE (Names); ++Index) {
+    Address = NULL;
+    if (Names[Index] != NULL && RETURN_ERROR (PatcherGetSymbolAddress (&Patcher, Names[Index], &Address))) {
+      Address = NULL;
+    }
+    if (Addresses[Index] != Address) {
+      Matches = FALSE;
+    }
+  }
+
+  //
+  // Without unresolvable names every name must be found.
+  //
+  Names[1] = Defined[1];
+  Names[4] = Defined[0];
+  if (PatcherGetSymbolAddresses (&Patcher, Names, ARRAY_SIZE (Names), Addresses) != RETURN_SUCCESS
+    || Addresses[1] != Addresses[2] || Addresses[4] != Addresses[0] || Addresses[5] != NULL) {
+    Matches = FALSE;
+  }
+
+  //
+  // Missing names are reported like in PatcherGetSymbolAddress.
+  //
+  Names[5] = "__ZN15OcMissingSymbolEv";
+  if (PatcherGetSymbolAddresses (&Patcher, Names, ARRAY_SIZE (Names), Addresses) != RETURN_NOT_FOUND
+    || PatcherGetSymbolAddress (&Patcher, Names[5], &Address) != RETURN_NOT_FOUND
+    || Addresses[5] != NULL || Addresses[0] == NULL) {
+    Matches = FALSE;
+  }
+
+  DEBUG ((DEBUG_WARN, "Symbol address test (%a, %a) - %a\n", Defined[0], Undefined, Matches ? "ok" : "mismatch"));
+}
+
+//
+// Imports symcache.bin into a fresh context on a pristine prelinkedkernel copy.
+// With Move set every kext with an executable is moved 0x1000 bytes down by
+// rewriting its load address in place.
+//
+static EFI_STATUS ImportSymbolCacheCopy (CONST UINT8 *Pristine, UINT32 Size, UINT32 AllocSize, BOOLEAN Move, UINT32 *Moved) {
+  PRELINKED_CONTEXT Context;
+  UINT32            CacheSize;
+  VOID              *Cache;
+  UINT8             *Copy;
+  EFI_STATUS        Status;
+
+  *Moved = 0;
+
+  Cache = readFile ("symcache.bin", &CacheSize);
+  Copy  = malloc (AllocSize);
+  if (Cache == NULL || Copy == NULL) {
+    free (Cache);
+    free (Copy);
+    return EFI_NOT_FOUND;
+  }
+
+  memcpy (Copy, Pristine, Size);
+
+  Status = PrelinkedContextInit (&Context, Copy, Size, AllocSize);
+  if (!EFI_ERROR (Status)) {
+    for (UINT32 Index = 0; Move && Index < XmlNodeChildren (Context.KextList); ++Index) {
+      XML_NODE *Kext = PlistNodeCast (XmlNodeChild (Context.KextList, Index), PLIST_NODE_TYPE_DICT);
+      XML_NODE *Value = Kext != NULL ? PlistDictFind (Kext, PRELINK_INFO_EXECUTABLE_LOAD_ADDR_KEY) : NULL;
+      CHAR8 *Address = Value != NULL ? (CHAR8 *) XmlNodeContent (Value) : NULL;
+      size_t Length = Address != NULL ? strlen (Address) : 0;
+      //
+      // Load addresses are page aligned, decrement the 0x1000 digit when possible.
+      //
+      if (Length > 5 && Address[1] == 'x' && Address[Length - 4] != '0') {
+        Address[Length - 4] = Address[Length - 4] == 'a' || Address[Length - 4] == 'A' ? '9' : Address[Length - 4] - 1;
+        ++*Moved;
+      }
+    }
+
+    Status = PrelinkedImportSymbolCache (&Context, Cache, CacheSize);
+    PrelinkedContextFree (&Context);
+  }
+
+  free (Cache);
+  free (Copy);
+  return Status;
+}
+
+//
+// Checks that symcache.bin is reused as is, but rejected once kexts are moved.
+//
+static void TestSymbolCacheMovedKexts (CONST UINT8 *Pristine, UINT32 Size, UINT32 AllocSize) {
+  UINT32     Moved;
+  EFI_STATUS Status;
+  EFI_STATUS MovedStatus;
+
+  Status      = ImportSymbolCacheCopy (Pristine, Size, AllocSize, FALSE, &Moved);
+  MovedStatus = ImportSymbolCacheCopy (Pristine, Size, AllocSize, TRUE, &Moved);
+
+  DEBUG ((
+    DEBUG_WARN,
+    "Symbol cache move test (%u kexts moved) - %r, moved %r - %a\n",
+    Moved,
+    Status,
+    MovedStatus,
+    !EFI_ERROR (Status) && MovedStatus == EFI_INCOMPATIBLE_VERSION ? "ok" : "mismatch"
+    ));
+}
+
+static UINT32 CountXmlNodes (XML_NODE *Node, UINT32 *Lists) {
+  UINT32 Count = 1;
+  UINT32 Children = XmlNodeChildren (Node);
+  if (Children > 0) {
+    ++*Lists;
+  }
+  for (UINT32 Index = 0; Index < Children; ++Index) {
+    Count += CountXmlNodes (XmlNodeChild (Node, Index), Lists);
+  }
+  return Count;
+}
+
+//
+// Compares pool and arena DOM allocation when parsing PRELINK_INFO, as well
+// as lazy parsing with kext identifiers looked up like PrelinkedContextInit.
+// Enabled with PRELINKED_XML_BENCH=<iterations>.
+//
+static void BenchmarkPrelinkedInfo (PRELINKED_CONTEXT *Context, UINT32 Iterations) {
+  UINT32 Size = (UINT32) Context->PrelinkedInfoSection->Size;
+  CHAR8 *Copy = malloc (Size);
+  long long PoolTime = 0, ArenaTime = 0, LazyTime = 0;
+  UINT32 Nodes = 0, Lists = 0;
+
+  for (UINT32 Index = 0; Index < Iterations && Copy != NULL; ++Index) {
+    memcpy (Copy, &Context->Prelinked[Context->PrelinkedInfoSection->Offset], Size);
+    long long a = current_timestamp();
+    XML_DOCUMENT *Document = XmlDocumentParse (Copy, Size, TRUE);
+    if (Document == NULL) {
+      break;
+    }
+    if (Index == 0) {
+      Nodes = CountXmlNodes (XmlDocumentRoot (Document), &Lists);
+    }
+    XmlDocumentFree (Document);
+    PoolTime += current_timestamp() - a;
+
+    memcpy (Copy, &Context->Prelinked[Context->PrelinkedInfoSection->Offset], Size);
+    a = current_timestamp();
+    Document = XmlDocumentParseArena (Copy, Size, TRUE);
+    if (Document == NULL) {
+      break;
+    }
+    if (Index == 0) {
+      CONST OC_ARENA_STATS *Stats = XmlDocumentArenaStats (Document);
+      DEBUG ((DEBUG_WARN, "PRELINK_INFO %u bytes, %u nodes, %u child lists\n", Size, Nodes, Lists));
+      DEBUG ((DEBUG_WARN, "Pool DOM needs at least %u allocations\n", Nodes + Lists));
+      DEBUG ((
+        DEBUG_WARN,
+        "Arena DOM needs %u allocations, %u bytes used of %u reserved\n",
+        (UINT32) Stats->NumChunks,
+        (UINT32) Stats->UsedSize,
+        (UINT32) Stats->ReservedSize
+        ));
+    }
+    XmlDocumentFree (Document);
+    ArenaTime += current_timestamp() - a;
+
+    memcpy (Copy, &Context->Prelinked[Context->PrelinkedInfoSection->Offset], Size);
+    a = current_timestamp();
+    Document = XmlDocumentParseLazy (Copy, Size, TRUE);
+    if (Document == NULL) {
+      break;
+    }
+    XML_NODE *KextList = PlistDictFind (XmlDocumentRoot (Document), PRELINK_INFO_DICTIONARY_KEY);
+    UINT32 KextCount = KextList != NULL ? XmlNodeChildren (KextList) : 0;
+    for (UINT32 KextIndex = 0; KextIndex < KextCount; ++KextIndex) {
+      PlistDictFind (XmlNodeChild (KextList, KextIndex), INFO_BUNDLE_IDENTIFIER_KEY);
+    }
+    if (Index == 0) {
+      CONST OC_ARENA_STATS *Stats = XmlDocumentArenaStats (Document);
+      DEBUG ((
+        DEBUG_WARN,
+        "Lazy DOM for %u kexts uses %u bytes\n",
+        KextCount,
+        (UINT32) Stats->UsedSize
+        ));
+    }
+    XmlDocumentFree (Document);
+    LazyTime += current_timestamp() - a;
+  }
+
+  DEBUG ((
+    DEBUG_WARN,
+    "Parse and free x%u - pool %Lu ms, arena %Lu ms, lazy %Lu ms\n",
+    Iterations,
+    (UINT64) PoolTime,
+    (UINT64) ArenaTime,
+    (UINT64) LazyTime
+    ));
+  free (Copy);
+}
+
 int wrap_main(int argc, char** argv) {
   UINT32 AllocSize;
   PRELINKED_CONTEXT Context;
+
+  TestSymbolAddresses ();
+
   const char *name = argc > 1 ? argv[1] : "/System/Library/PrelinkedKernels/prelinkedkernel";
   if ((Prelinked = readFile(name, &PrelinkedSize)) == NULL) {
     printf("Read fail\n");
@@ -469,6 +835,9 @@ int wrap_main(int argc, char** argv) {
   if (PrelinkedSize > 4 && *(UINT32 *)Prelinked == 0xbebafeca) {
     UINT8 *NewPrelinked = NULL;
     UINT32 NewPrelinkedSize = PrelinkedSize;
+    ReadSpeed = getenv ("PRELINKED_READ_KBPS") != NULL ? (UINT32) atoi (getenv ("PRELINKED_READ_KBPS")) : 0;
+    ReadSync  = getenv ("PRELINKED_READ_SYNC") != NULL;
+    long long a = current_timestamp();
     EFI_STATUS Status = ReadAppleKernel (
       &nilFilProtocol,
       &NewPrelinked,
@@ -476,6 +845,7 @@ int wrap_main(int argc, char** argv) {
       &AllocSize,
       5992448
       );
+    DEBUG ((DEBUG_WARN, "Kernel read (%a) - %r in %Lu ms\n", ReadSync ? "sync" : "async", Status, (UINT64) (current_timestamp() - a)));
 
     if (!EFI_ERROR (Status)) {
       free(Prelinked);
@@ -498,9 +868,19 @@ int wrap_main(int argc, char** argv) {
   ApplyKernelPatches (Prelinked, PrelinkedSize);
 #endif
 
+  UINT8 *Pristine = malloc (PrelinkedSize);
+  if (Pristine != NULL) {
+    memcpy (Pristine, Prelinked, PrelinkedSize);
+  }
+  UINT32 PristineSize = PrelinkedSize;
+
   EFI_STATUS Status = PrelinkedContextInit (&Context, Prelinked, PrelinkedSize, AllocSize);
 
   if (!EFI_ERROR (Status)) {
+    if (getenv ("PRELINKED_XML_BENCH") != NULL) {
+      BenchmarkPrelinkedInfo (&Context, (UINT32) atoi (getenv ("PRELINKED_XML_BENCH")));
+    }
+
     ApplyKextPatches (&Context);
 
     Status = PrelinkedInjectPrepare (&Context);
@@ -508,6 +888,12 @@ int wrap_main(int argc, char** argv) {
       printf("Prelink inject prepare error %zx\n", Status);
     }
 
+    OC_STORAGE_CONTEXT Storage;
+    ZeroMem (&Storage, sizeof (Storage));
+    long long CacheTime = current_timestamp();
+    EFI_STATUS CacheStatus = PrelinkedLoadSymbolCache (&Context, &Storage, L"symcache.bin");
+    DEBUG ((DEBUG_WARN, "Symbol cache loaded - %r in %Lu ms\n", CacheStatus, (UINT64) (current_timestamp() - CacheTime)));
+
 #ifndef TEST_SLE
     Status = PrelinkedInjectKext (
       &Context,
@@ -551,6 +937,8 @@ int wrap_main(int argc, char** argv) {
       char KextPath[64];
       snprintf(KextPath, sizeof(KextPath), "/Library/Extensions/Kex%d.kext", c);
 
+      long long a = current_timestamp();
+
       Status = PrelinkedInjectKext (
         &Context,
         KextPath,
@@ -561,7 +949,7 @@ int wrap_main(int argc, char** argv) {
         TestDataSize
         );
 
-      DEBUG ((DEBUG_WARN, "%s injected - %r\n", argc > 2 ? "Passed.kext" : "Lilu.kext", Status));
+      DEBUG ((DEBUG_WARN, "%s injected - %r in %Lu ms\n", argc > 2 ? "Passed.kext" : "Lilu.kext", Status, (UINT64) (current_timestamp() - a)));
 
       if (argc > 2) free(TestData);
       if (argc > 3) free(TestPlist);
@@ -573,17 +961,91 @@ int wrap_main(int argc, char** argv) {
 
 #ifndef TEST_SLE
     if (argc <= 2) {
-      Status = PrelinkedInjectKext (
-        &Context,
-        "/Library/Extensions/VirtualSMC.kext",
-        VsmcKextInfoPlistData,
-        VsmcKextInfoPlistDataSize,
-        "Contents/MacOS/VirtualSMC",
-        VsmcKextData,
-        VsmcKextDataSize
-        );
+      //
+      // Lilu and VirtualSMC have many OSObject subclasses, which makes their
+      // injection time mostly depend on symbol and vtable lookup performance.
+      // VirtualSMC goes first to check that batch injection links Lilu before it.
+      //
+      PRELINKED_KEXT_BUNDLE Bundles[] = {
+        {
+          "/Library/Extensions/VirtualSMC.kext",
+          VsmcKextInfoPlistData,
+          VsmcKextInfoPlistDataSize,
+          "Contents/MacOS/VirtualSMC",
+          VsmcKextData,
+          VsmcKextDataSize
+        },
+        {
+          "/Library/Extensions/Lilu.kext",
+          LiluKextInfoPlistData,
+          LiluKextInfoPlistDataSize,
+          "Contents/MacOS/Lilu",
+          LiluKextData,
+          LiluKextDataSize
+        }
+      };
+      RETURN_STATUS Statuses[ARRAY_SIZE (Bundles)];
+      XML_DOCUMENT *PlanDocuments[ARRAY_SIZE (Bundles)];
+      XML_NODE *PlanRoots[ARRAY_SIZE (Bundles)];
+      CHAR8 *PlanPlists[ARRAY_SIZE (Bundles)];
+      PRELINKED_KEXT_PLAN Plan;
+
+      long long a = current_timestamp();
+
+      for (UINT32 Index = 0; Index < ARRAY_SIZE (Bundles); ++Index) {
+        PlanPlists[Index] = AllocateCopyPool (Bundles[Index].InfoPlistSize, Bundles[Index].InfoPlist);
+        PlanDocuments[Index] = XmlDocumentParse (PlanPlists[Index], Bundles[Index].InfoPlistSize, FALSE);
+        PlanRoots[Index] = PlistNodeCast (PlistDocumentRoot (PlanDocuments[Index]), PLIST_NODE_TYPE_DICT);
+      }
+
+      Status = PrelinkedPlanKexts (&Context, PlanRoots, ARRAY_SIZE (Bundles), &Plan);
 
-      DEBUG ((DEBUG_WARN, "VirtualSMC.kext injected - %r\n", Status));
+      DEBUG ((DEBUG_WARN, "Kexts planned - %r in %Lu ms\n", Status, (UINT64) (current_timestamp() - a)));
+
+      for (UINT32 Index = 0; Index < Plan.NumPlanned; ++Index) {
+        DEBUG ((DEBUG_WARN, "%u. %a level %u\n", Index, Bundles[Plan.Order[Index]].BundlePath, Plan.Levels[Plan.Order[Index]]));
+      }
+
+      DEBUG ((DEBUG_WARN, "%u levels, %u external dependencies\n", Plan.NumLevels, Plan.NumExternalDependencies));
+
+      PrelinkedPlanFree (&Plan);
+
+      for (UINT32 Index = 0; Index < ARRAY_SIZE (Bundles); ++Index) {
+        XmlDocumentFree (PlanDocuments[Index]);
+        FreePool (PlanPlists[Index]);
+      }
+
+      a = current_timestamp();
+
+      Status = PrelinkedInjectKexts (&Context, Bundles, ARRAY_SIZE (Bundles), Statuses);
+
+      DEBUG ((DEBUG_WARN, "VirtualSMC.kext injected - %r\n", Statuses[0]));
+      DEBUG ((DEBUG_WARN, "Lilu.kext injected - %r\n", Statuses[1]));
+      DEBUG ((DEBUG_WARN, "Batch injected - %r in %Lu ms\n", Status, (UINT64) (current_timestamp() - a)));
+    }
+
+    DEBUG ((
+      DEBUG_WARN,
+      "Arena %zu allocations, %zu chunks, %zu used, %zu peak reserved\n",
+      Context.Arena.Stats.NumAllocations,
+      Context.Arena.Stats.NumChunks,
+      Context.Arena.Stats.UsedSize,
+      Context.Arena.Stats.PeakReservedSize
+      ));
+
+    if (EFI_ERROR (CacheStatus)) {
+      VOID   *Cache;
+      UINT32 CacheSize;
+      EFI_STATUS ExportStatus = PrelinkedExportSymbolCache (&Context, &Cache, &CacheSize);
+      DEBUG ((DEBUG_WARN, "Symbol cache exported - %r, %u bytes\n", ExportStatus, CacheSize));
+      if (!EFI_ERROR (ExportStatus)) {
+        FILE *CacheFh = fopen("symcache.bin", "wb");
+        if (CacheFh != NULL) {
+          fwrite (Cache, CacheSize, 1, CacheFh);
+          fclose(CacheFh);
+        }
+        FreePool (Cache);
+      }
     }
 
     Status = PrelinkedInjectComplete (&Context);
@@ -606,10 +1068,15 @@ int wrap_main(int argc, char** argv) {
     }
 #endif
     PrelinkedContextFree (&Context);
+
+    if (Pristine != NULL) {
+      TestSymbolCacheMovedKexts (Pristine, PristineSize, AllocSize);
+    }
   } else {
     printf("Context creation error %zx\n", Status);
   }
 
+  free(Pristine);
   free(Prelinked);
 
   return 0;
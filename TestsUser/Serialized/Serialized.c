@@ -16,17 +16,29 @@
 #include <Library/OcSerializeLib.h>
 #include <Library/OcMiscLib.h>
 #include <Library/OcConfigurationLib.h>
+#include <Library/OcCryptoLib.h>
 
 #include <sys/time.h>
 
 /*
- clang -g -fsanitize=undefined,address -I../Include -I../../Include -I../../../MdePkg/Include/ -include ../Include/Base.h Serialized.c ../../Library/OcXmlLib/OcXmlLib.c ../../Library/OcTemplateLib/OcTemplateLib.c ../../Library/OcSerializeLib/OcSerializeLib.c ../../Library/OcMiscLib/Base64Decode.c ../../Library/OcStringLib/OcAsciiLib.c ../../Library/OcConfigurationLib/OcConfigurationLib.c -o Serialized
+ clang -g -fsanitize=undefined,address -I../Include -I../../Include -I../../../MdePkg/Include/ -include ../Include/Base.h Serialized.c ../../Library/OcXmlLib/OcXmlLib.c ../../Library/OcMiscLib/ArenaAllocator.c ../../Library/OcTemplateLib/OcTemplateLib.c ../../Library/OcSerializeLib/OcSerializeLib.c ../../Library/OcMiscLib/Base64Decode.c ../../Library/OcStringLib/OcAsciiLib.c ../../Library/OcConfigurationLib/OcConfigurationLib.c ../../Library/OcCryptoLib/Sha256.c -o Serialized
 
  for fuzzing:
- clang-mp-7.0 -Dmain=__main -g -fsanitize=undefined,address,fuzzer -I../Include -I../../Include -I../../../MdePkg/Include/ -include ../Include/Base.h Serialized.c ../../Library/OcXmlLib/OcXmlLib.c ../../Library/OcTemplateLib/OcTemplateLib.c ../../Library/OcSerializeLib/OcSerializeLib.c ../../Library/OcMiscLib/Base64Decode.c ../../Library/OcStringLib/OcAsciiLib.c ../../Library/OcConfigurationLib/OcConfigurationLib.c -o Serialized
+ clang-mp-7.0 -Dmain=__main -g -fsanitize=undefined,address,fuzzer -I../Include -I../../Include -I../../../MdePkg/Include/ -include ../Include/Base.h Serialized.c ../../Library/OcXmlLib/OcXmlLib.c ../../Library/OcMiscLib/ArenaAllocator.c ../../Library/OcTemplateLib/OcTemplateLib.c ../../Library/OcSerializeLib/OcSerializeLib.c ../../Library/OcMiscLib/Base64Decode.c ../../Library/OcStringLib/OcAsciiLib.c ../../Library/OcConfigurationLib/OcConfigurationLib.c ../../Library/OcCryptoLib/Sha256.c -o Serialized
  rm -rf DICT fuzz*.log ; mkdir DICT ; cp Serialized.plist DICT ; ./Serialized -jobs=4 DICT
 
  rm -rf Serialized.dSYM DICT fuzz*.log Serialized
+
+ for XML parsing throughput, e.g. on a prelinked kernel PRELINK_INFO plist:
+ SERIALIZED_XML_BENCH=1000 ./Serialized file.plist
+
+ for config parsing throughput on a generated config with large Kernel->Add
+ and ACPI->Patch arrays, e.g. 5000 entries each:
+ SERIALIZED_CONFIG_BENCH=5000 ./Serialized
+
+ for creating configuration cache from a config and loading the config with it:
+ SERIALIZED_EXPORT_CACHE=config.bin ./Serialized config.plist
+ SERIALIZED_CACHE=config.bin ./Serialized config.plist
 */
 
 
@@ -57,7 +69,295 @@ uint8_t *readFile(const char *str, uint32_t *size) {
   return string;
 }
 
+//
+// Measures XML parsing throughput on the input file.
+// Enabled with SERIALIZED_XML_BENCH=<iterations>.
+//
+static BOOLEAN CountPlistEvent (VOID *Context, PLIST_EVENT_TYPE Type, XML_NODE *Node) {
+  (*(UINT32 *) Context)++;
+  return TRUE;
+}
+
+static void BenchmarkXmlParse (CONST UINT8 *Data, UINT32 Size, UINT32 Iterations) {
+  CHAR8 *Copy = malloc (Size);
+  long long ParseTime = 0;
+  long long EventTime = 0;
+  UINT32 Events = 0;
+  UINT32 Index;
+
+  for (Index = 0; Index < Iterations && Copy != NULL; ++Index) {
+    memcpy (Copy, Data, Size);
+    long long a = current_timestamp();
+    XML_DOCUMENT *Document = XmlDocumentParse (Copy, Size, FALSE);
+    ParseTime += current_timestamp() - a;
+    if (Document == NULL) {
+      DEBUG ((DEBUG_WARN, "XML parsing failed\n"));
+      break;
+    }
+    XmlDocumentFree (Document);
+  }
+
+  DEBUG ((
+    DEBUG_WARN,
+    "Parse x%u of %u bytes in %Lu ms, %Lu KB/s\n",
+    Index,
+    Size,
+    (UINT64) ParseTime,
+    (UINT64) (Size * (UINT64) Index / (ParseTime > 0 ? ParseTime : 1))
+    ));
+
+  for (Index = 0; Index < Iterations && Copy != NULL; ++Index) {
+    memcpy (Copy, Data, Size);
+    long long a = current_timestamp();
+    BOOLEAN Result = PlistParseEvents (Copy, Size, CountPlistEvent, &Events);
+    EventTime += current_timestamp() - a;
+    if (!Result) {
+      DEBUG ((DEBUG_WARN, "Plist event parsing failed\n"));
+      break;
+    }
+  }
+
+  DEBUG ((
+    DEBUG_WARN,
+    "Event parse x%u of %u bytes (%u events) in %Lu ms, %Lu KB/s\n",
+    Index,
+    Size,
+    Events,
+    (UINT64) EventTime,
+    (UINT64) (Size * (UINT64) Index / (EventTime > 0 ? EventTime : 1))
+    ));
+  free (Copy);
+}
+
+//
+// Generates a config with Entries Kernel->Add and ACPI->Patch entries and
+// measures OcConfigurationInit on it.
+// Enabled with SERIALIZED_CONFIG_BENCH=<entries>.
+//
+static void BenchmarkConfigParse (UINT32 Entries) {
+  STATIC CONST CHAR8 *KernelAdd =
+    "<dict>"
+    "<key>BundlePath</key><string>Lilu.kext</string>"
+    "<key>Comment</key><string>Patch engine</string>"
+    "<key>Enabled</key><true/>"
+    "<key>ExecutablePath</key><string>Contents/MacOS/Lilu</string>"
+    "<key>MatchKernel</key><string>18.</string>"
+    "<key>PlistPath</key><string>Contents/Info.plist</string>"
+    "</dict>";
+  STATIC CONST CHAR8 *AcpiPatch =
+    "<dict>"
+    "<key>Comment</key><string>_OSI to XOSI</string>"
+    "<key>Count</key><integer>0</integer>"
+    "<key>Enabled</key><false/>"
+    "<key>Find</key><data>X09TSQ==</data>"
+    "<key>Limit</key><integer>0</integer>"
+    "<key>Mask</key><data></data>"
+    "<key>OemTableId</key><data>AAAAAAAAAAA=</data>"
+    "<key>Replace</key><data>WE9TSQ==</data>"
+    "<key>ReplaceMask</key><data></data>"
+    "<key>Skip</key><integer>0</integer>"
+    "<key>TableLength</key><integer>0</integer>"
+    "<key>TableSignature</key><data>AAAAAA==</data>"
+    "</dict>";
+  STATIC CONST UINT32 Iterations = 10;
+
+  VOID *Cache;
+  UINT32 CacheSize;
+  long long CacheTime = 0;
+
+  UINT32 KernelAddSize = (UINT32) strlen (KernelAdd);
+  UINT32 AcpiPatchSize = (UINT32) strlen (AcpiPatch);
+  UINT32 Size = 256 + Entries * (KernelAddSize + AcpiPatchSize);
+  CHAR8 *Plist = malloc (Size);
+  CHAR8 *Copy = malloc (Size);
+  long long ParseTime = 0;
+  UINT32 Length;
+  UINT32 Index;
+
+  if (Plist == NULL || Copy == NULL) {
+    free (Plist);
+    free (Copy);
+    return;
+  }
+
+  Length = (UINT32) sprintf (Plist, "<plist version=\"1.0\"><dict><key>ACPI</key><dict><key>Patch</key><array>");
+  for (Index = 0; Index < Entries; ++Index) {
+    memcpy (Plist + Length, AcpiPatch, AcpiPatchSize);
+    Length += AcpiPatchSize;
+  }
+  Length += (UINT32) sprintf (Plist + Length, "</array></dict><key>Kernel</key><dict><key>Add</key><array>");
+  for (Index = 0; Index < Entries; ++Index) {
+    memcpy (Plist + Length, KernelAdd, KernelAddSize);
+    Length += KernelAddSize;
+  }
+  Length += (UINT32) sprintf (Plist + Length, "</array></dict></dict></plist>");
+
+  //
+  // Plist digest normally comes from the vault.
+  //
+  UINT8 Digest[SHA256_DIGEST_SIZE];
+  Sha256 (Digest, (UINT8 *) Plist, Length);
+
+  memcpy (Copy, Plist, Length);
+  if (EFI_ERROR (OcConfigurationExportCache (Copy, Length, &Cache, &CacheSize))) {
+    DEBUG ((DEBUG_WARN, "Config cache export failed\n"));
+    Cache = NULL;
+  }
+
+  for (Index = 0; Index < Iterations && Cache != NULL; ++Index) {
+    OC_GLOBAL_CONFIG Config;
+    VOID *CacheCopy = AllocatePool (CacheSize);
+    if (CacheCopy == NULL) {
+      break;
+    }
+    memcpy (CacheCopy, Cache, CacheSize);
+    long long a = current_timestamp();
+    EFI_STATUS Status = OcConfigurationInitWithCache (&Config, Plist, Length, Digest, CacheCopy, CacheSize);
+    CacheTime += current_timestamp() - a;
+    if (EFI_ERROR (Status) || Config.Cache != CacheCopy) {
+      DEBUG ((DEBUG_WARN, "Config cache loading failed\n"));
+      if (!EFI_ERROR (Status)) {
+        OcConfigurationFree (&Config);
+      }
+      break;
+    }
+    if (Config.Kernel.Add.Count != Entries || Config.Acpi.Patch.Count != Entries) {
+      DEBUG ((DEBUG_WARN, "Config cache lost entries\n"));
+    }
+    OcConfigurationFree (&Config);
+  }
+
+  if (Cache != NULL) {
+    DEBUG ((
+      DEBUG_WARN,
+      "Config cache x%u with %u entries (%u bytes) in %Lu ms\n",
+      Index,
+      Entries,
+      CacheSize,
+      (UINT64) CacheTime
+      ));
+    FreePool (Cache);
+  }
+
+  for (Index = 0; Index < Iterations; ++Index) {
+    OC_GLOBAL_CONFIG Config;
+    memcpy (Copy, Plist, Length);
+    long long a = current_timestamp();
+    EFI_STATUS Status = OcConfigurationInit (&Config, Copy, Length);
+    ParseTime += current_timestamp() - a;
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_WARN, "Config parsing failed\n"));
+      break;
+    }
+    if (Config.Kernel.Add.Count != Entries || Config.Acpi.Patch.Count != Entries) {
+      DEBUG ((DEBUG_WARN, "Config parsing lost entries\n"));
+    }
+    OcConfigurationFree (&Config);
+  }
+
+  DEBUG ((
+    DEBUG_WARN,
+    "Config x%u with %u entries (%u bytes) in %Lu ms\n",
+    Index,
+    Entries,
+    Length,
+    (UINT64) ParseTime
+    ));
+  free (Plist);
+  free (Copy);
+}
+
+//
+// Checks ParseSerialized on malformed plists, dictionaries with odd children,
+// and custom dictionary appliers.
+//
+typedef struct {
+  UINT32  Value;
+  UINT32  Nested;
+  UINT32  Custom;
+} TEST_SERIALIZED;
+
+static VOID TestApplyCustom (VOID *Serialized, XML_NODE *Node, OC_SCHEMA_INFO *Info) {
+  ((TEST_SERIALIZED *) Serialized)->Custom = PlistDictChildren (Node);
+}
+
+static OC_SCHEMA mTestNestedSchema[] = {
+  OC_SCHEMA_INTEGER_IN ("Nested", TEST_SERIALIZED, Nested)
+};
+
+static OC_SCHEMA mTestStreamSchema[] = {
+  OC_SCHEMA_DICT       ("Dict",  mTestNestedSchema),
+  OC_SCHEMA_INTEGER_IN ("Value", TEST_SERIALIZED, Value)
+};
+
+static OC_SCHEMA mTestDocumentSchema[] = {
+  {"Custom", PLIST_NODE_TYPE_DICT, TestApplyCustom, {.Value = {0}}},
+  OC_SCHEMA_DICT       ("Dict",  mTestNestedSchema),
+  OC_SCHEMA_INTEGER_IN ("Value", TEST_SERIALIZED, Value)
+};
+
+static OC_SCHEMA_INFO mTestStreamInfo = {
+  .Dict = {mTestStreamSchema, ARRAY_SIZE (mTestStreamSchema)}
+};
+
+static OC_SCHEMA_INFO mTestDocumentInfo = {
+  .Dict = {mTestDocumentSchema, ARRAY_SIZE (mTestDocumentSchema)}
+};
+
+static BOOLEAN TestParseSerialized (OC_SCHEMA_INFO *Info, CONST CHAR8 *Plist, BOOLEAN Result, UINT32 Value, UINT32 Nested, UINT32 Custom) {
+  TEST_SERIALIZED Serialized;
+  CHAR8 Buffer[256];
+  UINT32 Size = (UINT32) strlen (Plist);
+
+  ZeroMem (&Serialized, sizeof (Serialized));
+  memcpy (Buffer, Plist, Size);
+  return ParseSerialized (&Serialized, Info, Buffer, Size) == Result
+    && Serialized.Value == Value && Serialized.Nested == Nested && Serialized.Custom == Custom;
+}
+
+static void TestSerializedParse (void) {
+  BOOLEAN Matches = TRUE;
+
+  //
+  // Nothing is applied from a malformed plist.
+  //
+  Matches &= TestParseSerialized (&mTestStreamInfo,
+    "<plist><dict><key>Value</key><integer>1</integer><key>Dict</key><dict></plist>",
+    FALSE, 0, 0, 0);
+  //
+  // Dictionaries with odd children are skipped, and are rejected at root.
+  //
+  Matches &= TestParseSerialized (&mTestStreamInfo,
+    "<plist><dict><key>Dict</key><dict><key>Nested</key><integer>2</integer><key>Nested</key></dict>"
+    "<key>Value</key><integer>1</integer></dict></plist>",
+    TRUE, 1, 0, 0);
+  Matches &= TestParseSerialized (&mTestStreamInfo,
+    "<plist><dict><key>Value</key><integer>1</integer><key>Value</key></dict></plist>",
+    FALSE, 0, 0, 0);
+  Matches &= TestParseSerialized (&mTestStreamInfo,
+    "<plist><dict><key>Dict</key><dict><key>Nested</key><integer>2</integer></dict>"
+    "<key>Value</key><integer>1</integer></dict></plist>",
+    TRUE, 1, 2, 0);
+  //
+  // Custom appliers get the document node.
+  //
+  Matches &= TestParseSerialized (&mTestDocumentInfo,
+    "<plist><dict><key>Custom</key><dict><key>A</key><true/></dict>"
+    "<key>Dict</key><dict><key>Nested</key><integer>2</integer></dict>"
+    "<key>Value</key><integer>1</integer></dict></plist>",
+    TRUE, 1, 2, 1);
+
+  DEBUG ((DEBUG_WARN, "Serialized parse test - %a\n", Matches ? "ok" : "mismatch"));
+}
+
 int main(int argc, char** argv) {
+  TestSerializedParse ();
+
+  if (getenv ("SERIALIZED_CONFIG_BENCH") != NULL) {
+    BenchmarkConfigParse ((UINT32) atoi (getenv ("SERIALIZED_CONFIG_BENCH")));
+    return 0;
+  }
+
   uint32_t f;
   uint8_t *b;
   if ((b = readFile(argc > 1 ? argv[1] : "Serialized.plist", &f)) == NULL) {
@@ -65,10 +365,44 @@ int main(int argc, char** argv) {
     return -1;
   }
 
+  if (getenv ("SERIALIZED_XML_BENCH") != NULL) {
+    BenchmarkXmlParse (b, f, (UINT32) atoi (getenv ("SERIALIZED_XML_BENCH")));
+  }
+
   long long a = current_timestamp();
 
   OC_GLOBAL_CONFIG   Config;
-  EFI_STATUS Status = OcConfigurationInit (&Config, b, f);
+  EFI_STATUS Status;
+  if (getenv ("SERIALIZED_EXPORT_CACHE") != NULL) {
+    VOID *Cache;
+    UINT32 CacheSize;
+    Status = OcConfigurationExportCache (b, f, &Cache, &CacheSize);
+    if (!EFI_ERROR (Status)) {
+      FILE *Out = fopen (getenv ("SERIALIZED_EXPORT_CACHE"), "wb");
+      if (Out == NULL || fwrite (Cache, CacheSize, 1, Out) != 1) {
+        DEBUG ((DEBUG_WARN, "Cache write failed\n"));
+      }
+      if (Out != NULL) {
+        fclose (Out);
+      }
+      FreePool (Cache);
+    }
+    DEBUG ((DEBUG_WARN, "Cache export - %u\n", (UINT32) Status));
+    free (b);
+    return EFI_ERROR (Status) ? -1 : 0;
+  } else if (getenv ("SERIALIZED_CACHE") != NULL) {
+    uint32_t CacheSize;
+    uint8_t *Cache = readFile (getenv ("SERIALIZED_CACHE"), &CacheSize);
+    VOID *CacheCopy = Cache != NULL ? AllocatePool (CacheSize) : NULL;
+    if (CacheCopy != NULL) {
+      CopyMem (CacheCopy, Cache, CacheSize);
+    }
+    free (Cache);
+    Status = OcConfigurationInitWithCache (&Config, b, f, NULL, CacheCopy, CacheSize);
+    DEBUG ((DEBUG_WARN, "Cache %a\n", !EFI_ERROR (Status) && Config.Cache != NULL ? "used" : "unused"));
+  } else {
+    Status = OcConfigurationInit (&Config, b, f);
+  }
 
   DEBUG((EFI_D_ERROR, "Done in %llu ms\n", current_timestamp() - a));
 